@@ -0,0 +1,89 @@
+/// Copyright (c) 2025 Jose Ilitzky
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+/// Replaces the global operator new and delete so the benchmarks can count the heap allocations made by the trees.
+/// Since the replacements are defined here, this header must only be included by one source file of each program.
+
+/// The number of heap allocations made by the program so far.
+static std::atomic<size_t> sAllocationCount = 0;
+
+/// The number of bytes requested from the heap by the program so far.
+static std::atomic<size_t> sAllocatedBytes = 0;
+
+/// Allocates memory from the heap and counts the allocation, for every replacement of operator new.
+/// @param size The number of bytes to allocate.
+/// @param alignment The alignment of the memory, which is only honored past what malloc guarantees by over-allocating.
+/// @return The allocated memory.
+static void* CountedAllocate(std::size_t size, std::size_t alignment = alignof(std::max_align_t))
+{
+    ++sAllocationCount;
+    sAllocatedBytes += size;
+    if (alignment <= alignof(std::max_align_t))
+    {
+        if (void* memory = std::malloc(size > 0 ? size : 1))
+        {
+            return memory;
+        }
+        throw std::bad_alloc();
+    }
+    
+    // The pointer returned by malloc is kept right before the aligned memory so it can be freed later.
+    void* memory = std::malloc(size + alignment + sizeof(void*));
+    if (!memory)
+    {
+        throw std::bad_alloc();
+    }
+    
+    std::uintptr_t address = (reinterpret_cast<std::uintptr_t>(memory) + sizeof(void*) + alignment - 1) & ~(static_cast<std::uintptr_t>(alignment) - 1);
+    reinterpret_cast<void**>(address)[-1] = memory;
+    return reinterpret_cast<void*>(address);
+}
+
+/// Returns memory from CountedAllocate to the heap, for every replacement of operator delete.
+/// @param memory The memory to free.
+/// @param alignment The alignment the memory was allocated with.
+static void CountedDeallocate(void* memory, std::size_t alignment = alignof(std::max_align_t)) noexcept
+{
+    if (memory && alignment > alignof(std::max_align_t))
+    {
+        memory = static_cast<void**>(memory)[-1];
+    }
+    std::free(memory);
+}
+
+void* operator new(std::size_t size)
+{
+    return CountedAllocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    return CountedAllocate(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* memory) noexcept
+{
+    CountedDeallocate(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+    CountedDeallocate(memory);
+}
+
+void operator delete(void* memory, std::align_val_t alignment) noexcept
+{
+    CountedDeallocate(memory, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* memory, std::size_t, std::align_val_t alignment) noexcept
+{
+    CountedDeallocate(memory, static_cast<std::size_t>(alignment));
+}
@@ -0,0 +1,373 @@
+/// Copyright (c) 2025 Jose Ilitzky
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <new>
+#include <random>
+#include <utility>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include <glm/vec2.hpp>
+#include "AllocationCounter.h"
+#include "Quadtree.h"
+
+using Vec2 = glm::vec2;
+using Tree = Quadtree<size_t, Vec2>;
+
+/// The shapes of the datasets the tree is measured against.
+enum class Distribution
+{
+    /// Positions spread evenly over the whole tree.
+    Uniform,
+    
+    /// Positions gathered in a few tight clusters, which drives the clusters' leaves down to the maximum depth.
+    Gaussian,
+    
+    /// Positions along a thin diagonal line, which leaves most of the tree empty.
+    Line,
+    
+    /// Positions drawn from a small set of points, so many elements share the exact same position.
+    Duplicates
+};
+
+/// The half extent of the area covered by every tree in the suite.
+static constexpr float Extent = 1000;
+
+/// How many different positions a query benchmark cycles through.
+static constexpr size_t QueryCount = 1024;
+
+static std::vector<Vec2> Generate(Distribution distribution, size_t count, unsigned seed)
+{
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> uniform(-Extent, Extent);
+    std::vector<Vec2> positions;
+    positions.reserve(count);
+    
+    auto clamp = [](float value) { return std::clamp(value, -Extent, Extent); };
+    switch (distribution)
+    {
+        case Distribution::Uniform:
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                positions.push_back({uniform(random), uniform(random)});
+            }
+            break;
+        }
+        case Distribution::Gaussian:
+        {
+            std::vector<Vec2> centers;
+            for (int i = 0; i < 16; ++i)
+            {
+                centers.push_back({uniform(random) * 0.9f, uniform(random) * 0.9f});
+            }
+            
+            std::normal_distribution<float> offset(0, Extent / 50);
+            for (size_t i = 0; i < count; ++i)
+            {
+                const Vec2& center = centers[i % centers.size()];
+                positions.push_back({clamp(center.x + offset(random)), clamp(center.y + offset(random))});
+            }
+            break;
+        }
+        case Distribution::Line:
+        {
+            std::normal_distribution<float> offset(0, Extent / 500);
+            for (size_t i = 0; i < count; ++i)
+            {
+                float x = uniform(random);
+                positions.push_back({x, clamp((x * 0.5f) + offset(random))});
+            }
+            break;
+        }
+        case Distribution::Duplicates:
+        {
+            std::vector<Vec2> points;
+            for (int i = 0; i < 64; ++i)
+            {
+                points.push_back({uniform(random), uniform(random)});
+            }
+            
+            std::uniform_int_distribution<size_t> pick(0, points.size() - 1);
+            for (size_t i = 0; i < count; ++i)
+            {
+                positions.push_back(points[pick(random)]);
+            }
+            break;
+        }
+    }
+    
+    return positions;
+}
+
+/// Returns the positions of a dataset, generating them only the first time they're requested so sweeps over large sizes don't pay for it repeatedly.
+static const std::vector<Vec2>& GetPositions(Distribution distribution, size_t count)
+{
+    static std::map<std::pair<Distribution, size_t>, std::vector<Vec2>> sDatasets;
+    auto [it, inserted] = sDatasets.try_emplace({distribution, count});
+    if (inserted)
+    {
+        it->second = Generate(distribution, count, static_cast<unsigned>(count));
+    }
+    return it->second;
+}
+
+/// Returns the positions queries are made around, drawn from the same distribution as the dataset.
+static const std::vector<Vec2>& GetQueries(Distribution distribution)
+{
+    static std::map<Distribution, std::vector<Vec2>> sQueries;
+    auto [it, inserted] = sQueries.try_emplace(distribution);
+    if (inserted)
+    {
+        it->second = Generate(distribution, QueryCount, 42);
+    }
+    return it->second;
+}
+
+static Tree MakeTree(const benchmark::State& state)
+{
+    return {{-Extent, -Extent}, {Extent, Extent}, static_cast<size_t>(state.range(1)), static_cast<int>(state.range(2))};
+}
+
+static void Fill(Tree& tree, const std::vector<Vec2>& positions)
+{
+    for (size_t i = 0; i < positions.size(); ++i)
+    {
+        tree.Insert(i, positions[i]);
+    }
+}
+
+/// Reports the cost of every operation in the benchmark, where each iteration runs the given number of operations.
+static void ReportPerOperation(benchmark::State& state, size_t operationsPerIteration, size_t allocations, size_t bytes)
+{
+    double operations = static_cast<double>(state.iterations()) * operationsPerIteration;
+    state.SetItemsProcessed(static_cast<int64_t>(operations));
+    state.counters["time_per_op"] = benchmark::Counter(static_cast<double>(operationsPerIteration), benchmark::Counter::kIsIterationInvariantRate | benchmark::Counter::kInvert);
+    state.counters["allocs_per_op"] = static_cast<double>(allocations) / operations;
+    state.counters["bytes_per_op"] = static_cast<double>(bytes) / operations;
+}
+
+/// Measures heap activity made by the code between its construction and Stop, excluding any paused setup.
+struct AllocationScope
+{
+    size_t allocations = sAllocationCount;
+    size_t bytes = sAllocatedBytes;
+    size_t pausedAllocations = 0;
+    size_t pausedBytes = 0;
+    
+    void Pause()
+    {
+        pausedAllocations = sAllocationCount;
+        pausedBytes = sAllocatedBytes;
+    }
+    
+    void Resume()
+    {
+        allocations += sAllocationCount - pausedAllocations;
+        bytes += sAllocatedBytes - pausedBytes;
+    }
+    
+    std::pair<size_t, size_t> Stop() const
+    {
+        return {sAllocationCount - allocations, sAllocatedBytes - bytes};
+    }
+};
+
+static void BM_Insert(benchmark::State& state, Distribution distribution)
+{
+    const auto& positions = GetPositions(distribution, static_cast<size_t>(state.range(0)));
+    AllocationScope scope;
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        scope.Pause();
+        Tree tree = MakeTree(state);
+        scope.Resume();
+        state.ResumeTiming();
+        
+        Fill(tree, positions);
+        
+        state.PauseTiming();
+        scope.Pause();
+        tree = MakeTree(state);
+        scope.Resume();
+        state.ResumeTiming();
+    }
+    
+    auto [allocations, bytes] = scope.Stop();
+    ReportPerOperation(state, positions.size(), allocations, bytes);
+}
+
+static void BM_Build(benchmark::State& state, Distribution distribution)
+{
+    const auto& positions = GetPositions(distribution, static_cast<size_t>(state.range(0)));
+    std::vector<Tree::Element> elements;
+    AllocationScope scope;
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        scope.Pause();
+        Tree tree = MakeTree(state);
+        elements.clear();
+        for (size_t i = 0; i < positions.size(); ++i)
+        {
+            elements.push_back({i, positions[i]});
+        }
+        scope.Resume();
+        state.ResumeTiming();
+        
+        tree.Build(elements.begin(), elements.end());
+        
+        state.PauseTiming();
+        scope.Pause();
+        tree = MakeTree(state);
+        scope.Resume();
+        state.ResumeTiming();
+    }
+    
+    auto [allocations, bytes] = scope.Stop();
+    ReportPerOperation(state, positions.size(), allocations, bytes);
+}
+
+static void BM_Remove(benchmark::State& state, Distribution distribution)
+{
+    const auto& positions = GetPositions(distribution, static_cast<size_t>(state.range(0)));
+    Tree tree = MakeTree(state);
+    AllocationScope scope;
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        scope.Pause();
+        Fill(tree, positions);
+        scope.Resume();
+        state.ResumeTiming();
+        
+        for (size_t i = 0; i < positions.size(); ++i)
+        {
+            tree.Remove(i, positions[i]);
+        }
+    }
+    
+    auto [allocations, bytes] = scope.Stop();
+    ReportPerOperation(state, positions.size(), allocations, bytes);
+}
+
+static void BM_FindNearest(benchmark::State& state, Distribution distribution)
+{
+    Tree tree = MakeTree(state);
+    Fill(tree, GetPositions(distribution, static_cast<size_t>(state.range(0))));
+    
+    const auto& queries = GetQueries(distribution);
+    size_t query = 0;
+    AllocationScope scope;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(tree.FindNearest(queries[query]));
+        query = (query + 1) % queries.size();
+    }
+    
+    auto [allocations, bytes] = scope.Stop();
+    ReportPerOperation(state, 1, allocations, bytes);
+}
+
+static void BM_FindNearestFrozen(benchmark::State& state, Distribution distribution)
+{
+    Tree tree = MakeTree(state);
+    Fill(tree, GetPositions(distribution, static_cast<size_t>(state.range(0))));
+    auto frozen = tree.Freeze();
+    
+    const auto& queries = GetQueries(distribution);
+    size_t query = 0;
+    AllocationScope scope;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(frozen.FindNearest(queries[query]));
+        query = (query + 1) % queries.size();
+    }
+    
+    auto [allocations, bytes] = scope.Stop();
+    ReportPerOperation(state, 1, allocations, bytes);
+}
+
+static void BM_FindAll(benchmark::State& state, Distribution distribution)
+{
+    Tree tree = MakeTree(state);
+    Fill(tree, GetPositions(distribution, static_cast<size_t>(state.range(0))));
+    
+    // Search areas of a fixed size centred on the queries, so the result count follows the local density.
+    constexpr float HalfSize = Extent / 20;
+    const auto& queries = GetQueries(distribution);
+    size_t query = 0;
+    size_t found = 0;
+    AllocationScope scope;
+    for (auto _ : state)
+    {
+        Vec2 center = queries[query];
+        auto elements = tree.FindAll({center.x - HalfSize, center.y - HalfSize}, {center.x + HalfSize, center.y + HalfSize});
+        found += elements.size();
+        benchmark::DoNotOptimize(elements.data());
+        query = (query + 1) % queries.size();
+    }
+    
+    auto [allocations, bytes] = scope.Stop();
+    ReportPerOperation(state, 1, allocations, bytes);
+    state.counters["found_per_op"] = benchmark::Counter(static_cast<double>(found), benchmark::Counter::kAvgIterations);
+}
+
+/// Sweeps the dataset size, then the node capacity and then the maximum depth, holding the other two at typical values.
+/// The arguments of every run are the size, the node capacity and the maximum depth, in that order.
+static void Sweep(benchmark::internal::Benchmark* benchmark, bool large)
+{
+    benchmark->ArgNames({"size", "capacity", "depth"});
+    
+    std::vector<int64_t> sizes = {1'000, 10'000, 100'000, 1'000'000};
+    if (large)
+    {
+        sizes.push_back(10'000'000);
+    }
+    
+    for (int64_t size : sizes)
+    {
+        benchmark->Args({size, 8, 8});
+    }
+    
+    for (int64_t capacity : {2, 4, 16, 32, 64})
+    {
+        benchmark->Args({100'000, capacity, 8});
+    }
+    
+    for (int64_t depth : {4, 6, 10, 12})
+    {
+        benchmark->Args({100'000, 8, depth});
+    }
+}
+
+static void SweepBuild(benchmark::internal::Benchmark* benchmark)
+{
+    Sweep(benchmark, true);
+    benchmark->Unit(benchmark::kMicrosecond);
+}
+
+static void SweepQueries(benchmark::internal::Benchmark* benchmark)
+{
+    Sweep(benchmark, false);
+}
+
+#define QUADTREE_BENCHMARK(Function, Arguments) \
+    BENCHMARK_CAPTURE(Function, Uniform, Distribution::Uniform)->Apply(Arguments); \
+    BENCHMARK_CAPTURE(Function, Gaussian, Distribution::Gaussian)->Apply(Arguments); \
+    BENCHMARK_CAPTURE(Function, Line, Distribution::Line)->Apply(Arguments); \
+    BENCHMARK_CAPTURE(Function, Duplicates, Distribution::Duplicates)->Apply(Arguments)
+
+QUADTREE_BENCHMARK(BM_Insert, SweepBuild);
+QUADTREE_BENCHMARK(BM_Build, SweepBuild);
+QUADTREE_BENCHMARK(BM_Remove, SweepBuild);
+QUADTREE_BENCHMARK(BM_FindNearest, SweepQueries);
+QUADTREE_BENCHMARK(BM_FindNearestFrozen, SweepQueries);
+QUADTREE_BENCHMARK(BM_FindAll, SweepQueries);
+
+BENCHMARK_MAIN();
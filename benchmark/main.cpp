@@ -1,13 +1,53 @@
 /// Copyright (c) 2025 Jose Ilitzky
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <iterator>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <string>
+#include <thread>
 #include <glm/vec2.hpp>
+#include "AllocationCounter.h"
+#include "ConcurrentQuadtree.h"
+#include "HandleQuadtree.h"
+#include "LooseQuadtree.h"
 #include "Quadtree.h"
+#include "QuadtreeSnapshot.h"
 
 using Vec2 = glm::vec2;
 using Tree = Quadtree<size_t, Vec2>;
+using HeapTree = Quadtree<size_t, Vec2, QuadtreeHeapAllocator>;
+using CountedTree = Quadtree<size_t, Vec2, QuadtreePoolAllocator, QuadtreeStats>;
+
+/// The time spent and the heap allocations made while running an operation.
+struct Measurement
+{
+    std::chrono::nanoseconds time;
+    size_t allocations;
+};
+
+template<typename Operation>
+static Measurement Measure(Operation operation)
+{
+    size_t allocations = sAllocationCount;
+    auto start = std::chrono::high_resolution_clock::now();
+    
+    operation();
+    
+    auto end = std::chrono::high_resolution_clock::now();
+    return {std::chrono::duration_cast<std::chrono::nanoseconds>(end - start), sAllocationCount - allocations};
+}
 
 static std::istream& operator>>(std::istream& stream, Vec2& vector)
 {
@@ -40,80 +80,993 @@ static bool TryReadPositions(std::vector<Vec2>& positions)
     return true;
 }
 
-static std::chrono::nanoseconds Insertion(Tree& tree, const std::vector<Vec2>& positions)
+template<typename Tree>
+static Measurement Insertion(Tree& tree, const std::vector<Vec2>& positions)
 {
-    auto start = std::chrono::high_resolution_clock::now();
+    return Measure([&]()
+    {
+        bool success = true;
+        for (size_t i = 0; i < positions.size(); ++i)
+        {
+            success &= tree.Insert(i + 1, positions[i]);
+        }
+        
+        if (!success)
+        {
+            std::cout << "ERROR: Failed to insert positions" << std::endl;
+        }
+    });
+}
+
+template<typename Tree>
+static Measurement FindNearest(const Tree& tree, const std::vector<Vec2>& positions)
+{
+    return Measure([&]()
+    {
+        for (const auto& position : positions)
+        {
+            tree.FindNearest(position);
+        }
+    });
+}
+
+template<typename Tree>
+static Measurement FindAll(const Tree& tree, const std::vector<Vec2>& positions)
+{
+    return Measure([&]()
+    {
+        for (size_t i = 0; i < positions.size(); ++i)
+        {
+            float xAbs = std::abs(positions[i].x);
+            float yAbs = std::abs(positions[i].y);
+            Vec2 min = {-xAbs, -yAbs};
+            Vec2 max = {xAbs, yAbs};
+            tree.FindAll(min, max);
+        }
+    });
+}
+
+template<typename Tree>
+static Measurement Removal(Tree& tree, const std::vector<Vec2>& positions)
+{
+    return Measure([&]()
+    {
+        bool success = true;
+        size_t data = positions.size();
+        for (auto it = positions.rbegin(); it != positions.rend(); ++it)
+        {
+            success &= tree.Remove(data--, *it);
+        }
+        
+        if (!success)
+        {
+            std::cout << "ERROR: Failed to remove positions" << std::endl;
+        }
+    });
+}
+
+static void Print(const std::string& operation, const Measurement& measurement, size_t count)
+{
+    double allocations = static_cast<double>(measurement.allocations) / count;
+    std::cout << operation << ": " << measurement.time.count() / count << " ns, " << allocations << " allocations" << std::endl;
+}
+
+template<typename Tree>
+static void Run(const std::string& title, const std::vector<Vec2>& positions, size_t nodeCapacity, int maxDepth)
+{
+    Tree tree = {{-1000, -1000}, {1000, 1000}, nodeCapacity, maxDepth};
     
-    bool success = true;
+    // Fill and empty the tree once so the second pass shows the cost of reusing released nodes.
+    for (int pass = 1; pass <= 2; ++pass)
+    {
+        auto insertion = Insertion(tree, positions);
+        auto findNearest = FindNearest(tree, positions);
+        auto findAll = FindAll(tree, positions);
+        auto removal = Removal(tree, positions);
+        
+        size_t numPositions = positions.size();
+        std::cout << "--- " << title << " (Pass " << pass << ") ---" << std::endl;
+        Print("Insertion", insertion, numPositions);
+        Print("Find Nearest", findNearest, numPositions);
+        Print("Find All", findAll, numPositions);
+        Print("Removal", removal, numPositions);
+    }
+}
+
+static void PrintCounters(const std::string& operation, const Measurement& measurement, const QuadtreeCounters& counters, size_t count)
+{
+    Print(operation, measurement, count);
+    
+    double total = static_cast<double>(count);
+    if (counters.nodesVisited > 0)
+    {
+        // Every search enters the root, so the children it considered are all the other nodes it visited plus the ones it pruned.
+        double considered = static_cast<double>(counters.nodesVisited + counters.subtreesPruned - count);
+        double pruningRate = considered > 0 ? counters.subtreesPruned / considered : 0;
+        std::cout << "    " << counters.nodesVisited / total << " nodes visited, " << counters.leavesScanned / total << " leaves scanned, " << counters.elementsTested / total << " elements tested, " << counters.subtreesPruned / total << " subtrees pruned (" << pruningRate * 100 << "%)" << std::endl;
+    }
+    else
+    {
+        std::cout << "    " << counters.subdivisions / total << " subdivisions, " << counters.merges / total << " merges" << std::endl;
+    }
+}
+
+static void RunCounters(const std::vector<Vec2>& positions, size_t nodeCapacity, int maxDepth)
+{
+    // The counters are per operation, and the timings include the cost of counting.
+    CountedTree tree = {{-1000, -1000}, {1000, 1000}, nodeCapacity, maxDepth};
+    size_t numPositions = positions.size();
+    std::cout << "--- Counters ---" << std::endl;
+    
+    auto insertion = Insertion(tree, positions);
+    PrintCounters("Insertion", insertion, tree.GetCounters(), numPositions);
+    
+    tree.ResetCounters();
+    auto findNearest = FindNearest(tree, positions);
+    PrintCounters("Find Nearest", findNearest, tree.GetCounters(), numPositions);
+    
+    tree.ResetCounters();
+    auto findAll = FindAll(tree, positions);
+    PrintCounters("Find All", findAll, tree.GetCounters(), numPositions);
+    
+    tree.ResetCounters();
+    auto removal = Removal(tree, positions);
+    PrintCounters("Removal", removal, tree.GetCounters(), numPositions);
+}
+
+static void PrintStructure(const QuadtreeStructureStats& stats)
+{
+    std::cout << "Nodes: " << stats.nodeCount << ", Leaves: " << stats.leafCount << " (" << stats.emptyLeafCount << " empty), Max Leaf Elements: " << stats.maxLeafElements << std::endl;
+    for (size_t depth = 0; depth < stats.leavesPerDepth.size(); ++depth)
+    {
+        std::cout << "    Depth " << depth << ": " << stats.leavesPerDepth[depth] << " leaves, " << stats.elementsPerDepth[depth] << " elements" << std::endl;
+    }
+    std::cout << "Bytes: " << stats.GetTotalBytes() << " (" << stats.nodeBytes << " nodes, " << stats.elementBytes << " elements, " << stats.slackBytes << " slack)" << std::endl;
+}
+
+template<typename Tree>
+static void RunTuner(const std::vector<Vec2>& positions, size_t nodeCapacity, int maxDepth, size_t memoryBudget)
+{
+    std::cout << "--- Structure (Capacity " << nodeCapacity << ", Max Depth " << maxDepth << ") ---" << std::endl;
+    {
+        Tree tree = {{-1000, -1000}, {1000, 1000}, nodeCapacity, maxDepth};
+        Insertion(tree, positions);
+        PrintStructure(tree.GetStats());
+    }
+    
+    // Pick the configuration with the fastest nearest neighbour searches among the ones that fit in the budget.
+    std::cout << "--- Tuner (Budget " << memoryBudget << " bytes) ---" << std::endl;
+    size_t bestCapacity = 0;
+    int bestDepth = 0;
+    std::chrono::nanoseconds bestTime = std::chrono::nanoseconds::max();
+    for (size_t capacity : {4, 8, 16, 32, 64})
+    {
+        for (int depth = 4; depth <= 10; depth += 2)
+        {
+            Tree tree = {{-1000, -1000}, {1000, 1000}, capacity, depth};
+            Insertion(tree, positions);
+            QuadtreeStructureStats stats = tree.GetStats();
+            
+            auto time = FindNearest(tree, positions).time;
+            bool fits = stats.GetTotalBytes() <= memoryBudget;
+            std::cout << "Capacity " << capacity << ", Max Depth " << depth << ": " << time.count() / positions.size() << " ns, " << stats.GetTotalBytes() << " bytes, " << stats.maxLeafElements << " max leaf elements" << (fits ? "" : " (over budget)") << std::endl;
+            
+            if (fits && time < bestTime)
+            {
+                bestCapacity = capacity;
+                bestDepth = depth;
+                bestTime = time;
+            }
+        }
+    }
+    
+    if (bestCapacity == 0)
+    {
+        std::cout << "Recommendation: No configuration fits the budget" << std::endl;
+        return;
+    }
+    
+    std::cout << "Recommendation: Capacity " << bestCapacity << ", Max Depth " << bestDepth << std::endl;
+}
+
+template<typename Tree>
+static void RunFrozen(const std::vector<Vec2>& positions, size_t nodeCapacity, int maxDepth)
+{
+    Tree tree = {{-1000, -1000}, {1000, 1000}, nodeCapacity, maxDepth};
+    Insertion(tree, positions);
+    
+    typename Tree::Frozen frozen = tree.Freeze();
+    auto freeze = Measure([&]()
+    {
+        frozen = tree.Freeze();
+    });
+    
+    size_t numPositions = positions.size();
+    std::cout << "--- Frozen vs Mutable ---" << std::endl;
+    std::cout << "Freeze: " << freeze.time.count() << " ns" << std::endl;
+    Print("Find Nearest (Mutable)", FindNearest(tree, positions), numPositions);
+    Print("Find Nearest (Frozen)", FindNearest(frozen, positions), numPositions);
+    Print("Find All (Mutable)", FindAll(tree, positions), numPositions);
+    Print("Find All (Frozen)", FindAll(frozen, positions), numPositions);
+}
+
+template<typename Tree>
+static void RunFrozenCapacities(const std::vector<Vec2>& positions, int maxDepth)
+{
+    // Capacities that are multiples of the SIMD width fill every block the kernel processes.
+    std::cout << "--- Frozen Find Nearest By Capacity (SIMD Width " << QuadtreeDetail::SimdWidth << ") ---" << std::endl;
+    for (size_t nodeCapacity : {4, 6, 8, 12, 16, 24, 32})
+    {
+        Tree tree = {{-1000, -1000}, {1000, 1000}, nodeCapacity, maxDepth + 4};
+        Insertion(tree, positions);
+        auto frozen = tree.Freeze();
+        
+        std::string suffix = " (Capacity " + std::to_string(nodeCapacity) + ")";
+        Print("Find Nearest (Mutable)" + suffix, FindNearest(tree, positions), positions.size());
+        Print("Find Nearest (Frozen)" + suffix, FindNearest(frozen, positions), positions.size());
+    }
+}
+
+template<typename Tree>
+static void RunSnapshot(const std::vector<Vec2>& positions, size_t nodeCapacity, int maxDepth)
+{
+    Tree tree = {{-1000, -1000}, {1000, 1000}, nodeCapacity, maxDepth};
+    Insertion(tree, positions);
+    
+    std::string path = (std::filesystem::temp_directory_path() / "QuadtreeBenchmark.bin").string();
+    auto save = Measure([&]()
+    {
+        QuadtreeSnapshot::Save(tree, path);
+    });
+    
+    // Starting up from the text file means parsing every position and inserting it again.
+    auto rebuild = Measure([&]()
+    {
+        std::vector<Vec2> readPositions;
+        TryReadPositions(readPositions);
+        
+        Tree rebuilt = {{-1000, -1000}, {1000, 1000}, nodeCapacity, maxDepth};
+        for (size_t i = 0; i < readPositions.size(); ++i)
+        {
+            rebuilt.Insert(i, readPositions[i]);
+        }
+    });
+    
+    std::optional<typename Tree::Frozen> mapped;
+    auto load = Measure([&]()
+    {
+        mapped = QuadtreeSnapshot::LoadMapped<size_t, Vec2>(path);
+    });
+    
+    std::cout << "--- Snapshot Startup ---" << std::endl;
+    if (!mapped)
+    {
+        std::cout << "ERROR: Failed to load snapshot" << std::endl;
+        return;
+    }
+    
+    std::cout << "Save: " << save.time.count() << " ns" << std::endl;
+    std::cout << "Rebuild From Positions.txt: " << rebuild.time.count() << " ns" << std::endl;
+    std::cout << "Load Mapped: " << load.time.count() << " ns" << std::endl;
+    Print("Find Nearest (Mapped)", FindNearest(*mapped, positions), positions.size());
+    Print("Find All (Mapped)", FindAll(*mapped, positions), positions.size());
+    
+    mapped.reset();
+    std::filesystem::remove(path);
+}
+
+template<typename Tree>
+static void RunBuild(const std::vector<Vec2>& positions, size_t nodeCapacity, int maxDepth)
+{
+    std::vector<typename Tree::Element> elements;
     for (size_t i = 0; i < positions.size(); ++i)
     {
-        success &= tree.Insert(i + 1, positions[i]);
+        elements.push_back({i + 1, positions[i]});
     }
     
-    if (!success)
+    Tree inserted = {{-1000, -1000}, {1000, 1000}, nodeCapacity, maxDepth};
+    auto insertion = Insertion(inserted, positions);
+    
+    Tree built = {{-1000, -1000}, {1000, 1000}, nodeCapacity, maxDepth};
+    auto build = Measure([&]()
+    {
+        built.Build(elements.begin(), elements.end());
+    });
+    
+    size_t numPositions = positions.size();
+    std::cout << "--- Bulk Construction ---" << std::endl;
+    Print("Insertion", insertion, numPositions);
+    Print("Build", build, numPositions);
+}
+
+template<typename Tree>
+static void RunKNearest(const std::vector<Vec2>& positions, size_t nodeCapacity, int maxDepth, size_t k)
+{
+    Tree tree = {{-1000, -1000}, {1000, 1000}, nodeCapacity, maxDepth};
+    Insertion(tree, positions);
+    
+    // Repeatedly searching for the nearest element while excluding previous results.
+    auto repeated = Measure([&]()
+    {
+        std::vector<size_t> found;
+        for (const auto& position : positions)
+        {
+            found.clear();
+            auto isNew = [&found](const auto& element) { return std::find(found.begin(), found.end(), element.data) == found.end(); };
+            while (found.size() < k)
+            {
+                auto nearest = tree.FindNearest(position, isNew);
+                if (!nearest)
+                {
+                    break;
+                }
+                found.push_back(nearest->data);
+            }
+        }
+    });
+    
+    std::vector<typename Tree::Element> nearest;
+    auto bounded = Measure([&]()
+    {
+        for (const auto& position : positions)
+        {
+            tree.FindKNearest(position, k, nearest);
+        }
+    });
+    
+    // Consuming the lazy sequence until k elements were seen, as a caller that doesn't know k in advance would.
+    auto lazy = Measure([&]()
+    {
+        for (const auto& position : positions)
+        {
+            size_t count = 0;
+            auto range = tree.NearestRange(position);
+            for (auto it = range.begin(); it != range.end() && count < k; ++it)
+            {
+                ++count;
+            }
+        }
+    });
+    
+    size_t numPositions = positions.size();
+    std::cout << "--- Find " << k << " Nearest ---" << std::endl;
+    Print("Repeated Find Nearest", repeated, numPositions);
+    Print("Find K Nearest", bounded, numPositions);
+    Print("Nearest Range", lazy, numPositions);
+}
+
+template<typename Tree>
+static void RunAreaQueries(const std::vector<Vec2>& positions, size_t nodeCapacity, int maxDepth)
+{
+    Tree tree = {{-1000, -1000}, {1000, 1000}, nodeCapacity, maxDepth};
+    Insertion(tree, positions);
+    
+    auto forEachInArea = Measure([&]()
+    {
+        for (const auto& position : positions)
+        {
+            float xAbs = std::abs(position.x);
+            float yAbs = std::abs(position.y);
+            size_t count = 0;
+            tree.ForEachInArea({-xAbs, -yAbs}, {xAbs, yAbs}, [&count](const auto&)
+            {
+                ++count;
+                return true;
+            });
+        }
+    });
+    
+    std::vector<typename Tree::Element> elements;
+    auto findAllInto = Measure([&]()
+    {
+        for (const auto& position : positions)
+        {
+            float xAbs = std::abs(position.x);
+            float yAbs = std::abs(position.y);
+            elements.clear();
+            tree.FindAllInto({-xAbs, -yAbs}, {xAbs, yAbs}, std::back_inserter(elements));
+        }
+    });
+    
+    auto countInArea = Measure([&]()
+    {
+        for (const auto& position : positions)
+        {
+            float xAbs = std::abs(position.x);
+            float yAbs = std::abs(position.y);
+            tree.CountInArea({-xAbs, -yAbs}, {xAbs, yAbs});
+        }
+    });
+    
+    size_t numPositions = positions.size();
+    std::cout << "--- Area Queries ---" << std::endl;
+    Print("Find All", FindAll(tree, positions), numPositions);
+    Print("Find All Into (Reused Buffer)", findAllInto, numPositions);
+    Print("For Each In Area (Count)", forEachInArea, numPositions);
+    Print("Count In Area (Cached Counts)", countInArea, numPositions);
+}
+
+template<typename Tree>
+static void RunRadiusQueries(const std::vector<Vec2>& positions, size_t nodeCapacity, int maxDepth, float radius)
+{
+    Tree tree = {{-1000, -1000}, {1000, 1000}, nodeCapacity, maxDepth};
+    Insertion(tree, positions);
+    
+    // The baseline queries the bounding square of the circle and discards the corners afterwards.
+    auto boundingSquare = Measure([&]()
+    {
+        for (const auto& position : positions)
+        {
+            auto elements = tree.FindAll({position.x - radius, position.y - radius}, {position.x + radius, position.y + radius});
+            elements.erase(std::remove_if(elements.begin(), elements.end(), [&](const auto& element)
+            {
+                float distanceX = element.position.x - position.x;
+                float distanceY = element.position.y - position.y;
+                return (distanceX * distanceX) + (distanceY * distanceY) > radius * radius;
+            }), elements.end());
+        }
+    });
+    
+    auto findInRadius = Measure([&]()
+    {
+        for (const auto& position : positions)
+        {
+            auto elements = tree.FindInRadius(position, radius);
+        }
+    });
+    
+    auto forEachInRadius = Measure([&]()
     {
-        std::cout << "ERROR: Failed to insert positions" << std::endl;
+        for (const auto& position : positions)
+        {
+            size_t count = 0;
+            tree.ForEachInRadius(position, radius, [&count](const auto&)
+            {
+                ++count;
+                return true;
+            });
+        }
+    });
+    
+    size_t numPositions = positions.size();
+    std::cout << "--- Radius Queries (Radius " << radius << ") ---" << std::endl;
+    Print("Find All + Distance Filter", boundingSquare, numPositions);
+    Print("Find In Radius", findInRadius, numPositions);
+    Print("For Each In Radius (Count)", forEachInRadius, numPositions);
+}
+
+template<typename Tree>
+static void RunRayCasts(const std::vector<Vec2>& positions, size_t nodeCapacity, int maxDepth, float hitRadius)
+{
+    Tree tree = {{-1000, -1000}, {1000, 1000}, nodeCapacity, maxDepth};
+    Insertion(tree, positions);
+    
+    // Long diagonal segments from every position toward the one halfway through the list.
+    auto getEnd = [&](size_t i) { return positions[(i + positions.size() / 2) % positions.size()]; };
+    
+    // The baseline searches the bounding box of the segment, then tests and sorts every candidate.
+    auto boundingBox = Measure([&]()
+    {
+        for (size_t i = 0; i < positions.size(); ++i)
+        {
+            Vec2 start = positions[i];
+            Vec2 end = getEnd(i);
+            QuadtreeDetail::Ray<Vec2> ray(start, end.x - start.x, end.y - start.y, std::hypot(end.x - start.x, end.y - start.y), hitRadius);
+            
+            Vec2 min = {std::min(start.x, end.x) - hitRadius, std::min(start.y, end.y) - hitRadius};
+            Vec2 max = {std::max(start.x, end.x) + hitRadius, std::max(start.y, end.y) + hitRadius};
+            std::vector<std::pair<float, size_t>> hits;
+            for (const auto& element : tree.FindAll(min, max))
+            {
+                float distance;
+                if (ray.Hit(element.position, distance))
+                {
+                    hits.push_back({distance, element.data});
+                }
+            }
+            std::sort(hits.begin(), hits.end());
+        }
+    });
+    
+    auto rayCast = Measure([&]()
+    {
+        for (size_t i = 0; i < positions.size(); ++i)
+        {
+            Vec2 end = getEnd(i);
+            tree.RayCast(positions[i], end - positions[i], std::hypot(end.x - positions[i].x, end.y - positions[i].y), hitRadius);
+        }
+    });
+    
+    auto forEachAlongSegment = Measure([&]()
+    {
+        for (size_t i = 0; i < positions.size(); ++i)
+        {
+            size_t count = 0;
+            tree.ForEachAlongSegment(positions[i], getEnd(i), hitRadius, [&count](const auto&)
+            {
+                ++count;
+                return true;
+            });
+        }
+    });
+    
+    size_t numPositions = positions.size();
+    std::cout << "--- Ray Casts (Hit Radius " << hitRadius << ") ---" << std::endl;
+    Print("Find All + Sort (All Hits)", boundingBox, numPositions);
+    Print("Ray Cast (First Hit)", rayCast, numPositions);
+    Print("For Each Along Segment (All Hits)", forEachAlongSegment, numPositions);
+}
+
+template<typename Tree>
+static void RunPairs(const std::vector<Vec2>& positions, size_t nodeCapacity, int maxDepth, float distance)
+{
+    Tree tree = {{-1000, -1000}, {1000, 1000}, nodeCapacity, maxDepth};
+    Insertion(tree, positions);
+    
+    // The baseline searches around every element and keeps only the pairs where it comes first, so each pair is reached twice.
+    size_t radiusPairs = 0;
+    auto radiusSearches = Measure([&]()
+    {
+        for (size_t i = 0; i < positions.size(); ++i)
+        {
+            tree.ForEachInRadius(positions[i], distance, [&](const auto& element)
+            {
+                radiusPairs += element.data > i + 1;
+                return true;
+            });
+        }
+    });
+    
+    size_t pairs = 0;
+    auto findAllPairs = Measure([&]()
+    {
+        tree.FindAllPairs(distance, [&pairs](const auto&, const auto&) { ++pairs; });
+    });
+    
+    QuadtreeThreadPool threadPool;
+    std::atomic<size_t> parallelPairs = 0;
+    auto findAllPairsParallel = Measure([&]()
+    {
+        tree.FindAllPairs(distance, [&parallelPairs](const auto&, const auto&) { parallelPairs.fetch_add(1, std::memory_order_relaxed); }, threadPool);
+    });
+    
+    if (radiusPairs != pairs || parallelPairs != pairs)
+    {
+        std::cout << "ERROR: Pair searches disagree" << std::endl;
     }
     
-    auto end = std::chrono::high_resolution_clock::now();
-    return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+    size_t numPositions = positions.size();
+    std::cout << "--- All Pairs (Distance " << distance << ", " << pairs << " Pairs, " << threadPool.GetThreadCount() << " Threads) ---" << std::endl;
+    Print("For Each In Radius (Every Element)", radiusSearches, numPositions);
+    Print("Find All Pairs", findAllPairs, numPositions);
+    Print("Find All Pairs (Parallel)", findAllPairsParallel, numPositions);
 }
 
-static std::chrono::nanoseconds FindNearest(Tree& tree, const std::vector<Vec2>& positions)
+template<typename Tree>
+static void RunAutoGrow(const std::vector<Vec2>& positions, size_t nodeCapacity, int maxDepth)
 {
-    auto start = std::chrono::high_resolution_clock::now();
+    // Oversizing the bounds to be safe spends the depth budget on empty space, while growing keeps leaves sized for the populated area.
+    Tree oversizedTree = {{-100000, -100000}, {100000, 100000}, nodeCapacity, maxDepth};
+    auto oversizedInsertion = Insertion(oversizedTree, positions);
+    
+    Tree growingTree = {{-10, -10}, {10, 10}, nodeCapacity, maxDepth};
+    growingTree.SetAutoGrow(true);
+    auto growingInsertion = Insertion(growingTree, positions);
+    
+    size_t numPositions = positions.size();
+    std::cout << "--- Auto Grow ---" << std::endl;
+    Print("Insertion (Oversized Bounds)", oversizedInsertion, numPositions);
+    Print("Insertion (Auto Grow)", growingInsertion, numPositions);
+    Print("Find Nearest (Oversized Bounds)", FindNearest(oversizedTree, positions), numPositions);
+    Print("Find Nearest (Auto Grow)", FindNearest(growingTree, positions), numPositions);
+}
+
+template<typename Tree>
+static void RunOscillation(const std::vector<Vec2>& positions, size_t nodeCapacity, int maxDepth, int rounds)
+{
+    // Every round adds an element next to each position and removes it right away, pushing full leaves back and forth across their capacity.
+    auto oscillate = [&](Tree& tree, bool compact)
+    {
+        return Measure([&]()
+        {
+            size_t numPositions = positions.size();
+            for (int round = 0; round < rounds; ++round)
+            {
+                for (size_t i = 0; i < numPositions; ++i)
+                {
+                    tree.Insert(numPositions + i, positions[i]);
+                    tree.Remove(numPositions + i, positions[i]);
+                }
+                
+                if (compact)
+                {
+                    tree.Compact();
+                }
+            }
+        });
+    };
+    
+    Tree eagerTree = {{-1000, -1000}, {1000, 1000}, nodeCapacity, maxDepth};
+    Insertion(eagerTree, positions);
+    auto eager = oscillate(eagerTree, false);
+    
+    Tree thresholdTree = {{-1000, -1000}, {1000, 1000}, nodeCapacity, maxDepth};
+    thresholdTree.SetMergeThreshold(nodeCapacity / 2);
+    Insertion(thresholdTree, positions);
+    auto threshold = oscillate(thresholdTree, false);
     
+    Tree lazyTree = {{-1000, -1000}, {1000, 1000}, nodeCapacity, maxDepth};
+    lazyTree.SetLazyMerge(true);
+    Insertion(lazyTree, positions);
+    auto lazy = oscillate(lazyTree, true);
+    
+    size_t operations = positions.size() * 2 * rounds;
+    std::cout << "--- Oscillation ---" << std::endl;
+    Print("Insert + Remove (Merge At Capacity)", eager, operations);
+    Print("Insert + Remove (Merge At Half Capacity)", threshold, operations);
+    Print("Insert + Remove (Lazy Merge + Compact)", lazy, operations);
+}
+
+template<typename Tree>
+static void RunMovingObjects(const std::vector<Vec2>& positions, size_t nodeCapacity, int maxDepth, int frames)
+{
+    // Every frame nudges each position by a small deterministic offset that stays within the tree's bounds.
+    auto move = [](const Vec2& position, size_t index, int frame)
+    {
+        float offsetX = static_cast<float>(static_cast<int>((index * 7 + frame * 13) % 11) - 5);
+        float offsetY = static_cast<float>(static_cast<int>((index * 5 + frame * 17) % 11) - 5);
+        return Vec2(std::clamp(position.x + offsetX, -1000.0f, 1000.0f), std::clamp(position.y + offsetY, -1000.0f, 1000.0f));
+    };
+    
+    Tree removeInsertTree = {{-1000, -1000}, {1000, 1000}, nodeCapacity, maxDepth};
+    Insertion(removeInsertTree, positions);
+    std::vector<Vec2> current = positions;
+    auto removeInsert = Measure([&]()
+    {
+        for (int frame = 0; frame < frames; ++frame)
+        {
+            for (size_t i = 0; i < current.size(); ++i)
+            {
+                Vec2 next = move(current[i], i, frame);
+                removeInsertTree.Remove(i + 1, current[i]);
+                removeInsertTree.Insert(i + 1, next);
+                current[i] = next;
+            }
+        }
+    });
+    
+    Tree updateTree = {{-1000, -1000}, {1000, 1000}, nodeCapacity, maxDepth};
+    Insertion(updateTree, positions);
+    current = positions;
+    auto update = Measure([&]()
+    {
+        for (int frame = 0; frame < frames; ++frame)
+        {
+            for (size_t i = 0; i < current.size(); ++i)
+            {
+                Vec2 next = move(current[i], i, frame);
+                updateTree.Update(i + 1, current[i], next);
+                current[i] = next;
+            }
+        }
+    });
+    
+    size_t numMoves = positions.size() * frames;
+    std::cout << "--- Moving Objects ---" << std::endl;
+    Print("Remove + Insert", removeInsert, numMoves);
+    Print("Update", update, numMoves);
+}
+
+static void RunHandles(const std::vector<Vec2>& positions, size_t nodeCapacity, int maxDepth)
+{
+    // A payload large enough that comparing and moving it inside the leaves becomes noticeable.
+    using Payload = std::array<size_t, 16>;
+    auto makePayload = [](size_t i)
+    {
+        Payload payload = {};
+        payload.back() = i;
+        return payload;
+    };
+    
+    // Every element moves by a small step, as it would from one frame to the next.
+    std::vector<Vec2> moved;
     for (const auto& position : positions)
     {
-        tree.FindNearest(position);
+        moved.push_back({std::clamp(position.x + 1.0f, -1000.0f, 1000.0f), std::clamp(position.y - 1.0f, -1000.0f, 1000.0f)});
     }
     
-    auto end = std::chrono::high_resolution_clock::now();
-    return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+    Quadtree<Payload, Vec2> tree = {{-1000, -1000}, {1000, 1000}, nodeCapacity, maxDepth};
+    auto insertion = Measure([&]()
+    {
+        for (size_t i = 0; i < positions.size(); ++i)
+        {
+            tree.Insert(makePayload(i), positions[i]);
+        }
+    });
+    
+    auto findNearest = FindNearest(tree, positions);
+    
+    auto update = Measure([&]()
+    {
+        for (size_t i = 0; i < positions.size(); ++i)
+        {
+            tree.Update(makePayload(i), positions[i], moved[i]);
+        }
+    });
+    
+    auto removal = Measure([&]()
+    {
+        for (size_t i = positions.size(); i-- > 0;)
+        {
+            tree.Remove(makePayload(i), moved[i]);
+        }
+    });
+    
+    HandleQuadtree<Payload, Vec2> handleTree = {{-1000, -1000}, {1000, 1000}, nodeCapacity, maxDepth};
+    std::vector<QuadtreeHandle> handles;
+    auto handleInsertion = Measure([&]()
+    {
+        for (size_t i = 0; i < positions.size(); ++i)
+        {
+            handles.push_back(*handleTree.Insert(makePayload(i), positions[i]));
+        }
+    });
+    
+    auto handleFindNearest = FindNearest(handleTree, positions);
+    
+    auto handleUpdate = Measure([&]()
+    {
+        for (size_t i = 0; i < handles.size(); ++i)
+        {
+            handleTree.Update(handles[i], moved[i]);
+        }
+    });
+    
+    auto handleRemoval = Measure([&]()
+    {
+        for (auto it = handles.rbegin(); it != handles.rend(); ++it)
+        {
+            handleTree.Remove(*it);
+        }
+    });
+    
+    size_t numPositions = positions.size();
+    std::cout << "--- Handles (" << sizeof(Payload) << " Byte Payload) ---" << std::endl;
+    Print("Insertion", insertion, numPositions);
+    Print("Insertion (Handles)", handleInsertion, numPositions);
+    Print("Find Nearest", findNearest, numPositions);
+    Print("Find Nearest (Handles)", handleFindNearest, numPositions);
+    Print("Update", update, numPositions);
+    Print("Update (Handles)", handleUpdate, numPositions);
+    Print("Removal", removal, numPositions);
+    Print("Removal (Handles)", handleRemoval, numPositions);
 }
 
-static std::chrono::nanoseconds FindAll(Tree& tree, const std::vector<Vec2>& positions)
+template<typename Tree>
+static void RunBatchModification(const std::vector<Vec2>& positions, size_t nodeCapacity, int maxDepth, size_t batchSize)
 {
-    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<typename Tree::Element> elements;
+    for (size_t i = 0; i < positions.size(); ++i)
+    {
+        elements.push_back({i + 1, positions[i]});
+    }
+    
+    Tree tree = {{-1000, -1000}, {1000, 1000}, nodeCapacity, maxDepth};
+    auto insertion = Insertion(tree, positions);
+    auto removal = Removal(tree, positions);
+    
+    auto batchInsertion = Measure([&]()
+    {
+        for (size_t i = 0; i < elements.size(); i += batchSize)
+        {
+            tree.InsertBatch(elements.begin() + i, elements.begin() + std::min(i + batchSize, elements.size()));
+        }
+    });
+    
+    auto batchRemoval = Measure([&]()
+    {
+        for (size_t i = 0; i < elements.size(); i += batchSize)
+        {
+            tree.RemoveBatch(elements.begin() + i, elements.begin() + std::min(i + batchSize, elements.size()));
+        }
+    });
+    
+    size_t numPositions = positions.size();
+    std::cout << "--- Batch Modification (" << batchSize << " Elements) ---" << std::endl;
+    Print("Insertion", insertion, numPositions);
+    Print("Insert Batch", batchInsertion, numPositions);
+    Print("Removal", removal, numPositions);
+    Print("Remove Batch", batchRemoval, numPositions);
+}
+
+static void RunLooseBounds(const std::vector<Vec2>& positions, size_t nodeCapacity, int maxDepth)
+{
+    // Mostly small boxes with the occasional large one, so the largest size is a poor estimate for the rest.
+    auto getHalfSize = [](size_t i) { return i % 64 == 0 ? 32.0f : 2.0f; };
+    float maxHalfSize = 32.0f;
+    float queryHalfSize = 10.0f;
+    
+    // The baseline stores the center of every box and inflates the queries by the largest half size before testing the boxes.
+    Quadtree<size_t, Vec2> pointTree = {{-1000, -1000}, {1000, 1000}, nodeCapacity, maxDepth};
+    auto pointInsertion = Measure([&]()
+    {
+        for (size_t i = 0; i < positions.size(); ++i)
+        {
+            pointTree.Insert(i, positions[i]);
+        }
+    });
+    
+    auto pointQueries = Measure([&]()
+    {
+        for (const auto& position : positions)
+        {
+            float reach = queryHalfSize + maxHalfSize;
+            auto elements = pointTree.FindAll({position.x - reach, position.y - reach}, {position.x + reach, position.y + reach}, [&](const auto& element)
+            {
+                float halfSize = getHalfSize(element.data);
+                return std::abs(element.position.x - position.x) <= queryHalfSize + halfSize && std::abs(element.position.y - position.y) <= queryHalfSize + halfSize;
+            });
+        }
+    });
     
-    for (size_t i = 0; i < positions.size(); i = ++i)
+    LooseQuadtree<size_t, Vec2> looseTree = {{-1000, -1000}, {1000, 1000}, nodeCapacity, maxDepth};
+    auto looseInsertion = Measure([&]()
     {
-        float xAbs = std::abs(positions[i].x);
-        float yAbs = std::abs(positions[i].y);
-        Vec2 min = {-xAbs, -yAbs};
-        Vec2 max = {xAbs, yAbs};
-        tree.FindAll(min, max);
+        for (size_t i = 0; i < positions.size(); ++i)
+        {
+            float halfSize = getHalfSize(i);
+            looseTree.Insert(i, {{positions[i].x - halfSize, positions[i].y - halfSize}, {positions[i].x + halfSize, positions[i].y + halfSize}});
+        }
+    });
+    
+    auto looseQueries = Measure([&]()
+    {
+        for (const auto& position : positions)
+        {
+            auto elements = looseTree.FindOverlapping({{position.x - queryHalfSize, position.y - queryHalfSize}, {position.x + queryHalfSize, position.y + queryHalfSize}});
+        }
+    });
+    
+    size_t numPositions = positions.size();
+    std::cout << "--- Loose Bounds (Looseness " << looseTree.GetLooseness() << ") ---" << std::endl;
+    Print("Insertion (Centers)", pointInsertion, numPositions);
+    Print("Insertion (Loose)", looseInsertion, numPositions);
+    Print("Find Overlapping (Inflated Query)", pointQueries, numPositions);
+    Print("Find Overlapping (Loose)", looseQueries, numPositions);
+}
+
+template<typename Tree>
+static void RunBatchScaling(const std::vector<Vec2>& positions, size_t nodeCapacity, int maxDepth)
+{
+    Tree tree = {{-1000, -1000}, {1000, 1000}, nodeCapacity, maxDepth};
+    Insertion(tree, positions);
+    
+    // Keep the areas small since the results of every query in a batch are held at once.
+    std::vector<std::pair<Vec2, Vec2>> areas;
+    for (const auto& position : positions)
+    {
+        areas.push_back({{position.x - 50, position.y - 50}, {position.x + 50, position.y + 50}});
     }
     
-    auto end = std::chrono::high_resolution_clock::now();
-    return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+    size_t numPositions = positions.size();
+    size_t maxThreads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    std::cout << "--- Batch Scaling ---" << std::endl;
+    
+    for (size_t threads = 1; threads <= maxThreads; ++threads)
+    {
+        QuadtreeThreadPool threadPool(threads);
+        std::vector<std::optional<typename Tree::Element>> nearest;
+        std::vector<std::vector<typename Tree::Element>> foundElements;
+        
+        auto findNearest = Measure([&]()
+        {
+            tree.FindNearestBatch(positions, nearest, threadPool);
+        });
+        
+        auto findAll = Measure([&]()
+        {
+            tree.FindAllBatch(areas, foundElements, threadPool);
+        });
+        
+        std::string suffix = " (" + std::to_string(threads) + " Threads)";
+        Print("Find Nearest Batch" + suffix, findNearest, numPositions);
+        Print("Find All Batch" + suffix, findAll, numPositions);
+    }
 }
 
-static std::chrono::nanoseconds Removal(Tree& tree, const std::vector<Vec2>& positions)
+/// Measures how long a group of reader threads takes to run a search for every position while a writer thread keeps modifying the tree.
+template<typename Search, typename Write>
+static Measurement MeasureReadersWithWriter(size_t numPositions, size_t readerCount, Search search, Write write)
 {
-    auto start = std::chrono::high_resolution_clock::now();
+    std::atomic<bool> done = false;
+    std::thread writer([&]()
+    {
+        for (size_t i = 0; !done; i = (i + 1) % numPositions)
+        {
+            write(i);
+        }
+    });
     
+    auto measurement = Measure([&]()
+    {
+        std::vector<std::thread> readers;
+        for (size_t reader = 0; reader < readerCount; ++reader)
+        {
+            readers.emplace_back([&, reader]()
+            {
+                for (size_t i = reader; i < numPositions; i += readerCount)
+                {
+                    search(i);
+                }
+            });
+        }
+        
+        for (auto& reader : readers)
+        {
+            reader.join();
+        }
+    });
+    
+    done = true;
+    writer.join();
+    return measurement;
+}
+
+static void RunConcurrentAccess(const std::vector<Vec2>& positions, size_t nodeCapacity, int maxDepth)
+{
+    size_t numPositions = positions.size();
+    size_t readerCount = std::max<size_t>(std::thread::hardware_concurrency(), 2) - 1;
+    
+    // Both writers move the elements added by Insertion out and back in, so every removal has to find its element.
     bool success = true;
-    size_t data = positions.size();
-    for (auto it = positions.rbegin(); it != positions.rend(); ++it)
+    
+    // The baseline guards a regular tree with a single mutex, so searches wait for each other and for the writer.
+    Tree lockedTree = {{-1000, -1000}, {1000, 1000}, nodeCapacity, maxDepth};
+    Insertion(lockedTree, positions);
+    std::mutex mutex;
+    
+    auto globalMutex = MeasureReadersWithWriter(numPositions, readerCount, [&](size_t i)
     {
-        success &= tree.Remove(data--, *it);
-    }
+        std::lock_guard<std::mutex> lock(mutex);
+        lockedTree.FindNearest(positions[i]);
+    },
+    [&](size_t i)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        success &= lockedTree.Remove(i + 1, positions[i]);
+        success &= lockedTree.Insert(i + 1, positions[i]);
+    });
+    
+    ConcurrentQuadtree<size_t, Vec2> concurrentTree = {{-1000, -1000}, {1000, 1000}, nodeCapacity, maxDepth};
+    Insertion(concurrentTree, positions);
     
-    if (!success)
+    auto nodeLocks = MeasureReadersWithWriter(numPositions, readerCount, [&](size_t i)
     {
-        std::cout << "ERROR: Failed to remove positions" << std::endl;
+        concurrentTree.FindNearest(positions[i]);
+    },
+    [&](size_t i)
+    {
+        success &= concurrentTree.Remove(i + 1, positions[i]);
+        success &= concurrentTree.Insert(i + 1, positions[i]);
+    });
+    
+    if (!success || lockedTree.CountElements() != numPositions || concurrentTree.CountElements() != numPositions)
+    {
+        std::cout << "ERROR: Failed to move positions out and back in" << std::endl;
     }
     
-    auto end = std::chrono::high_resolution_clock::now();
-    return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+    std::cout << "--- Concurrent Access (" << readerCount << " Readers, 1 Writer) ---" << std::endl;
+    Print("Find Nearest (Global Mutex)", globalMutex, numPositions);
+    Print("Find Nearest (Node Locks)", nodeLocks, numPositions);
 }
 
-int main()
+int main(int argc, char** argv)
 {
     size_t nodeCapacity = 8;
     int maxDepth = 4;
-    Tree tree = {{-1000, -1000}, {1000, 1000}, nodeCapacity, maxDepth};
+    
+    // The memory budget the tuner sizes trees for can be passed in bytes as the first argument.
+    size_t memoryBudget = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1 << 20;
     
     std::vector<Vec2> positions;
     if (!TryReadPositions(positions))
@@ -122,16 +1075,27 @@ int main()
         return 1;
     }
     
-    auto insertion = Insertion(tree, positions);
-    auto findNearest = FindNearest(tree, positions);
-    auto findAll = FindAll(tree, positions);
-    auto removal = Removal(tree, positions);
-    
-    size_t numPositions = positions.size();
-    std::cout << "Insertion: " << insertion.count() / numPositions << " ns" << std::endl;
-    std::cout << "Find Nearest: " << findNearest.count() / numPositions << " ns" << std::endl;
-    std::cout << "Find All: " << findAll.count() / numPositions << " ns" << std::endl;
-    std::cout << "Removal: " << removal.count() / numPositions << " ns" << std::endl;
+    Run<Tree>("Pool Allocator", positions, nodeCapacity, maxDepth);
+    Run<HeapTree>("Heap Allocator", positions, nodeCapacity, maxDepth);
+    RunCounters(positions, nodeCapacity, maxDepth);
+    RunTuner<Tree>(positions, nodeCapacity, maxDepth, memoryBudget);
+    RunFrozen<Tree>(positions, nodeCapacity, maxDepth);
+    RunFrozenCapacities<Tree>(positions, maxDepth);
+    RunSnapshot<Tree>(positions, nodeCapacity, maxDepth);
+    RunBuild<Tree>(positions, nodeCapacity, maxDepth);
+    RunKNearest<Tree>(positions, nodeCapacity, maxDepth, 8);
+    RunAreaQueries<Tree>(positions, nodeCapacity, maxDepth);
+    RunRadiusQueries<Tree>(positions, nodeCapacity, maxDepth, 100);
+    RunRayCasts<Tree>(positions, nodeCapacity, maxDepth, 5);
+    RunPairs<Tree>(positions, nodeCapacity, maxDepth, 20);
+    RunAutoGrow<Tree>(positions, nodeCapacity, maxDepth);
+    RunOscillation<Tree>(positions, nodeCapacity, maxDepth, 4);
+    RunMovingObjects<Tree>(positions, nodeCapacity, maxDepth, 10);
+    RunBatchModification<Tree>(positions, nodeCapacity, maxDepth, 1000);
+    RunHandles(positions, nodeCapacity, maxDepth);
+    RunLooseBounds(positions, nodeCapacity, maxDepth);
+    RunBatchScaling<Tree>(positions, nodeCapacity, maxDepth);
+    RunConcurrentAccess(positions, nodeCapacity, maxDepth);
     
     return 0;
 }
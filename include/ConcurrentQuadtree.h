@@ -0,0 +1,502 @@
+/// Copyright (c) 2025 Jose Ilitzky
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "Quadtree.h"
+
+/// A Quadtree that can be searched and modified from many threads at once.
+/// Every node has its own reader-writer lock, so writers only block the searches that visit the subtree they are modifying.
+/// @tparam T The type of data representing elements in the tree.
+/// @tparam Vec2 The type of 2D vector to use.
+/// @tparam Allocator The allocator policy that provides storage for each block of four child nodes, which is only used while holding a lock.
+template<typename T, typename Vec2, template<typename> class Allocator = QuadtreePoolAllocator>
+class ConcurrentQuadtree
+{
+public:
+    using Element = QuadtreeElement<T, Vec2>;
+    using Scalar = QuadtreeDetail::Scalar<Vec2>;
+    
+    /// Construct a ConcurrentQuadtree that covers the given bounds.
+    /// @param min The minimum point describing the area covered by the tree.
+    /// @param max The maximum point describing the area covered by the tree.
+    /// @param nodeCapacity The maximum number of elements that a node within the tree can store before subdividing.
+    /// @param maxDepth The maximum depth the tree can have from its root to the furthest leaf.
+    ConcurrentQuadtree(const Vec2& min, const Vec2& max, size_t nodeCapacity = 8, int maxDepth = 4) : mRoot({min, max}, 0), mNodeCapacity(nodeCapacity), mMaxDepth(maxDepth)
+    {
+    }
+    
+    /// Copy constructor is deleted since the locks can't be shared between trees.
+    ConcurrentQuadtree(const ConcurrentQuadtree&) = delete;
+    
+    /// Destructor that returns the storage of every child node to the allocator, which can't be used by any other thread by then.
+    ~ConcurrentQuadtree()
+    {
+        mRoot.Clear(mAllocator);
+    }
+    
+    /// Calculates the height of the tree from its deepest branch.
+    /// @return The height of the tree.
+    size_t GetHeight() const
+    {
+        std::shared_lock<std::shared_mutex> lock(mRoot.mutex);
+        return mRoot.GetHeight();
+    }
+    
+    /// Counts the total number of elements in the tree.
+    /// @return The total number of elements.
+    size_t CountElements() const
+    {
+        return mCount.load(std::memory_order_relaxed);
+    }
+    
+    /// Inserts a new element with the given data and position.
+    /// @param data The data representing the element.
+    /// @param position The position where the element is.
+    /// @return True if the element was successfully inserted.
+    bool Insert(T data, const Vec2& position)
+    {
+        if (!mRoot.bounds.Contains(position))
+        {
+            return false;
+        }
+        
+        auto [leaf, lock] = LockLeaf(position);
+        leaf->elements.push_back({std::move(data), position});
+        mCount.fetch_add(1, std::memory_order_relaxed);
+        
+        if (leaf->elements.size() > mNodeCapacity && leaf->depth < mMaxDepth)
+        {
+            // The new children can't be reached until the leaf is unlocked, so they are filled without locking them.
+            leaf->Subdivide(mNodeCapacity, mMaxDepth, mAllocator);
+        }
+        
+        return true;
+    }
+    
+    /// Removes an element matching the given data and position.
+    /// @param data The data representing the element.
+    /// @param position The position where the element is.
+    /// @return True if the element was successfully removed.
+    bool Remove(const T& data, const Vec2& position)
+    {
+        if (!mRoot.bounds.Contains(position))
+        {
+            return false;
+        }
+        
+        int depth = 0;
+        {
+            auto [leaf, lock] = LockLeaf(position);
+            if (!SharedNode::RemoveElement(leaf->elements, data, position))
+            {
+                return false;
+            }
+            
+            mCount.fetch_sub(1, std::memory_order_relaxed);
+            depth = leaf->depth;
+        }
+        
+        // Merging locks a branch before its children, so it only starts once the leaf is released and moves up one level at a time.
+        for (int parentDepth = depth - 1; parentDepth >= 0 && TryMerge(position, parentDepth); --parentDepth)
+        {
+        }
+        
+        return true;
+    }
+    
+    /// Finds the closest element to the target position that passes a filter.
+    /// @tparam Filter A function that takes in an element and returns true if it qualifies for the search, which must be safe to call concurrently.
+    /// @param target The position to search around.
+    /// @param filter The filter to pass for an element to qualify.
+    /// @param maxRadius The maximum distance from the target to consider.
+    /// @return The closest element if found, or empty.
+    template<typename Filter>
+    std::optional<Element> FindNearest(const Vec2& target, Filter filter, Scalar maxRadius = std::numeric_limits<Scalar>::max()) const
+    {
+        std::optional<Element> nearest = std::nullopt;
+        Distance bestDistanceSq = QuadtreeDetail::GetRadiusSq<Vec2>(maxRadius);
+        
+        std::shared_lock<std::shared_mutex> lock(mRoot.mutex);
+        mRoot.FindNearest(target, filter, bestDistanceSq, nearest);
+        return nearest;
+    }
+    
+    /// Finds the closest element to the target position.
+    /// @param target The position to search around.
+    /// @param maxRadius The maximum distance from the target to consider.
+    /// @return The closest element if found, or empty.
+    std::optional<Element> FindNearest(const Vec2& target, Scalar maxRadius = std::numeric_limits<Scalar>::max()) const
+    {
+        return FindNearest(target, QuadtreeDetail::NoFilter{}, maxRadius);
+    }
+    
+    /// Finds elements within the region that pass a filter.
+    /// @tparam Filter A function that takes in an element and returns true if it qualifies for the search, which must be safe to call concurrently.
+    /// @param min The minimum point describing the search area.
+    /// @param max The maximum point describing the search area.
+    /// @param filter The filter to pass for an element to qualify.
+    /// @return The collection of elements found within the region.
+    template<typename Filter>
+    std::vector<Element> FindAll(const Vec2& min, const Vec2& max, Filter filter) const
+    {
+        std::vector<Element> foundElements;
+        
+        Bounds searchArea(min, max);
+        if (mRoot.bounds.Intersects(searchArea))
+        {
+            std::shared_lock<std::shared_mutex> lock(mRoot.mutex);
+            mRoot.FindAll(searchArea, filter, foundElements);
+        }
+        
+        return foundElements;
+    }
+    
+    /// Finds elements within the search area.
+    /// @param min The minimum point describing the search area.
+    /// @param max The maximum point describing the search area.
+    /// @return The collection of elements found within the region.
+    std::vector<Element> FindAll(const Vec2& min, const Vec2& max) const
+    {
+        return FindAll(min, max, QuadtreeDetail::NoFilter{});
+    }
+    
+    /// Removes every element from the tree, waiting for the searches and writers already inside it to finish.
+    void Clear()
+    {
+        std::unique_lock<std::shared_mutex> lock(mRoot.mutex);
+        mRoot.Clear(mAllocator);
+        mCount.store(0, std::memory_order_relaxed);
+    }
+    
+    /// Copy assignment is deleted since the locks can't be shared between trees.
+    ConcurrentQuadtree& operator=(const ConcurrentQuadtree&) = delete;
+    
+private:
+    using Bounds = QuadtreeDetail::Bounds<Vec2>;
+    using Distance = QuadtreeDetail::Distance<Vec2>;
+    using SharedNode = QuadtreeDetail::Node<T, Vec2>;
+    
+    struct LockedAllocator;
+    
+    /// A node guarded by its own lock, which protects whether it's a leaf, its elements and its children pointer.
+    /// A thread only locks a node while it holds a lock on the node's parent, so a node can't be destroyed while another thread is waiting for it.
+    struct Node
+    {
+        using Children = std::array<Node, 4>;
+        
+        /// Defines the area covered by this node, which never changes.
+        Bounds bounds;
+        
+        /// How many levels down the node is from the root.
+        int depth;
+        
+        /// Held shared by searches that visit this node and exclusively by writers that modify it.
+        mutable std::shared_mutex mutex;
+        
+        /// Indicates if this node is an endpoint and can store elements or if it's a branch with children.
+        bool isLeaf = true;
+        
+        /// Elements stored by this node when it's a leaf.
+        std::vector<Element> elements;
+        
+        /// Block containing the four child quadrants in Z-order: Top-Left, Top-Right, Bottom-Left, Bottom-Right.
+        Children* children = nullptr;
+        
+        /// Construct a node with the given bounds
+        /// @param bounds The area covered by the node.
+        /// @param depth How many levels down the node is from the root.
+        Node(const Bounds& bounds, int depth) : bounds(bounds), depth(depth)
+        {
+        }
+        
+        /// Calculates the height of this node from its deepest branch, expecting the caller to hold its lock.
+        /// @return The height of the node.
+        size_t GetHeight() const
+        {
+            if (isLeaf)
+            {
+                return 1;
+            }
+            
+            size_t height = 0;
+            for (const auto& child : *children)
+            {
+                std::shared_lock<std::shared_mutex> lock(child.mutex);
+                height = std::max(child.GetHeight(), height);
+            }
+            
+            return height + 1;
+        }
+        
+        /// Inserts an element into this node or its descendants without locking them, which is only safe while no other thread can reach them.
+        /// @param element The element to insert.
+        /// @param capacity The maximum number of elements to hold before subdividing.
+        /// @param maxDepth The maximum depth a node can be from the root.
+        /// @param allocator The allocator that provides storage for new children.
+        void InsertUnlocked(Element&& element, size_t capacity, int maxDepth, LockedAllocator& allocator)
+        {
+            if (!isLeaf)
+            {
+                (*children)[bounds.GetQuadrantIndex(element.position)].InsertUnlocked(std::move(element), capacity, maxDepth, allocator);
+                return;
+            }
+            
+            elements.push_back(std::move(element));
+            
+            if (elements.size() > capacity && depth < maxDepth)
+            {
+                Subdivide(capacity, maxDepth, allocator);
+            }
+        }
+        
+        /// Divides this leaf into a branch by passing its elements into its children, expecting the caller to hold its lock exclusively.
+        /// @param capacity The maximum number of elements a node can hold.
+        /// @param maxDepth The maximum depth a node can be from the root.
+        /// @param allocator The allocator that provides storage for the children.
+        void Subdivide(size_t capacity, int maxDepth, LockedAllocator& allocator)
+        {
+            // The four children share one contiguous block to keep siblings close in memory.
+            int childDepth = depth + 1;
+            children = new (allocator.Allocate()) Children{Node(bounds.GetQuadrant(0), childDepth), Node(bounds.GetQuadrant(1), childDepth), Node(bounds.GetQuadrant(2), childDepth), Node(bounds.GetQuadrant(3), childDepth)};
+            isLeaf = false;
+            
+            for (auto& element : elements)
+            {
+                (*children)[bounds.GetQuadrantIndex(element.position)].InsertUnlocked(std::move(element), capacity, maxDepth, allocator);
+            }
+            
+            elements.clear();
+        }
+        
+        /// Merges the children back into this branch if they are leaves whose elements fit within its capacity, expecting the caller to hold its lock exclusively.
+        /// @param capacity The maximum number of elements a node can hold.
+        /// @param allocator The allocator that reclaims the storage of the children.
+        /// @return True if the children were merged.
+        bool TryMerge(size_t capacity, LockedAllocator& allocator)
+        {
+            // Locking the children waits for the threads still inside them, and no other thread can reach them while this branch is locked.
+            std::array<std::unique_lock<std::shared_mutex>, 4> childLocks;
+            size_t elementCount = 0;
+            for (int index = 0; index < 4; ++index)
+            {
+                Node& child = (*children)[index];
+                childLocks[index] = std::unique_lock<std::shared_mutex>(child.mutex);
+                if (!child.isLeaf)
+                {
+                    return false;
+                }
+                
+                elementCount += child.elements.size();
+            }
+            
+            if (elementCount > capacity)
+            {
+                return false;
+            }
+            
+            elements.reserve(elementCount);
+            for (auto& child : *children)
+            {
+                for (auto& element : child.elements)
+                {
+                    elements.push_back(std::move(element));
+                }
+            }
+            
+            for (auto& childLock : childLocks)
+            {
+                childLock.unlock();
+            }
+            
+            DestroyChildren(allocator);
+            return true;
+        }
+        
+        /// Destroys all the descendants of this node and discards its elements, expecting the caller to hold its lock exclusively.
+        /// @param allocator The allocator that reclaims the storage of the children.
+        void Clear(LockedAllocator& allocator)
+        {
+            if (!isLeaf)
+            {
+                for (auto& child : *children)
+                {
+                    std::unique_lock<std::shared_mutex> lock(child.mutex);
+                    child.Clear(allocator);
+                }
+                
+                DestroyChildren(allocator);
+            }
+            
+            elements.clear();
+        }
+        
+        /// Destroys the children of this branch, which must already be empty leaves, and returns their storage, turning it into a leaf.
+        /// @param allocator The allocator that reclaims the storage of the children.
+        void DestroyChildren(LockedAllocator& allocator)
+        {
+            std::destroy_at(children);
+            allocator.Deallocate(children);
+            children = nullptr;
+            isLeaf = true;
+        }
+        
+        /// Recursive helper for finding the nearest element, expecting the caller to hold this node's lock.
+        /// @tparam Filter A function that takes in an element and returns true if it qualifies for the search.
+        /// @param target The search position.
+        /// @param filter The filter to pass for an element to qualify.
+        /// @param bestDistanceSq The squared distance to the closest element found so far.
+        /// @param nearest The closest element found so far.
+        template<typename Filter>
+        void FindNearest(const Vec2& target, Filter& filter, Distance& bestDistanceSq, std::optional<Element>& nearest) const
+        {
+            if (isLeaf)
+            {
+                QuadtreeNoStats stats;
+                SharedNode::FindNearestInLeaf(elements, target, filter, bestDistanceSq, nearest, stats);
+                return;
+            }
+            
+            // Bias the search toward the quadrant that contains the target.
+            for (int index : bounds.GetSearchOrder(target))
+            {
+                const auto& child = (*children)[index];
+                if (child.bounds.GetDistanceSq(target) < bestDistanceSq)
+                {
+                    std::shared_lock<std::shared_mutex> lock(child.mutex);
+                    child.FindNearest(target, filter, bestDistanceSq, nearest);
+                }
+            }
+        }
+        
+        /// Recursive helper for finding all elements within a search area, expecting the caller to hold this node's lock.
+        /// @tparam Filter A function that takes in an element and returns true if it qualifies for the search.
+        /// @param searchArea The area to search within.
+        /// @param filter The filter to pass for an element to qualify.
+        /// @param foundElements The collection of elements found by the search.
+        template<typename Filter>
+        void FindAll(const Bounds& searchArea, Filter& filter, std::vector<Element>& foundElements) const
+        {
+            if (isLeaf)
+            {
+                QuadtreeNoStats stats;
+                SharedNode::FindAllInLeaf(elements, searchArea, filter, foundElements, stats);
+                return;
+            }
+            
+            for (const auto& child : *children)
+            {
+                if (child.bounds.Intersects(searchArea))
+                {
+                    std::shared_lock<std::shared_mutex> lock(child.mutex);
+                    child.FindAll(searchArea, filter, foundElements);
+                }
+            }
+        }
+    };
+    
+    /// Wraps the allocator policy with a lock, since writers in different subtrees can subdivide and merge at the same time.
+    struct LockedAllocator
+    {
+        /// The allocator policy that owns the storage of the children.
+        Allocator<typename Node::Children> allocator;
+        
+        /// Held while the allocator policy is in use.
+        std::mutex mutex;
+        
+        /// Provides uninitialized storage for a block of children.
+        /// @return The storage for the block.
+        void* Allocate()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return allocator.Allocate();
+        }
+        
+        /// Returns the storage of a block of children to the allocator policy.
+        /// @param block The storage previously obtained from Allocate.
+        void Deallocate(void* block)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            allocator.Deallocate(block);
+        }
+    };
+
+    /// Descends to the leaf that covers a position and locks it exclusively.
+    /// Branches are only locked shared and released once their child is locked, so writers in different subtrees don't block each other.
+    /// @param position The position to descend toward, which must be within the tree's bounds.
+    /// @return The leaf along with its exclusive lock.
+    std::pair<Node*, std::unique_lock<std::shared_mutex>> LockLeaf(const Vec2& position)
+    {
+        std::shared_lock<std::shared_mutex> parentLock;
+        Node* node = &mRoot;
+        while (true)
+        {
+            std::shared_lock<std::shared_mutex> lock(node->mutex);
+            if (!node->isLeaf)
+            {
+                Node* child = &(*node->children)[node->bounds.GetQuadrantIndex(position)];
+                parentLock = std::move(lock);
+                node = child;
+                continue;
+            }
+            
+            // The parent stays locked while upgrading, so the leaf can be subdivided in between but not merged away.
+            lock.unlock();
+            std::unique_lock<std::shared_mutex> exclusiveLock(node->mutex);
+            if (node->isLeaf)
+            {
+                return {node, std::move(exclusiveLock)};
+            }
+        }
+    }
+    
+    /// Attempts to merge the branch at the given depth along the path to a position.
+    /// @param position The position that identifies the path.
+    /// @param depth The depth of the branch to merge.
+    /// @return True if the branch was merged into a leaf.
+    bool TryMerge(const Vec2& position, int depth)
+    {
+        std::shared_lock<std::shared_mutex> parentLock;
+        Node* node = &mRoot;
+        while (node->depth < depth)
+        {
+            std::shared_lock<std::shared_mutex> lock(node->mutex);
+            if (node->isLeaf)
+            {
+                return false;
+            }
+            
+            Node* child = &(*node->children)[node->bounds.GetQuadrantIndex(position)];
+            parentLock = std::move(lock);
+            node = child;
+        }
+        
+        std::unique_lock<std::shared_mutex> lock(node->mutex);
+        return !node->isLeaf && node->TryMerge(mNodeCapacity, mAllocator);
+    }
+    
+    /// Provides the storage for every block of children in the tree.
+    LockedAllocator mAllocator;
+    
+    /// Represents the tree's root node.
+    Node mRoot;
+    
+    /// How many elements are stored in the tree, which only changes while a writer holds the lock of the leaf it modifies.
+    std::atomic<size_t> mCount = 0;
+    
+    /// The maximum number of elements a node is allowed to have before attempting to subdivide.
+    size_t mNodeCapacity;
+    
+    /// How many additional levels the tree can have (the root is at depth 0).
+    int mMaxDepth;
+};
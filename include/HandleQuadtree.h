@@ -0,0 +1,450 @@
+/// Copyright (c) 2025 Jose Ilitzky
+
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "Quadtree.h"
+
+/// A compact reference to an element of a HandleQuadtree that stays valid until the element is removed.
+struct QuadtreeHandle
+{
+    /// The slot of the element within the tree's element store.
+    uint32_t index = 0;
+    
+    /// The generation of the slot when the element was inserted, used to detect handles to removed elements.
+    uint32_t generation = 0;
+    
+    /// Returns true if both handles refer to the same element.
+    /// @param other The handle to compare against.
+    /// @return True if the handles are equal.
+    bool operator==(const QuadtreeHandle& other) const
+    {
+        return index == other.index && generation == other.generation;
+    }
+    
+    /// Returns true if the handles refer to different elements.
+    /// @param other The handle to compare against.
+    /// @return True if the handles are different.
+    bool operator!=(const QuadtreeHandle& other) const
+    {
+        return !(*this == other);
+    }
+};
+
+/// A Quadtree that keeps its elements in a dense store and hands out handles to them.
+/// The nodes only hold slot indices, so large data stays out of the searches, and every slot remembers the leaf and index its element is at.
+/// Handles reach their element without searching, so they can be removed or moved without comparing their data.
+/// @tparam T The type of data representing elements in the tree.
+/// @tparam Vec2 The type of 2D vector to use.
+/// @tparam Allocator The policy used to allocate blocks of child nodes.
+template<typename T, typename Vec2, template<typename> class Allocator = QuadtreePoolAllocator>
+class HandleQuadtree
+{
+public:
+    using Scalar = QuadtreeDetail::Scalar<Vec2>;
+    
+    /// A view of an element, whose data lives in the element store and whose position lives in the tree, which is invalidated by any modification of the tree.
+    struct ElementView
+    {
+        /// The data representing the element.
+        const T& data;
+        
+        /// The position linked to the data.
+        const Vec2& position;
+    };
+    
+    /// Construct a HandleQuadtree that covers the given bounds.
+    /// @param min The minimum point describing the area covered by the tree.
+    /// @param max The maximum point describing the area covered by the tree.
+    /// @param nodeCapacity The maximum number of elements that a node within the tree can store before subdividing.
+    /// @param maxDepth The maximum depth the tree can have from its root to the furthest leaf.
+    HandleQuadtree(const Vec2& min, const Vec2& max, size_t nodeCapacity = 8, int maxDepth = 4) : mRoot({min, max}, 0), mNodeCapacity(nodeCapacity), mMaxDepth(maxDepth), mMergePolicy{nodeCapacity}
+    {
+    }
+    
+    /// Copy constructor is deleted to avoid accidental copies.
+    HandleQuadtree(const HandleQuadtree&) = delete;
+    
+    /// Move constructor that transfers ownership of the nodes and the element store.
+    /// @param other The tree to move from.
+    HandleQuadtree(HandleQuadtree&& other) noexcept : mRoot(std::move(other.mRoot)), mNodeCapacity(other.mNodeCapacity), mMaxDepth(other.mMaxDepth), mMergePolicy(other.mMergePolicy), mSlots(std::move(other.mSlots)), mFirstFree(other.mFirstFree), mFreeCount(std::exchange(other.mFreeCount, 0)), mAllocator(std::move(other.mAllocator))
+    {
+        TrackRoot();
+    }
+    
+    /// Destructor that releases every node back to the allocator.
+    ~HandleQuadtree()
+    {
+        mRoot.Clear(mAllocator);
+    }
+    
+    /// Calculates the height of the tree from its deepest branch.
+    /// @return The height of the tree.
+    size_t GetHeight() const
+    {
+        return mRoot.GetHeight();
+    }
+    
+    /// Counts the total number of elements in the tree.
+    /// @return The total number of elements.
+    size_t CountElements() const
+    {
+        return mRoot.CountElements();
+    }
+    
+    /// Inserts a new element with the given data and position.
+    /// @param data The data representing the element.
+    /// @param position The position where the element is.
+    /// @return The handle to the new element, or empty if the position is outside the tree.
+    std::optional<QuadtreeHandle> Insert(T data, const Vec2& position)
+    {
+        if (!mRoot.bounds.Contains(position))
+        {
+            return std::nullopt;
+        }
+        
+        uint32_t index = AcquireSlot();
+        mSlots[index].data.emplace(std::move(data));
+        
+        QuadtreeNoStats stats;
+        mRoot.Insert(index, position, mNodeCapacity, mMaxDepth, mAllocator, stats, SlotTracker{mSlots});
+        return GetHandle(index);
+    }
+    
+    /// Removes the element referred to by a handle, filling its place in the leaf with the leaf's last element.
+    /// @param handle The handle to the element.
+    /// @return True if the element was removed, false if the handle is no longer valid.
+    bool Remove(const QuadtreeHandle& handle)
+    {
+        const Slot* slot = FindSlot(handle);
+        if (!slot)
+        {
+            return false;
+        }
+        
+        // The position only leads back down to the leaf, so the counts and merges of the branches above it stay up to date.
+        QuadtreeNoStats stats;
+        Vec2 position = slot->leaf->elements[slot->offset].position;
+        mRoot.RemoveAt(position, slot->offset, mMergePolicy, mAllocator, stats, SlotTracker{mSlots});
+        ReleaseSlot(handle.index);
+        return true;
+    }
+    
+    /// Moves the element referred to by a handle to a new position, in place when the position still belongs to the same leaf.
+    /// @param handle The handle to the element.
+    /// @param newPosition The position to move the element to.
+    /// @return True if the element was moved, false if the handle is no longer valid or the new position is outside the tree.
+    bool Update(const QuadtreeHandle& handle, const Vec2& newPosition)
+    {
+        const Slot* slot = FindSlot(handle);
+        if (!slot || !mRoot.bounds.Contains(newPosition))
+        {
+            return false;
+        }
+        
+        Node& leaf = *slot->leaf;
+        Vec2& position = leaf.elements[slot->offset].position;
+        if (leaf.Owns(newPosition, mRoot.bounds))
+        {
+            position = newPosition;
+            return true;
+        }
+        
+        QuadtreeNoStats stats;
+        mRoot.UpdateAt(Vec2(position), slot->offset, newPosition, mNodeCapacity, mMaxDepth, mMergePolicy, mAllocator, stats, SlotTracker{mSlots});
+        return true;
+    }
+    
+    /// Looks up the element referred to by a handle.
+    /// @param handle The handle to the element.
+    /// @return The view of the element, or empty if the handle is no longer valid.
+    std::optional<ElementView> Get(const QuadtreeHandle& handle) const
+    {
+        const Slot* slot = FindSlot(handle);
+        if (!slot)
+        {
+            return std::nullopt;
+        }
+        
+        return ElementView{*slot->data, slot->leaf->elements[slot->offset].position};
+    }
+    
+    /// Looks up the data of the element referred to by a handle so it can be modified.
+    /// @param handle The handle to the element.
+    /// @return The data of the element, or null if the handle is no longer valid.
+    T* GetData(const QuadtreeHandle& handle)
+    {
+        return FindSlot(handle) ? &*mSlots[handle.index].data : nullptr;
+    }
+    
+    /// Finds the closest element to the target position that passes a filter.
+    /// @tparam Filter A function that takes in an element and returns true if it qualifies for the search.
+    /// @param target The position to search around.
+    /// @param filter The filter to pass for an element to qualify.
+    /// @param maxRadius The maximum distance from the target to consider.
+    /// @return The handle to the closest element if found, or empty.
+    template<typename Filter>
+    std::optional<QuadtreeHandle> FindNearest(const Vec2& target, Filter filter, Scalar maxRadius = std::numeric_limits<Scalar>::max()) const
+    {
+        QuadtreeNoStats stats;
+        std::optional<typename Node::Element> nearest;
+        QuadtreeDetail::Distance<Vec2> bestDistanceSq = QuadtreeDetail::GetRadiusSq<Vec2>(maxRadius);
+        if constexpr (std::is_same_v<Filter, QuadtreeDetail::NoFilter>)
+        {
+            mRoot.FindNearest(target, filter, bestDistanceSq, nearest, stats);
+        }
+        else
+        {
+            mRoot.FindNearest(target, [&](const auto& indexElement) { return filter(GetView(indexElement)); }, bestDistanceSq, nearest, stats);
+        }
+        
+        if (nearest)
+        {
+            return GetHandle(nearest->data);
+        }
+        
+        return std::nullopt;
+    }
+    
+    /// Finds the closest element to the target position.
+    /// @param target The position to search around.
+    /// @param maxRadius The maximum distance from the target to consider.
+    /// @return The handle to the closest element if found, or empty.
+    std::optional<QuadtreeHandle> FindNearest(const Vec2& target, Scalar maxRadius = std::numeric_limits<Scalar>::max()) const
+    {
+        return FindNearest(target, QuadtreeDetail::NoFilter{}, maxRadius);
+    }
+    
+    /// Visits the elements within the search area.
+    /// @tparam Visitor A function that takes in a handle and the view of its element and returns false to stop the traversal.
+    /// @param min The minimum point describing the search area.
+    /// @param max The maximum point describing the search area.
+    /// @param visitor The function to call with every element found.
+    /// @return False if the visitor stopped the traversal early, true otherwise.
+    template<typename Visitor>
+    bool ForEachInArea(const Vec2& min, const Vec2& max, Visitor visitor) const
+    {
+        QuadtreeDetail::Bounds searchArea(min, max);
+        if (!mRoot.bounds.Intersects(searchArea))
+        {
+            return true;
+        }
+        
+        auto visitIndex = [&](const auto& indexElement)
+        {
+            return visitor(GetHandle(indexElement.data), GetView(indexElement));
+        };
+        return mRoot.ForEachInArea(searchArea, visitIndex);
+    }
+    
+    /// Finds elements within the region that pass a filter.
+    /// @tparam Filter A function that takes in an element and returns true if it qualifies for the search.
+    /// @param min The minimum point describing the search area.
+    /// @param max The maximum point describing the search area.
+    /// @param filter The filter to pass for an element to qualify.
+    /// @return The handles to the elements found within the region.
+    template<typename Filter>
+    std::vector<QuadtreeHandle> FindAll(const Vec2& min, const Vec2& max, Filter filter) const
+    {
+        std::vector<QuadtreeHandle> handles;
+        ForEachInArea(min, max, [&](const QuadtreeHandle& handle, const ElementView& element)
+        {
+            if (filter(element))
+            {
+                handles.push_back(handle);
+            }
+            return true;
+        });
+        
+        return handles;
+    }
+    
+    /// Finds elements within the search area.
+    /// @param min The minimum point describing the search area.
+    /// @param max The maximum point describing the search area.
+    /// @return The handles to the elements found within the region.
+    std::vector<QuadtreeHandle> FindAll(const Vec2& min, const Vec2& max) const
+    {
+        return FindAll(min, max, QuadtreeDetail::NoFilter{});
+    }
+    
+    /// Removes every element from the tree, which invalidates all handles.
+    void Clear()
+    {
+        mRoot.Clear(mAllocator);
+        mAllocator.Reset();
+        for (uint32_t index = 0; index < mSlots.size(); ++index)
+        {
+            if (mSlots[index].data)
+            {
+                ReleaseSlot(index);
+            }
+        }
+    }
+    
+    /// Copy assignment is deleted to avoid accidental copies.
+    HandleQuadtree& operator=(const HandleQuadtree&) = delete;
+    
+    /// Move assignment releases the current nodes and then transfers ownership from the other tree.
+    /// @param other The tree to move from.
+    /// @return A reference to this tree.
+    HandleQuadtree& operator=(HandleQuadtree&& other) noexcept
+    {
+        if (this != &other)
+        {
+            mRoot.Clear(mAllocator);
+            mRoot = std::move(other.mRoot);
+            mNodeCapacity = other.mNodeCapacity;
+            mMaxDepth = other.mMaxDepth;
+            mMergePolicy = other.mMergePolicy;
+            mSlots = std::move(other.mSlots);
+            mFirstFree = other.mFirstFree;
+            mFreeCount = std::exchange(other.mFreeCount, 0);
+            mAllocator = std::move(other.mAllocator);
+            TrackRoot();
+        }
+        return *this;
+    }
+
+private:
+    using Node = QuadtreeDetail::Node<uint32_t, Vec2>;
+    
+    /// An entry of the element store.
+    struct Slot
+    {
+        /// The data of the element stored in the slot, or empty if the slot is free.
+        std::optional<T> data;
+        
+        /// The leaf that holds the element's position and slot index.
+        Node* leaf = nullptr;
+        
+        /// The index of the element within the leaf.
+        uint32_t offset = 0;
+        
+        /// Incremented every time the slot is freed so old handles stop matching.
+        uint32_t generation = 1;
+        
+        /// The next free slot when this one is free.
+        uint32_t nextFree = 0;
+    };
+    
+    /// Records the leaf and index the nodes place every element at in the element's slot.
+    struct SlotTracker
+    {
+        /// The element store to update.
+        std::vector<Slot>& slots;
+        
+        /// Updates the slot of the element at an index of a leaf.
+        /// @param leaf The leaf the element was placed in.
+        /// @param offset The index of the element within the leaf.
+        void operator()(Node& leaf, size_t offset) const
+        {
+            Slot& slot = slots[leaf.elements[offset].data];
+            slot.leaf = &leaf;
+            slot.offset = static_cast<uint32_t>(offset);
+        }
+    };
+    
+    /// Finds the slot of the element referred to by a handle.
+    /// @param handle The handle to the element.
+    /// @return The slot, or null if the handle is no longer valid.
+    const Slot* FindSlot(const QuadtreeHandle& handle) const
+    {
+        if (handle.index >= mSlots.size())
+        {
+            return nullptr;
+        }
+        
+        const Slot& slot = mSlots[handle.index];
+        if (slot.generation != handle.generation || !slot.data)
+        {
+            return nullptr;
+        }
+        
+        return &slot;
+    }
+    
+    /// Takes a free slot from the store or adds a new one.
+    /// @return The index of the slot.
+    uint32_t AcquireSlot()
+    {
+        if (mFreeCount > 0)
+        {
+            --mFreeCount;
+            return std::exchange(mFirstFree, mSlots[mFirstFree].nextFree);
+        }
+        
+        mSlots.emplace_back();
+        return static_cast<uint32_t>(mSlots.size() - 1);
+    }
+    
+    /// Returns a slot to the store and invalidates the handles that refer to it.
+    /// @param index The index of the slot.
+    void ReleaseSlot(uint32_t index)
+    {
+        Slot& slot = mSlots[index];
+        slot.data.reset();
+        slot.leaf = nullptr;
+        ++slot.generation;
+        slot.nextFree = mFirstFree;
+        mFirstFree = index;
+        ++mFreeCount;
+    }
+    
+    /// Points the slots of the elements held by the root back at it after the root was moved, since the children keep their addresses.
+    void TrackRoot()
+    {
+        if (mRoot.isLeaf)
+        {
+            for (size_t offset = 0; offset < mRoot.elements.size(); ++offset)
+            {
+                SlotTracker{mSlots}(mRoot, offset);
+            }
+        }
+    }
+    
+    /// Creates the handle to the element currently stored in a slot.
+    /// @param index The index of the slot.
+    /// @return The handle to the element.
+    QuadtreeHandle GetHandle(uint32_t index) const
+    {
+        return {index, mSlots[index].generation};
+    }
+    
+    /// Creates the view of the element held by a leaf.
+    /// @param indexElement The leaf's entry for the element.
+    /// @return The view of the element.
+    ElementView GetView(const typename Node::Element& indexElement) const
+    {
+        return {*mSlots[indexElement.data].data, indexElement.position};
+    }
+    
+    /// Represents the tree's root node.
+    Node mRoot;
+    
+    /// The maximum number of elements a node is allowed to have before attempting to subdivide.
+    size_t mNodeCapacity;
+    
+    /// How many additional levels the tree can have (the root is at depth 0).
+    int mMaxDepth;
+    
+    /// Controls when branches are merged back after removals.
+    QuadtreeDetail::MergePolicy mMergePolicy;
+    
+    /// The store that owns the elements.
+    std::vector<Slot> mSlots;
+    
+    /// The most recently freed slot.
+    uint32_t mFirstFree = 0;
+    
+    /// How many slots of the store are free.
+    size_t mFreeCount = 0;
+    
+    /// Provides the storage for every block of child nodes in the tree.
+    Allocator<typename Node::Children> mAllocator;
+};
@@ -0,0 +1,425 @@
+/// Copyright (c) 2025 Jose Ilitzky
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "Quadtree.h"
+
+/// Represents an item with an extent stored in a LooseQuadtree.
+/// @tparam T The type of data representing the element.
+/// @tparam Vec2 The type of 2D vector to use.
+template<typename T, typename Vec2>
+struct LooseQuadtreeElement
+{
+    /// The data representing the element.
+    T data;
+    
+    /// The box covered by the element.
+    QuadtreeDetail::Bounds<Vec2> bounds;
+};
+
+/// A Quadtree for elements that cover an area, such as collision shapes or sprites, instead of a single point.
+/// Every node accepts elements that fit within its bounds enlarged by a looseness factor, so an element is kept in the deepest node whose loose bounds contain it,
+/// even when it straddles the split lines of that node's parent, and branches can hold the elements that are too large for any of their children.
+/// @tparam T The type of data representing elements in the tree.
+/// @tparam Vec2 The type of 2D vector to use.
+template<typename T, typename Vec2>
+class LooseQuadtree
+{
+public:
+    using Element = LooseQuadtreeElement<T, Vec2>;
+    using Bounds = QuadtreeDetail::Bounds<Vec2>;
+    using Scalar = QuadtreeDetail::Scalar<Vec2>;
+    
+    /// Construct a LooseQuadtree that covers the given bounds.
+    /// @param min The minimum point describing the area covered by the tree.
+    /// @param max The maximum point describing the area covered by the tree.
+    /// @param nodeCapacity The maximum number of elements that a leaf within the tree can store before subdividing.
+    /// @param maxDepth The maximum depth the tree can have from its root to the furthest leaf.
+    /// @param looseness How many times wider and taller the loose bounds of a node are than its bounds, which is clamped to at least 1 where the tree behaves like a strict quadtree.
+    LooseQuadtree(const Vec2& min, const Vec2& max, size_t nodeCapacity = 8, int maxDepth = 4, float looseness = 2.0f) : mLooseness(std::max(looseness, 1.0f)), mRoot(Bounds(min, max), Loosen(Bounds(min, max), std::max(looseness, 1.0f)), 0), mNodeCapacity(nodeCapacity), mMaxDepth(maxDepth)
+    {
+    }
+    
+    /// Copy constructor is deleted to avoid accidental copies.
+    LooseQuadtree(const LooseQuadtree& other) = delete;
+    
+    /// Move constructor that takes over the nodes of the other tree.
+    LooseQuadtree(LooseQuadtree&& other) = default;
+    
+    /// Calculates the height of the tree from its deepest branch.
+    /// @return The height of the tree.
+    size_t GetHeight() const
+    {
+        return mRoot.GetHeight();
+    }
+    
+    /// Counts the total number of elements in the tree.
+    /// @return The total number of elements.
+    size_t CountElements() const
+    {
+        return mRoot.CountElements();
+    }
+    
+    /// Returns how many times wider and taller the loose bounds of a node are than its bounds.
+    /// @return The looseness factor.
+    float GetLooseness() const
+    {
+        return mLooseness;
+    }
+    
+    /// Inserts a new element with the given data and box.
+    /// @param data The data representing the element.
+    /// @param bounds The box covered by the element.
+    /// @return True if the element was inserted, false if the box doesn't fit within the loose bounds of the root.
+    bool Insert(T data, const Bounds& bounds)
+    {
+        if (!mRoot.looseBounds.Contains(bounds))
+        {
+            return false;
+        }
+        
+        mRoot.Insert({std::move(data), bounds}, mNodeCapacity, mMaxDepth, mLooseness);
+        return true;
+    }
+    
+    /// Removes an element matching the given data and box.
+    /// @param data The data representing the element.
+    /// @param bounds The box covered by the element.
+    /// @return True if the element was successfully removed.
+    bool Remove(const T& data, const Bounds& bounds)
+    {
+        if (!mRoot.looseBounds.Contains(bounds))
+        {
+            return false;
+        }
+        
+        return mRoot.Remove(data, bounds, mNodeCapacity);
+    }
+    
+    /// Finds elements whose boxes overlap the search area and pass a filter.
+    /// @tparam Filter A function that takes in an element and returns true if it qualifies for the search.
+    /// @param searchArea The area to search within.
+    /// @param filter The filter to pass for an element to qualify.
+    /// @return The collection of elements whose boxes touch or overlap the search area.
+    template<typename Filter>
+    std::vector<Element> FindOverlapping(const Bounds& searchArea, Filter filter) const
+    {
+        std::vector<Element> foundElements;
+        
+        if (mRoot.looseBounds.Intersects(searchArea))
+        {
+            mRoot.FindOverlapping(searchArea, filter, foundElements);
+        }
+        
+        return foundElements;
+    }
+    
+    /// Finds elements whose boxes overlap the search area.
+    /// @param searchArea The area to search within.
+    /// @return The collection of elements whose boxes touch or overlap the search area.
+    std::vector<Element> FindOverlapping(const Bounds& searchArea) const
+    {
+        return FindOverlapping(searchArea, QuadtreeDetail::NoFilter{});
+    }
+    
+    /// Removes every element from the tree.
+    void Clear()
+    {
+        mRoot.Clear();
+    }
+    
+    /// Copy assignment is deleted to avoid accidental copies.
+    LooseQuadtree& operator=(const LooseQuadtree& other) = delete;
+    
+    /// Move assignment that takes over the nodes of the other tree.
+    LooseQuadtree& operator=(LooseQuadtree&& other) = default;
+    
+private:
+    /// Enlarges a box around its center.
+    /// @param bounds The box to enlarge.
+    /// @param looseness How many times wider and taller the enlarged box is.
+    /// @return The enlarged box.
+    static Bounds Loosen(const Bounds& bounds, float looseness)
+    {
+        auto paddingX = static_cast<Scalar>(bounds.GetWidth() * (looseness - 1.0f) / 2);
+        auto paddingY = static_cast<Scalar>(bounds.GetHeight() * (looseness - 1.0f) / 2);
+        return Bounds({bounds.min.x - paddingX, bounds.min.y - paddingY}, {bounds.max.x + paddingX, bounds.max.y + paddingY});
+    }
+    
+    /// A node that stores the elements which fit within its loose bounds but not within the loose bounds of the child under their center.
+    struct Node
+    {
+        using Children = std::array<Node, 4>;
+        
+        /// Defines the area covered by this node, which decides the child that an element descends to.
+        Bounds bounds;
+        
+        /// The bounds enlarged by the looseness factor, which every element stored in this node or its descendants fits within.
+        Bounds looseBounds;
+        
+        /// How many levels down the node is from the root.
+        int depth;
+        
+        /// Elements stored by this node, which a branch keeps when none of its children can hold them.
+        std::vector<Element> elements;
+        
+        /// The four child quadrants in Z-order: Top-Left, Top-Right, Bottom-Left, Bottom-Right.
+        std::unique_ptr<Children> children;
+        
+        /// Construct a node with the given bounds.
+        /// @param bounds The area covered by the node.
+        /// @param looseBounds The enlarged area that elements stored by the node must fit within.
+        /// @param depth How many levels down the node is from the root.
+        Node(const Bounds& bounds, const Bounds& looseBounds, int depth) : bounds(bounds), looseBounds(looseBounds), depth(depth)
+        {
+        }
+        
+        /// Indicates if this node is an endpoint with no children.
+        bool IsLeaf() const
+        {
+            return children == nullptr;
+        }
+        
+        /// Calculates the height of this node from its deepest branch.
+        /// @return The height of the node.
+        size_t GetHeight() const
+        {
+            if (IsLeaf())
+            {
+                return 1;
+            }
+            
+            size_t height = 0;
+            for (const auto& child : *children)
+            {
+                height = std::max(child.GetHeight(), height);
+            }
+            
+            return height + 1;
+        }
+        
+        /// Counts the total number of elements in this node and all its children.
+        /// @return The total number of elements.
+        size_t CountElements() const
+        {
+            size_t size = elements.size();
+            if (!IsLeaf())
+            {
+                for (const auto& child : *children)
+                {
+                    size += child.CountElements();
+                }
+            }
+            
+            return size;
+        }
+        
+        /// Finds the child that an element with the given box descends to.
+        /// @param box The box of the element.
+        /// @return The child under the center of the box if its loose bounds contain the box, or null if the element belongs to this node.
+        Node* FindChild(const Bounds& box)
+        {
+            if (IsLeaf())
+            {
+                return nullptr;
+            }
+            
+            Node& child = (*children)[GetChildIndex(box.GetCenter())];
+            return child.looseBounds.Contains(box) ? &child : nullptr;
+        }
+        
+        /// Inserts an element into the deepest node along its path whose loose bounds contain it.
+        /// @param element The element to insert.
+        /// @param capacity The maximum number of elements a leaf can hold before subdividing.
+        /// @param maxDepth The maximum depth a node can be from the root.
+        /// @param looseness How many times wider and taller the loose bounds of a node are than its bounds.
+        void Insert(Element&& element, size_t capacity, int maxDepth, float looseness)
+        {
+            if (Node* child = FindChild(element.bounds))
+            {
+                child->Insert(std::move(element), capacity, maxDepth, looseness);
+                return;
+            }
+            
+            elements.push_back(std::move(element));
+            
+            if (IsLeaf() && elements.size() > capacity && depth < maxDepth)
+            {
+                Subdivide(capacity, maxDepth, looseness);
+            }
+        }
+        
+        /// Divides this leaf into a branch and passes down the elements that fit within its children.
+        /// @param capacity The maximum number of elements a leaf can hold before subdividing.
+        /// @param maxDepth The maximum depth a node can be from the root.
+        /// @param looseness How many times wider and taller the loose bounds of a node are than its bounds.
+        void Subdivide(size_t capacity, int maxDepth, float looseness)
+        {
+            int childDepth = depth + 1;
+            children.reset(new Children{MakeChild(0, childDepth, looseness), MakeChild(1, childDepth, looseness), MakeChild(2, childDepth, looseness), MakeChild(3, childDepth, looseness)});
+            
+            // Elements too large for the child under their center stay in this branch.
+            auto remaining = elements.begin();
+            for (auto& element : elements)
+            {
+                if (Node* child = FindChild(element.bounds))
+                {
+                    child->Insert(std::move(element), capacity, maxDepth, looseness);
+                }
+                else
+                {
+                    *remaining++ = std::move(element);
+                }
+            }
+            
+            elements.erase(remaining, elements.end());
+        }
+        
+        /// Creates one of the four children of this node.
+        /// @param index The index of the quadrant in Z-order.
+        /// @param childDepth The depth of the child.
+        /// @param looseness How many times wider and taller the loose bounds of the child are than its bounds.
+        /// @return The child node.
+        Node MakeChild(int index, int childDepth, float looseness) const
+        {
+            Bounds quadrant = bounds.GetQuadrant(index);
+            return Node(quadrant, Loosen(quadrant, looseness), childDepth);
+        }
+        
+        /// Removes an element from the node along its path that stores it, merging the branches left with few enough elements.
+        /// @param data The data representing the element.
+        /// @param box The box of the element.
+        /// @param capacity The maximum number of elements a leaf can hold.
+        /// @return True if the element was found and removed.
+        bool Remove(const T& data, const Bounds& box, size_t capacity)
+        {
+            if (Node* child = FindChild(box))
+            {
+                if (!child->Remove(data, box, capacity))
+                {
+                    return false;
+                }
+                
+                TryMerge(capacity);
+                return true;
+            }
+            
+            auto it = std::find_if(elements.begin(), elements.end(), [&](const Element& element)
+            {
+                return element.data == data && element.bounds.min == box.min && element.bounds.max == box.max;
+            });
+            
+            if (it == elements.end())
+            {
+                return false;
+            }
+            
+            elements.erase(it);
+            TryMerge(capacity);
+            return true;
+        }
+        
+        /// Merges the children back into this branch if they are leaves and all the elements fit within its capacity.
+        /// @param capacity The maximum number of elements a leaf can hold.
+        void TryMerge(size_t capacity)
+        {
+            if (IsLeaf())
+            {
+                return;
+            }
+            
+            size_t elementCount = elements.size();
+            for (const auto& child : *children)
+            {
+                if (!child.IsLeaf())
+                {
+                    return;
+                }
+                
+                elementCount += child.elements.size();
+            }
+            
+            if (elementCount > capacity)
+            {
+                return;
+            }
+            
+            // Every element of a child fits within the loose bounds of this node, so the merged leaf can keep them all.
+            elements.reserve(elementCount);
+            for (auto& child : *children)
+            {
+                for (auto& element : child.elements)
+                {
+                    elements.push_back(std::move(element));
+                }
+            }
+            
+            children.reset();
+        }
+        
+        /// Recursive helper for finding the elements whose boxes overlap a search area.
+        /// @tparam Filter A function that takes in an element and returns true if it qualifies for the search.
+        /// @param searchArea The area to search within.
+        /// @param filter The filter to pass for an element to qualify.
+        /// @param foundElements The collection of elements found by the search.
+        template<typename Filter>
+        void FindOverlapping(const Bounds& searchArea, Filter& filter, std::vector<Element>& foundElements) const
+        {
+            // Every element of a node fits within its loose bounds, so they all overlap an area that contains those bounds.
+            bool containsNode = searchArea.Contains(looseBounds);
+            for (const auto& element : elements)
+            {
+                if ((containsNode || element.bounds.Intersects(searchArea)) && filter(element))
+                {
+                    foundElements.push_back(element);
+                }
+            }
+            
+            if (IsLeaf())
+            {
+                return;
+            }
+            
+            for (const auto& child : *children)
+            {
+                if (child.looseBounds.Intersects(searchArea))
+                {
+                    child.FindOverlapping(searchArea, filter, foundElements);
+                }
+            }
+        }
+        
+        /// Destroys all the descendants of this node and discards its elements.
+        void Clear()
+        {
+            children.reset();
+            elements.clear();
+        }
+        
+        /// Determines the index to the children array based on where the position belongs to.
+        /// @param position The position to check.
+        /// @return The index to the corresponding child.
+        int GetChildIndex(const Vec2& position) const
+        {
+            Vec2 center = bounds.GetCenter();
+            return (position.x >= center.x) + ((position.y < center.y) * 2);
+        }
+    };
+
+    /// How many times wider and taller the loose bounds of a node are than its bounds.
+    float mLooseness;
+    
+    /// Represents the tree's root node.
+    Node mRoot;
+    
+    /// The maximum number of elements a leaf is allowed to have before attempting to subdivide.
+    size_t mNodeCapacity;
+    
+    /// How many additional levels the tree can have (the root is at depth 0).
+    int mMaxDepth;
+};
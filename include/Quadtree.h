@@ -2,11 +2,37 @@
 
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
 #include <optional>
+#include <thread>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
+#if !defined(QUADTREE_DISABLE_SIMD) && defined(__AVX2__)
+#define QUADTREE_SIMD_AVX2
+#include <immintrin.h>
+#elif !defined(QUADTREE_DISABLE_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define QUADTREE_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 /// Represents an item stored in the tree.
 /// @tparam T The type of data representing the element.
 /// @tparam Vec2 The type of 2D vector to use.
@@ -20,6 +46,428 @@ struct QuadtreeElement
     Vec2 position;
 };
 
+/// Allocates the blocks of child nodes for a tree by carving them out of large chunks and recycling freed blocks through a free list.
+/// @tparam Block The type of block to allocate, which holds the four children of a node.
+template<typename Block>
+class QuadtreePoolAllocator
+{
+public:
+    /// Constructs an empty pool that doesn't reserve any memory until the first allocation.
+    QuadtreePoolAllocator() = default;
+    
+    /// Copy constructor is deleted since blocks can only be returned to the pool that allocated them.
+    QuadtreePoolAllocator(const QuadtreePoolAllocator&) = delete;
+    
+    /// Move constructor that takes over the chunks of the other pool, which keep their addresses when transferred.
+    /// @param other The pool to move from, which is left empty.
+    QuadtreePoolAllocator(QuadtreePoolAllocator&& other) noexcept : mChunks(std::move(other.mChunks)), mChunkIndex(std::exchange(other.mChunkIndex, 0)), mSlotIndex(std::exchange(other.mSlotIndex, 0)), mFreeList(std::exchange(other.mFreeList, nullptr))
+    {
+        other.mChunks.clear();
+    }
+    
+    /// Provides uninitialized storage for a block, reusing a freed one when available.
+    /// @return The storage for the block.
+    void* Allocate()
+    {
+        if (mFreeList)
+        {
+            Slot* slot = mFreeList;
+            mFreeList = slot->next;
+            return slot;
+        }
+        
+        if (mChunkIndex == mChunks.size())
+        {
+            mChunks.push_back(std::make_unique<Slot[]>(SlotsPerChunk));
+        }
+        
+        Slot* slot = &mChunks[mChunkIndex][mSlotIndex];
+        if (++mSlotIndex == SlotsPerChunk)
+        {
+            ++mChunkIndex;
+            mSlotIndex = 0;
+        }
+        
+        return slot;
+    }
+    
+    /// Returns the storage of a block to the pool so it can be reused.
+    /// @param block The storage previously obtained from Allocate.
+    void Deallocate(void* block)
+    {
+        Slot* slot = static_cast<Slot*>(block);
+        slot->next = mFreeList;
+        mFreeList = slot;
+    }
+    
+    /// Marks every block in the pool as available again while keeping its chunks for reuse.
+    void Reset()
+    {
+        mFreeList = nullptr;
+        mChunkIndex = 0;
+        mSlotIndex = 0;
+    }
+    
+    /// Copy assignment is deleted since blocks can only be returned to the pool that allocated them.
+    QuadtreePoolAllocator& operator=(const QuadtreePoolAllocator&) = delete;
+    
+    /// Move assignment that takes over the chunks of the other pool, which keep their addresses when transferred.
+    /// @param other The pool to move from, which is left empty.
+    /// @return A reference to this pool.
+    QuadtreePoolAllocator& operator=(QuadtreePoolAllocator&& other) noexcept
+    {
+        if (this != &other)
+        {
+            mChunks = std::move(other.mChunks);
+            mChunkIndex = std::exchange(other.mChunkIndex, 0);
+            mSlotIndex = std::exchange(other.mSlotIndex, 0);
+            mFreeList = std::exchange(other.mFreeList, nullptr);
+            other.mChunks.clear();
+        }
+        return *this;
+    }
+    
+private:
+    /// Storage for a single block that doubles as a free list link while the block is unused.
+    union Slot
+    {
+        Slot* next;
+        alignas(Block) unsigned char storage[sizeof(Block)];
+    };
+    
+    /// How many blocks are reserved at once when the pool runs out.
+    static constexpr size_t SlotsPerChunk = 64;
+    
+    /// The chunks of memory owned by the pool.
+    std::vector<std::unique_ptr<Slot[]>> mChunks;
+    
+    /// The chunk that new blocks are being carved from.
+    size_t mChunkIndex = 0;
+    
+    /// The next unused block within the current chunk.
+    size_t mSlotIndex = 0;
+    
+    /// The most recently freed block.
+    Slot* mFreeList = nullptr;
+};
+
+/// Allocates every block of child nodes individually from the heap.
+/// @tparam Block The type of block to allocate, which holds the four children of a node.
+template<typename Block>
+class QuadtreeHeapAllocator
+{
+public:
+    /// Provides uninitialized storage for a block.
+    /// @return The storage for the block.
+    void* Allocate()
+    {
+        return std::allocator<Block>().allocate(1);
+    }
+    
+    /// Frees the storage of a block.
+    /// @param block The storage previously obtained from Allocate.
+    void Deallocate(void* block)
+    {
+        std::allocator<Block>().deallocate(static_cast<Block*>(block), 1);
+    }
+    
+    /// Does nothing since every block is freed when it's deallocated.
+    void Reset()
+    {
+    }
+};
+
+/// Counts the work done by the searches and modifications of a tree.
+struct QuadtreeCounters
+{
+    /// How many nodes the searches entered.
+    uint64_t nodesVisited = 0;
+    
+    /// How many leaves the searches scanned the elements of.
+    uint64_t leavesScanned = 0;
+    
+    /// How many elements the searches tested against their target or search area.
+    uint64_t elementsTested = 0;
+    
+    /// How many times the searches called a filter.
+    uint64_t filterCalls = 0;
+    
+    /// How many child subtrees the searches skipped because they couldn't hold a result.
+    uint64_t subtreesPruned = 0;
+    
+    /// How many leaves were turned into branches because they went over capacity.
+    uint64_t subdivisions = 0;
+    
+    /// How many branches were turned back into leaves after losing elements.
+    uint64_t merges = 0;
+    
+    /// Adds the counts of another set of counters to these.
+    /// @param other The counters to add.
+    /// @return A reference to these counters.
+    QuadtreeCounters& operator+=(const QuadtreeCounters& other)
+    {
+        nodesVisited += other.nodesVisited;
+        leavesScanned += other.leavesScanned;
+        elementsTested += other.elementsTested;
+        filterCalls += other.filterCalls;
+        subtreesPruned += other.subtreesPruned;
+        subdivisions += other.subdivisions;
+        merges += other.merges;
+        return *this;
+    }
+};
+
+/// Describes the shape of a tree and the memory it uses, gathered by Quadtree::GetStats.
+struct QuadtreeStructureStats
+{
+    /// How many nodes the tree has, including the root.
+    size_t nodeCount = 0;
+    
+    /// How many of the nodes are leaves.
+    size_t leafCount = 0;
+    
+    /// How many of the leaves hold no elements.
+    size_t emptyLeafCount = 0;
+    
+    /// The most elements held by a single leaf, which can exceed the node capacity for leaves at the maximum depth.
+    size_t maxLeafElements = 0;
+    
+    /// How many leaves there are at each depth, indexed by depth.
+    std::vector<size_t> leavesPerDepth;
+    
+    /// How many elements the leaves at each depth hold, indexed by depth.
+    std::vector<size_t> elementsPerDepth;
+    
+    /// The bytes used by the root and every block of child nodes.
+    size_t nodeBytes = 0;
+    
+    /// The bytes used by the elements stored in the leaves.
+    size_t elementBytes = 0;
+    
+    /// The bytes reserved by the element vectors of the leaves beyond the elements they hold.
+    size_t slackBytes = 0;
+    
+    /// Gets the bytes used by the tree's nodes and element storage, which excludes spare slots reserved by the allocator.
+    /// @return The total number of bytes.
+    size_t GetTotalBytes() const
+    {
+        return nodeBytes + elementBytes + slackBytes;
+    }
+};
+
+/// Stats policy that counts nothing, so every instrumentation point compiles away.
+struct QuadtreeNoStats
+{
+    /// Whether the policy records anything.
+    static constexpr bool Enabled = false;
+    
+    /// Instrumentation points called by the nodes, which do nothing.
+    void OnNodeVisited() {}
+    void OnLeafScanned() {}
+    void OnElementsTested(size_t) {}
+    void OnFilterCalled() {}
+    void OnSubtreePruned() {}
+    void OnSubdivision() {}
+    void OnMerge() {}
+    
+    /// Returns empty counters since nothing is recorded.
+    /// @return The counters.
+    QuadtreeCounters GetCounters() const
+    {
+        return {};
+    }
+    
+    /// Does nothing since nothing is recorded.
+    /// @return A reference to this policy.
+    QuadtreeNoStats& operator+=(const QuadtreeNoStats&)
+    {
+        return *this;
+    }
+};
+
+/// Stats policy that counts the work done by a tree, at the cost of an increment for every event.
+struct QuadtreeStats
+{
+    /// Whether the policy records anything.
+    static constexpr bool Enabled = true;
+    
+    /// Instrumentation points called by the nodes, which each bump their counter.
+    void OnNodeVisited() { ++mCounters.nodesVisited; }
+    void OnLeafScanned() { ++mCounters.leavesScanned; }
+    void OnElementsTested(size_t count) { mCounters.elementsTested += count; }
+    void OnFilterCalled() { ++mCounters.filterCalls; }
+    void OnSubtreePruned() { ++mCounters.subtreesPruned; }
+    void OnSubdivision() { ++mCounters.subdivisions; }
+    void OnMerge() { ++mCounters.merges; }
+    
+    /// Returns the counts recorded so far.
+    /// @return The counters.
+    QuadtreeCounters GetCounters() const
+    {
+        return mCounters;
+    }
+    
+    /// Adds the counts recorded by another policy to this one.
+    /// @param other The policy to add.
+    /// @return A reference to this policy.
+    QuadtreeStats& operator+=(const QuadtreeStats& other)
+    {
+        mCounters += other.mCounters;
+        return *this;
+    }
+    
+private:
+    /// The counts recorded so far.
+    QuadtreeCounters mCounters;
+};
+
+/// A fixed set of worker threads used to split batches of queries across cores.
+class QuadtreeThreadPool
+{
+public:
+    /// Construct a pool that runs work on the given number of threads, including the thread that submits it.
+    /// @param threadCount The total number of threads to use, which defaults to the number of hardware threads.
+    explicit QuadtreeThreadPool(size_t threadCount = std::thread::hardware_concurrency())
+    {
+        for (size_t i = 1; i < threadCount; ++i)
+        {
+            mWorkers.emplace_back([this]() { WorkerLoop(); });
+        }
+    }
+    
+    /// Copy constructor is deleted since the workers are bound to this pool.
+    QuadtreeThreadPool(const QuadtreeThreadPool&) = delete;
+    
+    /// Destructor that stops and joins every worker.
+    ~QuadtreeThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStopping = true;
+        }
+        mWorkAvailable.notify_all();
+        
+        for (auto& worker : mWorkers)
+        {
+            worker.join();
+        }
+    }
+    
+    /// Counts the threads that take part in running work, including the thread that submits it.
+    /// @return The number of threads.
+    size_t GetThreadCount() const
+    {
+        return mWorkers.size() + 1;
+    }
+    
+    /// Calls a task over consecutive chunks of a range of indices on all threads and waits for every chunk to finish.
+    /// @tparam Task A function that takes in the beginning and end of a chunk of indices.
+    /// @param count The number of indices to process.
+    /// @param chunkSize How many indices each call to the task processes at most.
+    /// @param task The function to call for every chunk.
+    template<typename Task>
+    void ParallelFor(size_t count, size_t chunkSize, Task task)
+    {
+        if (mWorkers.empty() || count <= chunkSize)
+        {
+            for (size_t begin = 0; begin < count; begin += chunkSize)
+            {
+                task(begin, std::min(begin + chunkSize, count));
+            }
+            return;
+        }
+        
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mTask = [&task](size_t begin, size_t end) { task(begin, end); };
+            mCount = count;
+            mChunkSize = chunkSize;
+            mNextIndex = 0;
+            mBusyWorkers = mWorkers.size();
+            ++mGeneration;
+        }
+        mWorkAvailable.notify_all();
+        
+        RunChunks();
+        
+        std::unique_lock<std::mutex> lock(mMutex);
+        mWorkFinished.wait(lock, [this]() { return mBusyWorkers == 0; });
+        mTask = nullptr;
+    }
+    
+    /// Copy assignment is deleted since the workers are bound to this pool.
+    QuadtreeThreadPool& operator=(const QuadtreeThreadPool&) = delete;
+    
+private:
+    /// Waits for work to be submitted and helps run it until the pool is destroyed.
+    void WorkerLoop()
+    {
+        size_t generation = 0;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                mWorkAvailable.wait(lock, [&]() { return mStopping || mGeneration != generation; });
+                if (mStopping)
+                {
+                    return;
+                }
+                generation = mGeneration;
+            }
+            
+            RunChunks();
+            
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                --mBusyWorkers;
+            }
+            mWorkFinished.notify_one();
+        }
+    }
+    
+    /// Claims and runs chunks of the current work until none are left.
+    void RunChunks()
+    {
+        for (size_t begin = mNextIndex.fetch_add(mChunkSize); begin < mCount; begin = mNextIndex.fetch_add(mChunkSize))
+        {
+            mTask(begin, std::min(begin + mChunkSize, mCount));
+        }
+    }
+    
+    /// The threads that help the submitting thread run work.
+    std::vector<std::thread> mWorkers;
+    
+    /// Guards the description of the current work.
+    std::mutex mMutex;
+    
+    /// Signals the workers when new work is submitted or the pool is stopping.
+    std::condition_variable mWorkAvailable;
+    
+    /// Signals the submitting thread when a worker runs out of chunks.
+    std::condition_variable mWorkFinished;
+    
+    /// The task of the current work.
+    std::function<void(size_t, size_t)> mTask;
+    
+    /// The number of indices in the current work.
+    size_t mCount = 0;
+    
+    /// The number of indices claimed at a time.
+    size_t mChunkSize = 1;
+    
+    /// The first index that hasn't been claimed yet.
+    std::atomic<size_t> mNextIndex{0};
+    
+    /// How many workers are still running chunks of the current work.
+    size_t mBusyWorkers = 0;
+    
+    /// Incremented every time work is submitted so workers can tell new work apart.
+    size_t mGeneration = 0;
+    
+    /// Indicates that the workers should exit.
+    bool mStopping = false;
+};
+
 namespace QuadtreeDetail
 {
     /// Used to consider all possible elements during searches.
@@ -34,11 +482,63 @@ namespace QuadtreeDetail
         }
     };
 
+    /// Used when nothing needs to know which leaf and index the elements are placed at.
+    struct NoTracker
+    {
+        /// Does nothing with the placement of an element.
+        /// @tparam N The type of node.
+        template<typename N>
+        constexpr void operator()(const N&, size_t) const
+        {
+        }
+    };
+    
+    /// The type of the coordinates of a 2D vector.
+    /// @tparam Vec2 The type of 2D vector to use.
+    template<typename Vec2>
+    using Scalar = std::remove_cv_t<std::remove_reference_t<decltype(std::declval<Vec2&>().x)>>;
+    
+    /// The type squared distances are measured in, which widens integer coordinates to 64 bits so their squares can't overflow.
+    /// @tparam Vec2 The type of 2D vector to use.
+    template<typename Vec2>
+    using Distance = std::conditional_t<std::is_floating_point_v<Scalar<Vec2>>, Scalar<Vec2>, int64_t>;
+    
+    /// The floating-point type used for calculations that can't stay exact in integer coordinates.
+    /// @tparam Vec2 The type of 2D vector to use.
+    template<typename Vec2>
+    using Real = std::conditional_t<std::is_floating_point_v<Scalar<Vec2>>, Scalar<Vec2>, double>;
+    
+    /// Squares a search radius, saturating instead of overflowing for integer coordinates.
+    /// @tparam Vec2 The type of 2D vector to use.
+    /// @param radius The radius to square.
+    /// @return The squared radius.
+    template<typename Vec2>
+    Distance<Vec2> GetRadiusSq(Scalar<Vec2> radius)
+    {
+        if constexpr (std::is_floating_point_v<Scalar<Vec2>>)
+        {
+            return radius * radius;
+        }
+        else
+        {
+            // The largest radius whose square still fits in a 64-bit integer.
+            constexpr Distance<Vec2> MaxRadius = 3037000499;
+            if (radius > MaxRadius || radius < -MaxRadius)
+            {
+                return std::numeric_limits<Distance<Vec2>>::max();
+            }
+            return static_cast<Distance<Vec2>>(radius) * radius;
+        }
+    }
+    
     /// An Axis-Aligned Bounding Box (AABB) defined by its minimum and maximum points.
     /// @tparam Vec2 The type of 2D vector to use.
     template<typename Vec2>
     struct Bounds
     {
+        using Scalar = QuadtreeDetail::Scalar<Vec2>;
+        using Distance = QuadtreeDetail::Distance<Vec2>;
+        
         /// The bottom-left corner of the bounding box.
         Vec2 min;
         /// The top-right corner of the bounding box.
@@ -51,14 +551,14 @@ namespace QuadtreeDetail
         
         /// Calculates the width of the bounding box.
         /// @return The measured width.
-        float GetWidth() const
+        Scalar GetWidth() const
         {
             return max.x - min.x;
         }
         
         /// Calculates the height of the bounding box.
         /// @return The measured height.
-        float GetHeight() const
+        Scalar GetHeight() const
         {
             return max.y - min.y;
         }
@@ -67,7 +567,56 @@ namespace QuadtreeDetail
         /// @return The position representing the center point.
         Vec2 GetCenter() const
         {
-            return (min + max) * 0.5f;
+            if constexpr (std::is_integral_v<Scalar>)
+            {
+                // Halving the extent with a shift keeps the center exact and can't overflow like min + max would.
+                return {static_cast<Scalar>(min.x + ((static_cast<Distance>(max.x) - min.x) >> 1)), static_cast<Scalar>(min.y + ((static_cast<Distance>(max.y) - min.y) >> 1))};
+            }
+            else
+            {
+                return (min + max) * static_cast<Scalar>(0.5);
+            }
+        }
+        
+        /// Calculates the area covered by one of the four quadrants of the bounding box.
+        /// @param index The index of the quadrant in Z-order: Top-Left, Top-Right, Bottom-Left, Bottom-Right.
+        /// @return The bounding box of the quadrant.
+        Bounds GetQuadrant(int index) const
+        {
+            Vec2 center = GetCenter();
+            switch (index)
+            {
+                case 0: return Bounds({min.x, center.y}, {center.x, max.y});
+                case 1: return Bounds(center, {max.x, max.y});
+                case 2: return Bounds({min.x, min.y}, center);
+                default: return Bounds({center.x, min.y}, {max.x, center.y});
+            }
+        }
+        
+        /// Determines which of the four quadrants a position belongs to, treating the center lines as part of the right and top quadrants.
+        /// @param position The position to check.
+        /// @return The index of the quadrant in the same Z-order used by GetQuadrant.
+        int GetQuadrantIndex(const Vec2& position) const
+        {
+            Vec2 center = GetCenter();
+            return (position.x >= center.x) + ((position.y < center.y) * 2);
+        }
+        
+        /// Orders the four quadrants for a nearest search, starting with the one that contains the target and ending with the opposite one.
+        /// @param target The position being searched around.
+        /// @return The quadrant indices in the order they should be visited.
+        std::array<int, 4> GetSearchOrder(const Vec2& target) const
+        {
+            Vec2 center = GetCenter();
+            int isRight = target.x >= center.x;
+            int isBottom = target.y < center.y;
+            
+            std::array<int, 4> sortedIndices;
+            sortedIndices[0] = isBottom * 2 + isRight;
+            sortedIndices[1] = isBottom * 2 + (1 - isRight);
+            sortedIndices[2] = (1 - isBottom) * 2 + isRight;
+            sortedIndices[3] = (1 - isBottom) * 2 + (1 - isRight);
+            return sortedIndices;
         }
         
         /// Returns true if this bounding box completely contains the other box.
@@ -86,6 +635,36 @@ namespace QuadtreeDetail
             return position.x >= min.x && position.y >= min.y && position.x <= max.x && position.y <= max.y;
         }
         
+        /// Calculates the squared distance from the given position to the closest point of this bounding box.
+        /// @param position The position to measure from.
+        /// @return The squared distance, which is zero if the position is inside the box.
+        Distance GetDistanceSq(const Vec2& position) const
+        {
+            Distance distanceX = std::max({static_cast<Distance>(min.x) - position.x, Distance(0), static_cast<Distance>(position.x) - max.x});
+            Distance distanceY = std::max({static_cast<Distance>(min.y) - position.y, Distance(0), static_cast<Distance>(position.y) - max.y});
+            return (distanceX * distanceX) + (distanceY * distanceY);
+        }
+        
+        /// Calculates the squared distance between the closest points of this bounding box and the other box.
+        /// @param other The other box to measure to.
+        /// @return The squared distance, which is zero if the boxes overlap.
+        Distance GetDistanceSq(const Bounds& other) const
+        {
+            Distance distanceX = std::max({static_cast<Distance>(min.x) - other.max.x, Distance(0), static_cast<Distance>(other.min.x) - max.x});
+            Distance distanceY = std::max({static_cast<Distance>(min.y) - other.max.y, Distance(0), static_cast<Distance>(other.min.y) - max.y});
+            return (distanceX * distanceX) + (distanceY * distanceY);
+        }
+        
+        /// Calculates the squared distance from the given position to the farthest corner of this bounding box.
+        /// @param position The position to measure from.
+        /// @return The squared distance, which bounds the distance to every point inside the box.
+        Distance GetFarthestDistanceSq(const Vec2& position) const
+        {
+            Distance distanceX = std::max(static_cast<Distance>(position.x) - min.x, static_cast<Distance>(max.x) - position.x);
+            Distance distanceY = std::max(static_cast<Distance>(position.y) - min.y, static_cast<Distance>(max.y) - position.y);
+            return (distanceX * distanceX) + (distanceY * distanceY);
+        }
+        
         /// Returns true if this bounding box overlaps the other box.
         /// @param other The other box to check against.
         /// @return True if the two boxes overlap, false otherwise.
@@ -105,37 +684,392 @@ namespace QuadtreeDetail
         }
     };
 
-    /// Represents a node in the Quadtree that may be a leaf or a branch.
-    /// @tparam T The type of data representing elements in the node.
+    /// Calculates the squared distance between two positions.
     /// @tparam Vec2 The type of 2D vector to use.
-    template<typename T, typename Vec2>
-    struct Node
+    /// @param a The first position.
+    /// @param b The second position.
+    /// @return The squared distance.
+    template<typename Vec2>
+    Distance<Vec2> GetDistanceSq(const Vec2& a, const Vec2& b)
     {
-        using Element = QuadtreeElement<T, Vec2>;
-        using Bounds = Bounds<Vec2>;
-        
-        /// Array containing the four child quadrants in Z-order: Top-Left, Top-Right, Bottom-Left, Bottom-Right.
-        std::array<std::unique_ptr<Node>, 4> children;
-        
-        /// Defines the area covered by this node.
-        Bounds bounds;
-        
-        /// How many levels down the node is from the root.
-        int depth;
-        
-        /// Indicates if this node is an endpoint and can store elements or if it's a branch with children.
-        bool isLeaf = true;
+        Distance<Vec2> distanceX = static_cast<Distance<Vec2>>(a.x) - b.x;
+        Distance<Vec2> distanceY = static_cast<Distance<Vec2>>(a.y) - b.y;
+        return (distanceX * distanceX) + (distanceY * distanceY);
+    }
+    
+    /// A segment that hits the elements within a radius of it, walked from its origin toward its end.
+    /// @tparam Vec2 The type of 2D vector to use.
+    template<typename Vec2>
+    struct Ray
+    {
+        using Real = QuadtreeDetail::Real<Vec2>;
         
-        /// Elements stored by this node when it's a leaf.
-        std::vector<Element> elements;
+        /// The horizontal coordinate of the start of the ray.
+        Real originX;
+        /// The vertical coordinate of the start of the ray.
+        Real originY;
+        /// The horizontal component of the unit direction of the ray.
+        Real directionX = 1;
+        /// The vertical component of the unit direction of the ray.
+        Real directionY = 0;
+        /// How far the ray reaches from its origin.
+        Real length;
+        /// How far from the ray an element can be and still be hit.
+        Real radius;
         
-        /// Construct a node with the given bounds
-        /// @param bounds The area covered by the node.
-        /// @param depth How many levels down the node is from the root.
-        Node(const Bounds& bounds, int depth) : bounds(bounds), depth(depth)
+        /// Construct a ray from its origin and a direction of any length.
+        /// @param origin The start of the ray.
+        /// @param directionX The horizontal component of the direction.
+        /// @param directionY The vertical component of the direction.
+        /// @param length How far the ray reaches, which is zero when the direction is zero so only the origin is tested.
+        /// @param radius How far from the ray an element can be and still be hit.
+        Ray(const Vec2& origin, Real directionX, Real directionY, Real length, Real radius) : originX(origin.x), originY(origin.y), length(std::max(length, Real(0))), radius(std::max(radius, Real(0)))
         {
-        }
-        
+            Real directionLength = std::sqrt((directionX * directionX) + (directionY * directionY));
+            if (directionLength > 0)
+            {
+                this->directionX = directionX / directionLength;
+                this->directionY = directionY / directionLength;
+            }
+            else
+            {
+                this->length = 0;
+            }
+        }
+        
+        /// Calculates where the ray enters a box enlarged by the hit radius, which is a lower bound on the distance to every element in the box it can hit.
+        /// @param bounds The box to clip the ray against.
+        /// @param enter Receives the distance along the ray where it enters the enlarged box, which is zero if the ray starts inside it.
+        /// @return True if the ray reaches the enlarged box, false otherwise.
+        bool Clip(const Bounds<Vec2>& bounds, Real& enter) const
+        {
+            Real enterDistance = 0;
+            Real exitDistance = length;
+            if (!ClipAxis(originX, directionX, Real(bounds.min.x) - radius, Real(bounds.max.x) + radius, enterDistance, exitDistance))
+            {
+                return false;
+            }
+            
+            if (!ClipAxis(originY, directionY, Real(bounds.min.y) - radius, Real(bounds.max.y) + radius, enterDistance, exitDistance))
+            {
+                return false;
+            }
+            
+            enter = enterDistance;
+            return true;
+        }
+        
+        /// Measures how far along the ray a position is hit.
+        /// @param position The position to test.
+        /// @param distance Receives the distance along the ray to the point of the ray closest to the position.
+        /// @return True if the position is within the hit radius of the ray, false otherwise.
+        bool Hit(const Vec2& position, Real& distance) const
+        {
+            Real offsetX = Real(position.x) - originX;
+            Real offsetY = Real(position.y) - originY;
+            Real along = std::clamp((offsetX * directionX) + (offsetY * directionY), Real(0), length);
+            Real missX = offsetX - (along * directionX);
+            Real missY = offsetY - (along * directionY);
+            if ((missX * missX) + (missY * missY) > radius * radius)
+            {
+                return false;
+            }
+            
+            distance = along;
+            return true;
+        }
+        
+    private:
+        /// Narrows the interval of the ray that lies between two lines along one axis, using the slab method.
+        /// @param origin The coordinate of the origin along the axis.
+        /// @param direction The component of the direction along the axis.
+        /// @param min The lower line.
+        /// @param max The upper line.
+        /// @param enterDistance The distance where the interval starts, which is moved forward.
+        /// @param exitDistance The distance where the interval ends, which is moved back.
+        /// @return True if the interval isn't empty, false otherwise.
+        static bool ClipAxis(Real origin, Real direction, Real min, Real max, Real& enterDistance, Real& exitDistance)
+        {
+            if (direction == 0)
+            {
+                return origin >= min && origin <= max;
+            }
+            
+            Real first = (min - origin) / direction;
+            Real second = (max - origin) / direction;
+            if (first > second)
+            {
+                std::swap(first, second);
+            }
+            
+            enterDistance = std::max(enterDistance, first);
+            exitDistance = std::min(exitDistance, second);
+            return enterDistance <= exitDistance;
+        }
+    };
+    
+    /// How many positions the SIMD kernels process at once, which is also the padding used for position arrays.
+#if defined(QUADTREE_SIMD_AVX2)
+    constexpr size_t SimdWidth = 8;
+#else
+    constexpr size_t SimdWidth = 4;
+#endif
+    
+    /// Creates a mask that selects the first lanes of a block.
+    /// @param count The number of valid positions remaining, which selects every lane once it reaches SimdWidth.
+    /// @return A mask with one bit set for each valid lane.
+    inline uint32_t GetLaneMask(size_t count)
+    {
+        return count >= SimdWidth ? (1u << SimdWidth) - 1 : (1u << count) - 1;
+    }
+    
+    /// Finds the index of the lowest set bit in a mask.
+    /// @param mask The mask to check, which must not be zero.
+    /// @return The index of the lowest set bit.
+    inline int CountTrailingZeros(uint32_t mask)
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return static_cast<int>(index);
+#else
+        return __builtin_ctz(mask);
+#endif
+    }
+    
+    /// Calculates the squared distances from a target to a block of SimdWidth positions stored as separate coordinate arrays.
+    /// @param x The horizontal coordinates of the positions.
+    /// @param y The vertical coordinates of the positions.
+    /// @param targetX The horizontal coordinate of the target.
+    /// @param targetY The vertical coordinate of the target.
+    /// @param maxDistanceSq The squared distance that a position must be under to be reported.
+    /// @param distancesSq Receives the squared distance of every position in the block.
+    /// @return A mask with one bit set for every position closer than the maximum distance.
+    inline uint32_t FindCloserPositions(const float* x, const float* y, float targetX, float targetY, float maxDistanceSq, float* distancesSq)
+    {
+#if defined(QUADTREE_SIMD_AVX2)
+        __m256 distanceX = _mm256_sub_ps(_mm256_loadu_ps(x), _mm256_set1_ps(targetX));
+        __m256 distanceY = _mm256_sub_ps(_mm256_loadu_ps(y), _mm256_set1_ps(targetY));
+        __m256 distanceSq = _mm256_add_ps(_mm256_mul_ps(distanceX, distanceX), _mm256_mul_ps(distanceY, distanceY));
+        _mm256_storeu_ps(distancesSq, distanceSq);
+        return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(distanceSq, _mm256_set1_ps(maxDistanceSq), _CMP_LT_OQ)));
+#elif defined(QUADTREE_SIMD_SSE2)
+        __m128 distanceX = _mm_sub_ps(_mm_loadu_ps(x), _mm_set1_ps(targetX));
+        __m128 distanceY = _mm_sub_ps(_mm_loadu_ps(y), _mm_set1_ps(targetY));
+        __m128 distanceSq = _mm_add_ps(_mm_mul_ps(distanceX, distanceX), _mm_mul_ps(distanceY, distanceY));
+        _mm_storeu_ps(distancesSq, distanceSq);
+        return static_cast<uint32_t>(_mm_movemask_ps(_mm_cmplt_ps(distanceSq, _mm_set1_ps(maxDistanceSq))));
+#else
+        uint32_t mask = 0;
+        for (size_t lane = 0; lane < SimdWidth; ++lane)
+        {
+            float distanceX = x[lane] - targetX;
+            float distanceY = y[lane] - targetY;
+            distancesSq[lane] = (distanceX * distanceX) + (distanceY * distanceY);
+            mask |= static_cast<uint32_t>(distancesSq[lane] < maxDistanceSq) << lane;
+        }
+        return mask;
+#endif
+    }
+    
+    /// Calculates the squared distances from a target to a block of SimdWidth positions whose coordinates have no SIMD kernel.
+    /// @tparam Scalar The type of the coordinates.
+    /// @tparam Distance The type of the squared distances.
+    /// @param x The horizontal coordinates of the positions.
+    /// @param y The vertical coordinates of the positions.
+    /// @param targetX The horizontal coordinate of the target.
+    /// @param targetY The vertical coordinate of the target.
+    /// @param maxDistanceSq The squared distance that a position must be under to be reported.
+    /// @param distancesSq Receives the squared distance of every position in the block.
+    /// @return A mask with one bit set for every position closer than the maximum distance.
+    template<typename Scalar, typename Distance>
+    uint32_t FindCloserPositions(const Scalar* x, const Scalar* y, Scalar targetX, Scalar targetY, Distance maxDistanceSq, Distance* distancesSq)
+    {
+        uint32_t mask = 0;
+        for (size_t lane = 0; lane < SimdWidth; ++lane)
+        {
+            Distance distanceX = static_cast<Distance>(x[lane]) - targetX;
+            Distance distanceY = static_cast<Distance>(y[lane]) - targetY;
+            distancesSq[lane] = (distanceX * distanceX) + (distanceY * distanceY);
+            mask |= static_cast<uint32_t>(distancesSq[lane] < maxDistanceSq) << lane;
+        }
+        return mask;
+    }
+    
+    /// Returns true if the bounding box contains the given position, evaluating every comparison to avoid branches.
+    /// @tparam Vec2 The type of 2D vector to use.
+    /// @param bounds The bounding box to check.
+    /// @param position The position to check.
+    /// @return True if the position is inside or on the boundary of the box, false otherwise.
+    template<typename Vec2>
+    bool ContainsBranchless(const Bounds<Vec2>& bounds, const Vec2& position)
+    {
+        return (position.x >= bounds.min.x) & (position.y >= bounds.min.y) & (position.x <= bounds.max.x) & (position.y <= bounds.max.y);
+    }
+    
+    /// Tests whether a block of SimdWidth positions stored as separate coordinate arrays is inside a bounding box.
+    /// @param x The horizontal coordinates of the positions.
+    /// @param y The vertical coordinates of the positions.
+    /// @param minX The left edge of the box.
+    /// @param minY The bottom edge of the box.
+    /// @param maxX The right edge of the box.
+    /// @param maxY The top edge of the box.
+    /// @return A mask with one bit set for every position inside or on the boundary of the box.
+    inline uint32_t FindContainedPositions(const float* x, const float* y, float minX, float minY, float maxX, float maxY)
+    {
+#if defined(QUADTREE_SIMD_AVX2)
+        __m256 positionX = _mm256_loadu_ps(x);
+        __m256 positionY = _mm256_loadu_ps(y);
+        __m256 insideX = _mm256_and_ps(_mm256_cmp_ps(positionX, _mm256_set1_ps(minX), _CMP_GE_OQ), _mm256_cmp_ps(positionX, _mm256_set1_ps(maxX), _CMP_LE_OQ));
+        __m256 insideY = _mm256_and_ps(_mm256_cmp_ps(positionY, _mm256_set1_ps(minY), _CMP_GE_OQ), _mm256_cmp_ps(positionY, _mm256_set1_ps(maxY), _CMP_LE_OQ));
+        return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_and_ps(insideX, insideY)));
+#elif defined(QUADTREE_SIMD_SSE2)
+        __m128 positionX = _mm_loadu_ps(x);
+        __m128 positionY = _mm_loadu_ps(y);
+        __m128 insideX = _mm_and_ps(_mm_cmpge_ps(positionX, _mm_set1_ps(minX)), _mm_cmple_ps(positionX, _mm_set1_ps(maxX)));
+        __m128 insideY = _mm_and_ps(_mm_cmpge_ps(positionY, _mm_set1_ps(minY)), _mm_cmple_ps(positionY, _mm_set1_ps(maxY)));
+        return static_cast<uint32_t>(_mm_movemask_ps(_mm_and_ps(insideX, insideY)));
+#else
+        uint32_t mask = 0;
+        for (size_t lane = 0; lane < SimdWidth; ++lane)
+        {
+            bool inside = (x[lane] >= minX) & (x[lane] <= maxX) & (y[lane] >= minY) & (y[lane] <= maxY);
+            mask |= static_cast<uint32_t>(inside) << lane;
+        }
+        return mask;
+#endif
+    }
+    
+    /// Tests whether a block of SimdWidth positions whose coordinates have no SIMD kernel is inside a bounding box.
+    /// @tparam Scalar The type of the coordinates.
+    /// @param x The horizontal coordinates of the positions.
+    /// @param y The vertical coordinates of the positions.
+    /// @param minX The left edge of the box.
+    /// @param minY The bottom edge of the box.
+    /// @param maxX The right edge of the box.
+    /// @param maxY The top edge of the box.
+    /// @return A mask with one bit set for every position inside or on the boundary of the box.
+    template<typename Scalar>
+    uint32_t FindContainedPositions(const Scalar* x, const Scalar* y, Scalar minX, Scalar minY, Scalar maxX, Scalar maxY)
+    {
+        uint32_t mask = 0;
+        for (size_t lane = 0; lane < SimdWidth; ++lane)
+        {
+            bool inside = (x[lane] >= minX) & (x[lane] <= maxX) & (y[lane] >= minY) & (y[lane] <= maxY);
+            mask |= static_cast<uint32_t>(inside) << lane;
+        }
+        return mask;
+    }
+    
+    /// Sorts entries by their keys using a least significant digit radix sort limited to the given number of high bits.
+    /// @tparam Entry A pair whose first member is the key to sort by.
+    /// @param entries The entries to sort.
+    /// @param bits How many of the most significant bits of the keys are in use.
+    template<typename Entry>
+    void RadixSort(std::vector<Entry>& entries, int bits)
+    {
+        constexpr int DigitBits = 8;
+        constexpr size_t DigitCount = size_t(1) << DigitBits;
+        
+        std::vector<Entry> buffer(entries.size());
+        for (int shift = 64 - bits; shift < 64; shift += DigitBits)
+        {
+            std::array<size_t, DigitCount> offsets = {};
+            for (const auto& entry : entries)
+            {
+                ++offsets[(entry.first >> shift) & (DigitCount - 1)];
+            }
+            
+            size_t offset = 0;
+            for (auto& count : offsets)
+            {
+                offset += std::exchange(count, offset);
+            }
+            
+            for (auto& entry : entries)
+            {
+                buffer[offsets[(entry.first >> shift) & (DigitCount - 1)]++] = std::move(entry);
+            }
+            
+            entries.swap(buffer);
+        }
+    }
+    
+    /// Controls when the children of a branch are merged back into it after removals.
+    struct MergePolicy
+    {
+        /// The largest number of elements the children can hold together for them to be merged.
+        size_t threshold;
+        
+        /// Whether merging waits for the tree to be compacted, marking the branches that lost elements instead.
+        bool deferred = false;
+    };
+    
+    /// Represents a node in the Quadtree that may be a leaf or a branch.
+    /// @tparam T The type of data representing elements in the node.
+    /// @tparam Vec2 The type of 2D vector to use.
+    template<typename T, typename Vec2>
+    struct Node
+    {
+        using Element = QuadtreeElement<T, Vec2>;
+        using Bounds = QuadtreeDetail::Bounds<Vec2>;
+        using Distance = QuadtreeDetail::Distance<Vec2>;
+        using Ray = QuadtreeDetail::Ray<Vec2>;
+        using Real = QuadtreeDetail::Real<Vec2>;
+        using Children = std::array<Node, 4>;
+        
+        /// Block containing the four child quadrants in Z-order: Top-Left, Top-Right, Bottom-Left, Bottom-Right.
+        Children* children = nullptr;
+        
+        /// Defines the area covered by this node.
+        Bounds bounds;
+        
+        /// How many levels down the node is from the root.
+        int depth;
+        
+        /// Indicates if this node is an endpoint and can store elements or if it's a branch with children.
+        bool isLeaf = true;
+        
+        /// Indicates if elements were removed below this branch while merging was deferred.
+        bool isDirty = false;
+        
+        /// How many elements are stored within this node and all of its descendants.
+        size_t count = 0;
+        
+        /// Elements stored by this node when it's a leaf.
+        std::vector<Element> elements;
+        
+        /// Construct a node with the given bounds
+        /// @param bounds The area covered by the node.
+        /// @param depth How many levels down the node is from the root.
+        Node(const Bounds& bounds, int depth) : bounds(bounds), depth(depth)
+        {
+        }
+        
+        /// Copy constructor is deleted since children are owned by a single node.
+        Node(const Node&) = delete;
+        
+        /// Move constructor that takes over the children and elements of the other node.
+        /// @param other The node to move from, which is left as an empty leaf.
+        Node(Node&& other) noexcept : children(std::exchange(other.children, nullptr)), bounds(other.bounds), depth(other.depth), isLeaf(std::exchange(other.isLeaf, true)), isDirty(std::exchange(other.isDirty, false)), count(std::exchange(other.count, 0)), elements(std::move(other.elements))
+        {
+        }
+        
+        /// Move assignment that takes over the children and elements of the other node.
+        /// @param other The node to move from, which is left as an empty leaf.
+        /// @return A reference to this node.
+        Node& operator=(Node&& other) noexcept
+        {
+            children = std::exchange(other.children, nullptr);
+            bounds = other.bounds;
+            depth = other.depth;
+            isLeaf = std::exchange(other.isLeaf, true);
+            isDirty = std::exchange(other.isDirty, false);
+            count = std::exchange(other.count, 0);
+            elements = std::move(other.elements);
+            return *this;
+        }
+        
         /// Calculates the height of this node from its deepest branch.
         /// @return The height of this node.
         size_t GetHeight() const
@@ -146,9 +1080,9 @@ namespace QuadtreeDetail
             }
             
             size_t height = 0;
-            for (const auto& child : children)
+            for (const auto& child : *children)
             {
-                height = std::max(child->GetHeight(), height);
+                height = std::max(child.GetHeight(), height);
             }
             
             return height + 1;
@@ -158,39 +1092,66 @@ namespace QuadtreeDetail
         /// @return The total number of elements.
         size_t CountElements() const
         {
-            if (isLeaf)
+            return count;
+        }
+        
+        /// Recursively adds the shape and memory of this node and its children to a report.
+        /// @param stats The report to add to.
+        void AddStructureStats(QuadtreeStructureStats& stats) const
+        {
+            ++stats.nodeCount;
+            if (!isLeaf)
             {
-                return elements.size();
+                stats.nodeBytes += sizeof(Children);
+                for (const auto& child : *children)
+                {
+                    child.AddStructureStats(stats);
+                }
+                return;
             }
             
-            size_t size = 0;
-            for (const auto& child : children)
+            size_t level = static_cast<size_t>(depth);
+            if (stats.leavesPerDepth.size() <= level)
             {
-                size += child->CountElements();
+                stats.leavesPerDepth.resize(level + 1);
+                stats.elementsPerDepth.resize(level + 1);
             }
             
-            return size;
+            ++stats.leafCount;
+            stats.emptyLeafCount += elements.empty();
+            stats.maxLeafElements = std::max(elements.size(), stats.maxLeafElements);
+            ++stats.leavesPerDepth[level];
+            stats.elementsPerDepth[level] += elements.size();
+            stats.elementBytes += elements.size() * sizeof(Element);
+            stats.slackBytes += (elements.capacity() - elements.size()) * sizeof(Element);
         }
         
         /// Inserts a new element with the given data and position.
+        /// @tparam Tracker A function that takes in a leaf and the index of an element placed in it.
         /// @param data The data representing the element.
         /// @param position The position where the element is.
         /// @param capacity The maximum number of elements to hold before subdividing.
         /// @param maxDepth The maximum depth a node can be from the root.
+        /// @param allocator The allocator that provides storage for new children.
+        /// @param stats The stats policy that records subdivisions.
+        /// @param tracker The function to call every time an element is placed, including the ones moved by a subdivision.
         /// @return True if the element was successfully inserted.
-        bool Insert(T data, const Vec2& position, size_t capacity, int maxDepth)
+        template<typename Allocator, typename Stats, typename Tracker = NoTracker>
+        bool Insert(T data, const Vec2& position, size_t capacity, int maxDepth, Allocator& allocator, Stats& stats, Tracker tracker = {})
         {
+            ++count;
             if (!isLeaf)
             {
                 int index = GetChildIndex(position);
-                return children[index]->Insert(data, position, capacity, maxDepth);
+                return (*children)[index].Insert(std::move(data), position, capacity, maxDepth, allocator, stats, tracker);
             }
             
-            elements.push_back({data, position});
+            elements.push_back({std::move(data), position});
+            tracker(*this, elements.size() - 1);
             
             if (elements.size() > capacity && depth < maxDepth)
             {
-                Subdivide(capacity, maxDepth);
+                Subdivide(capacity, maxDepth, allocator, stats, tracker);
             }
             
             return true;
@@ -199,21 +1160,19 @@ namespace QuadtreeDetail
         /// Removes an element matching the given data and position.
         /// @param data The data representing the element.
         /// @param position The position where the element is.
-        /// @param capacity The maximum number of elements a node can hold.
+        /// @param mergePolicy Controls when children are merged back after the removal.
+        /// @param allocator The allocator that reclaims the storage of merged children.
+        /// @param stats The stats policy that records merges.
+        /// @param removed Receives the removed element when provided.
         /// @return True if the element was successfully removed.
-        bool Remove(T data, const Vec2& position, size_t capacity)
+        template<typename Allocator, typename Stats>
+        bool Remove(const T& data, const Vec2& position, const MergePolicy& mergePolicy, Allocator& allocator, Stats& stats, std::optional<Element>* removed = nullptr)
         {
             if (isLeaf)
             {
-                auto it = std::find_if(elements.begin(), elements.end(), [&](const Element& element)
-                {
-                    return element.data == data && element.position == position;
-                });
-                
-                if (it != elements.end())
+                if (RemoveElement(elements, data, position, removed))
                 {
-                    *it = std::move(elements.back());
-                    elements.pop_back();
+                    --count;
                     return true;
                 }
                 
@@ -221,232 +1180,1776 @@ namespace QuadtreeDetail
             }
             
             int index = GetChildIndex(position);
-            if (children[index]->Remove(data, position, capacity))
+            if ((*children)[index].Remove(data, position, mergePolicy, allocator, stats, removed))
             {
-                TryMerge(capacity);
+                --count;
+                MergeAfterRemoval(mergePolicy, allocator, stats);
                 return true;
             }
             
             return false;
         }
         
-        /// Recursive helper for finding the nearest element.
-        /// @tparam Filter A function that takes in an element and returns true if it qualifies for the search.
-        /// @param target The search position.
-        /// @param filter The filter to pass for an element to qualify.
-        /// @param bestDistanceSq The best squared distance found so far.
-        /// @param nearest The closest element if found, or empty.
-        template<typename Filter>
-        void FindNearest(const Vec2& target, Filter filter, float& bestDistanceSq, std::optional<Element>& nearest) const
+        /// Inserts a batch of elements, appending each group to its leaf at once so that every node subdivides at most once.
+        /// @tparam Entry A pair made of a Z-order key and an iterator to the element to copy in, or to move in when it's a move iterator.
+        /// @param first The first entry that belongs to this node.
+        /// @param last The end of the entries that belong to this node, sorted by their Z-order keys.
+        /// @param keyDepth The depth of the node that the Z-order keys were calculated from.
+        /// @param capacity The maximum number of elements to hold before subdividing.
+        /// @param maxDepth The maximum depth a node can be from the root.
+        /// @param allocator The allocator that provides storage for new children.
+        /// @param stats The stats policy that records subdivisions.
+        template<typename Entry, typename Allocator, typename Stats>
+        void InsertBatch(Entry* first, Entry* last, int keyDepth, size_t capacity, int maxDepth, Allocator& allocator, Stats& stats)
         {
+            size_t batchSize = last - first;
+            count += batchSize;
             if (isLeaf)
             {
-                for (const auto& element : elements)
+                if (elements.size() + batchSize <= capacity || depth >= maxDepth)
                 {
-                    float distanceX = target.x - element.position.x;
-                    float distanceY = target.y - element.position.y;
-                    float distanceSq = (distanceX * distanceX) + (distanceY * distanceY);
-                    if (distanceSq < bestDistanceSq && filter(element))
+                    for (Entry* entry = first; entry != last; ++entry)
                     {
-                        bestDistanceSq = distanceSq;
-                        nearest = element;
+                        elements.push_back(*entry->second);
                     }
+                    return;
                 }
-                return;
+                
+                // The elements already here fit within the capacity, so they move straight into the children without subdividing them.
+                stats.OnSubdivision();
+                CreateChildren(allocator);
+                for (auto& element : elements)
+                {
+                    Node& child = (*children)[GetChildIndex(element.position)];
+                    child.elements.push_back(std::move(element));
+                    ++child.count;
+                }
+                
+                elements.clear();
             }
             
-            Vec2 center = bounds.GetCenter();
-            int isRight = target.x >= center.x;
-            int isBottom = target.y < center.y;
-            
-            // Bias the search toward the quadrant that contains the target.
-            std::array<int, 4> sortedIndices;
-            sortedIndices[0] = isBottom * 2 + isRight;
-            sortedIndices[1] = isBottom * 2 + (1 - isRight);
-            sortedIndices[2] = (1 - isBottom) * 2 + isRight;
-            sortedIndices[3] = (1 - isBottom) * 2 + (1 - isRight);
-            
-            for (int index : sortedIndices)
+            auto groups = GroupByChild(first, last, keyDepth);
+            for (int index = 0; index < 4; ++index)
             {
-                const auto& child = children[index];
-                float distanceX = std::max({child->bounds.min.x - target.x, 0.0f, target.x - child->bounds.max.x});
-                float distanceY = std::max({child->bounds.min.y - target.y, 0.0f, target.y - child->bounds.max.y});
-                float distanceSq = (distanceX * distanceX) + (distanceY * distanceY);
-                if (distanceSq < bestDistanceSq)
+                if (groups[index] != groups[index + 1])
                 {
-                    child->FindNearest(target, filter, bestDistanceSq, nearest);
+                    (*children)[index].InsertBatch(groups[index], groups[index + 1], keyDepth, capacity, maxDepth, allocator, stats);
                 }
             }
         }
         
-        /// Recursive helper for finding all elements within a search area.
-        /// @tparam Filter A function that takes in an element and returns true if it qualifies for the search.
-        /// @param searchArea The area to search within.
-        /// @param filter The filter to pass for an element to qualify.
-        /// @param foundElements The collection of elements found by the search.
-        template<typename Filter>
-        void FindAll(const Bounds& searchArea, Filter filter, std::vector<Element>& foundElements) const
+        /// Removes a batch of elements matching the given data and positions, merging every branch that lost elements at most once on the way back up.
+        /// @tparam Entry A pair made of a Z-order key and an iterator to the element to remove.
+        /// @param first The first entry that belongs to this node.
+        /// @param last The end of the entries that belong to this node, sorted by their Z-order keys.
+        /// @param keyDepth The depth of the node that the Z-order keys were calculated from.
+        /// @param mergePolicy Controls when children are merged back after the removals.
+        /// @param allocator The allocator that reclaims the storage of merged children.
+        /// @param stats The stats policy that records merges.
+        /// @return The number of elements removed.
+        template<typename Entry, typename Allocator, typename Stats>
+        size_t RemoveBatch(Entry* first, Entry* last, int keyDepth, const MergePolicy& mergePolicy, Allocator& allocator, Stats& stats)
         {
-            if (searchArea.Contains(bounds))
-            {
-                GetAllElements(filter, foundElements);
-                return;
-            }
-            
+            size_t removedCount = 0;
             if (isLeaf)
             {
-                for (const auto& element : elements)
+                for (Entry* entry = first; entry != last; ++entry)
                 {
-                    if (searchArea.Contains(element.position) && filter(element))
-                    {
-                        foundElements.push_back(element);
-                    }
+                    removedCount += RemoveElement(elements, entry->second->data, entry->second->position);
                 }
-                return;
+                
+                count -= removedCount;
+                return removedCount;
             }
             
-            for (const auto& child : children)
+            auto groups = GroupByChild(first, last, keyDepth);
+            for (int index = 0; index < 4; ++index)
             {
-                if (child->bounds.Intersects(searchArea))
+                if (groups[index] != groups[index + 1])
                 {
-                    child->FindAll(searchArea, filter, foundElements);
+                    removedCount += (*children)[index].RemoveBatch(groups[index], groups[index + 1], keyDepth, mergePolicy, allocator, stats);
                 }
             }
+            
+            if (removedCount > 0)
+            {
+                count -= removedCount;
+                MergeAfterRemoval(mergePolicy, allocator, stats);
+            }
+            
+            return removedCount;
         }
         
-    private:
-        /// Determines the index to the children array based on where the position belongs to.
-        /// @param position The position to check.
-        /// @return The index to the corresponding child.
-        int GetChildIndex(const Vec2& position) const
-        {
-            // Use a Z-order curve to map the children into a one-dimensional sequence.
-            // 0: Left-Top
-            // 1: Right-Top
-            // 2: Left-Bottom
-            // 3: Right-Bottom
-            Vec2 center = bounds.GetCenter();
-            return (position.x >= center.x) + ((position.y < center.y) * 2);
-        }
-        
-        /// Recursively collect all elements in this node and its children.
-        /// @tparam Filter A function that takes in an element and returns true if it qualifies for the search.
-        /// @param filter The filter to pass for an element to qualify.
-        /// @param allElements The collection where elements are accumulated.
-        template<typename Filter>
-        void GetAllElements(Filter filter, std::vector<Element>& allElements) const
+        /// Moves an element matching the given data from one position to another.
+        /// @param data The data representing the element.
+        /// @param oldPosition The position where the element is.
+        /// @param newPosition The position to move the element to, which must be inside this node.
+        /// @param capacity The maximum number of elements a node can hold.
+        /// @param maxDepth The maximum depth a node can be from the root.
+        /// @param mergePolicy Controls when children are merged back after the element leaves them.
+        /// @param allocator The allocator that provides and reclaims the storage of children.
+        /// @param stats The stats policy that records subdivisions and merges.
+        /// @return True if the element was found and moved.
+        template<typename Allocator, typename Stats>
+        bool Update(const T& data, const Vec2& oldPosition, const Vec2& newPosition, size_t capacity, int maxDepth, const MergePolicy& mergePolicy, Allocator& allocator, Stats& stats)
         {
             if (isLeaf)
             {
-                if constexpr (std::is_same_v<Filter, NoFilter>)
+                // Both positions lead to this leaf, so the element can be moved in place.
+                auto it = std::find_if(elements.begin(), elements.end(), [&](const Element& element)
                 {
-                    allElements.insert(allElements.end(), elements.begin(), elements.end());
-                }
-                else
+                    return element.data == data && element.position == oldPosition;
+                });
+                
+                if (it != elements.end())
                 {
-                    for (const auto& element : elements)
-                    {
-                        if (filter(element))
-                        {
-                            allElements.push_back(element);
-                        }
-                    }
+                    it->position = newPosition;
+                    return true;
                 }
-                return;
+                
+                return false;
             }
             
-            for (const auto& child : children)
+            int oldIndex = GetChildIndex(oldPosition);
+            int newIndex = GetChildIndex(newPosition);
+            if (oldIndex == newIndex)
             {
-                child->GetAllElements(filter, allElements);
+                // No element leaves this subtree, so only the lowest common ancestor below may need to merge.
+                return (*children)[oldIndex].Update(data, oldPosition, newPosition, capacity, maxDepth, mergePolicy, allocator, stats);
             }
-        }
-        
-        /// Divides this node into a branch by passing its elements into its children.
-        /// @param capacity The maximum number of elements a node can hold.
-        /// @param maxDepth The maximum depth a node can be from the root.
-        void Subdivide(size_t capacity, int maxDepth)
-        {
-            Vec2 min = bounds.min;
-            Vec2 max = bounds.max;
-            Vec2 center = bounds.GetCenter();
-            
-            Bounds topLeft({min.x, center.y}, {center.x, max.y});
-            Bounds topRight(center, {max.x, max.y});
-            Bounds bottomLeft({min.x, min.y}, center);
-            Bounds bottomRight({center.x, min.y}, {max.x, center.y});
-            
-            int childDepth = depth + 1;
-            children[0] = std::make_unique<Node>(topLeft, childDepth);
-            children[1] = std::make_unique<Node>(topRight, childDepth);
-            children[2] = std::make_unique<Node>(bottomLeft, childDepth);
-            children[3] = std::make_unique<Node>(bottomRight, childDepth);
             
-            for (auto& element : elements)
+            // This is the lowest common ancestor of both positions, so the element only has to travel between two of its children.
+            std::optional<Element> removed;
+            if ((*children)[oldIndex].Remove(data, oldPosition, mergePolicy, allocator, stats, &removed))
             {
-                int index = GetChildIndex(element.position);
-                children[index]->Insert(std::move(element.data), element.position, capacity, maxDepth);
+                (*children)[newIndex].Insert(std::move(removed->data), newPosition, capacity, maxDepth, allocator, stats);
+                MergeAfterRemoval(mergePolicy, allocator, stats);
+                return true;
             }
             
-            isLeaf = false;
-            elements.clear();
+            return false;
         }
         
-        /// Attempts to merge the children back into this node if their elements fit within this node's capacity.
-        /// @param capacity The maximum number of elements a node can hold.
-        void TryMerge(size_t capacity)
+        /// Removes the element at a known index of a leaf without searching the leaf for it.
+        /// @tparam Tracker A function that takes in a leaf and the index of an element placed in it.
+        /// @param position The position of the element, which leads to the leaf.
+        /// @param index The index of the element within the leaf.
+        /// @param mergePolicy Controls when children are merged back after the removal.
+        /// @param allocator The allocator that reclaims the storage of merged children.
+        /// @param stats The stats policy that records merges.
+        /// @param tracker The function to call for the element that fills the gap and the elements moved by a merge.
+        /// @return The data of the removed element.
+        template<typename Allocator, typename Stats, typename Tracker>
+        T RemoveAt(const Vec2& position, size_t index, const MergePolicy& mergePolicy, Allocator& allocator, Stats& stats, Tracker tracker)
         {
-            for (const auto& child : children)
+            --count;
+            if (isLeaf)
             {
-                if (!child->isLeaf)
+                T data = std::move(elements[index].data);
+                elements[index] = std::move(elements.back());
+                elements.pop_back();
+                if (index < elements.size())
                 {
-                    return;
+                    tracker(*this, index);
                 }
+                return data;
             }
             
-            size_t elementCount = 0;
-            for (const auto& child : children)
+            T data = (*children)[GetChildIndex(position)].RemoveAt(position, index, mergePolicy, allocator, stats, tracker);
+            MergeAfterRemoval(mergePolicy, allocator, stats, tracker);
+            return data;
+        }
+        
+        /// Moves the element at a known index of a leaf to another position without searching the leaf for it.
+        /// @tparam Tracker A function that takes in a leaf and the index of an element placed in it.
+        /// @param oldPosition The position of the element, which leads to the leaf.
+        /// @param index The index of the element within the leaf.
+        /// @param newPosition The position to move the element to, which must be inside this node.
+        /// @param capacity The maximum number of elements a node can hold.
+        /// @param maxDepth The maximum depth a node can be from the root.
+        /// @param mergePolicy Controls when children are merged back after the element leaves them.
+        /// @param allocator The allocator that provides and reclaims the storage of children.
+        /// @param stats The stats policy that records subdivisions and merges.
+        /// @param tracker The function to call for every element that is placed or moved by the update.
+        template<typename Allocator, typename Stats, typename Tracker>
+        void UpdateAt(const Vec2& oldPosition, size_t index, const Vec2& newPosition, size_t capacity, int maxDepth, const MergePolicy& mergePolicy, Allocator& allocator, Stats& stats, Tracker tracker)
+        {
+            if (isLeaf)
             {
-                elementCount += child->elements.size();
+                elements[index].position = newPosition;
+                return;
             }
             
-            if (elementCount <= capacity)
+            int oldIndex = GetChildIndex(oldPosition);
+            int newIndex = GetChildIndex(newPosition);
+            if (oldIndex == newIndex)
             {
-                elements.reserve(elementCount);
-                for (auto& child : children)
-                {
-                    for (auto& element : child->elements)
-                    {
+                (*children)[oldIndex].UpdateAt(oldPosition, index, newPosition, capacity, maxDepth, mergePolicy, allocator, stats, tracker);
+                return;
+            }
+            
+            // This is the lowest common ancestor of both positions, so the element only has to travel between two of its children.
+            T data = (*children)[oldIndex].RemoveAt(oldPosition, index, mergePolicy, allocator, stats, tracker);
+            (*children)[newIndex].Insert(std::move(data), newPosition, capacity, maxDepth, allocator, stats, tracker);
+            MergeAfterRemoval(mergePolicy, allocator, stats, tracker);
+        }
+        
+        /// Returns true if a position leads to this node from the root, which treats the bounds as half-open like GetChildIndex does.
+        /// @param position The position to check.
+        /// @param rootBounds The area covered by the root, whose maximum edges still belong to the nodes along them.
+        /// @return True if the position belongs to this node.
+        bool Owns(const Vec2& position, const Bounds& rootBounds) const
+        {
+            return position.x >= bounds.min.x && position.y >= bounds.min.y && (position.x < bounds.max.x || (position.x == bounds.max.x && bounds.max.x == rootBounds.max.x)) && (position.y < bounds.max.y || (position.y == bounds.max.y && bounds.max.y == rootBounds.max.y));
+        }
+        
+        /// Calculates a Z-order key for a position by following the quadrants that contain it from this node downward.
+        /// @param position The position to encode.
+        /// @param maxDepth The maximum depth a node can be from the root.
+        /// @return The key, with the quadrant index for each level stored in two bits starting from the most significant ones.
+        uint64_t GetMortonCode(const Vec2& position, int maxDepth) const
+        {
+            // Descending through the same quadrant bounds used by CreateChildren keeps the keys consistent with GetChildIndex.
+            uint64_t code = 0;
+            Bounds area = bounds;
+            int levels = std::min(maxDepth - depth, MortonLevels);
+            for (int level = 0; level < levels; ++level)
+            {
+                int index = area.GetQuadrantIndex(position);
+                code |= static_cast<uint64_t>(index) << GetMortonShift(level);
+                area = area.GetQuadrant(index);
+            }
+            return code;
+        }
+        
+        /// Recursively builds the subtree of this empty leaf from entries sorted by their Z-order keys.
+        /// @tparam Entry A pair made of a Z-order key and an iterator to the element to copy in, or to move in when it's a move iterator.
+        /// @param first The first entry that belongs to this node.
+        /// @param last The end of the entries that belong to this node.
+        /// @param keyDepth The depth of the node that the Z-order keys were calculated from.
+        /// @param capacity The maximum number of elements to hold before subdividing.
+        /// @param maxDepth The maximum depth a node can be from the root.
+        /// @param allocator The allocator that provides storage for new children.
+        template<typename Entry, typename Allocator>
+        void Build(Entry* first, Entry* last, int keyDepth, size_t capacity, int maxDepth, Allocator& allocator)
+        {
+            count = last - first;
+            if (count <= capacity || depth >= maxDepth)
+            {
+                elements.reserve(count);
+                for (Entry* entry = first; entry != last; ++entry)
+                {
+                    elements.push_back(*entry->second);
+                }
+                return;
+            }
+            
+            CreateChildren(allocator);
+            
+            auto groups = GroupByChild(first, last, keyDepth);
+            for (int index = 0; index < 4; ++index)
+            {
+                (*children)[index].Build(groups[index], groups[index + 1], keyDepth, capacity, maxDepth, allocator);
+            }
+        }
+        
+        /// Recursive helper for finding the nearest element.
+        /// @tparam Filter A function that takes in an element and returns true if it qualifies for the search.
+        /// @param target The search position.
+        /// @param filter The filter to pass for an element to qualify.
+        /// @param bestDistanceSq The best squared distance found so far.
+        /// @param nearest The closest element if found, or empty.
+        /// @param stats The stats policy that records the work done by the search.
+        template<typename Filter, typename Stats>
+        void FindNearest(const Vec2& target, Filter filter, Distance& bestDistanceSq, std::optional<Element>& nearest, Stats& stats) const
+        {
+            stats.OnNodeVisited();
+            if (isLeaf)
+            {
+                FindNearestInLeaf(elements, target, filter, bestDistanceSq, nearest, stats);
+                return;
+            }
+            
+            // Bias the search toward the quadrant that contains the target.
+            for (int index : bounds.GetSearchOrder(target))
+            {
+                const auto& child = (*children)[index];
+                if (child.bounds.GetDistanceSq(target) < bestDistanceSq)
+                {
+                    child.FindNearest(target, filter, bestDistanceSq, nearest, stats);
+                }
+                else
+                {
+                    stats.OnSubtreePruned();
+                }
+            }
+        }
+        
+        /// Recursive helper for finding the k nearest elements.
+        /// @tparam Filter A function that takes in an element and returns true if it qualifies for the search.
+        /// @param target The search position.
+        /// @param k The maximum number of elements to find.
+        /// @param filter The filter to pass for an element to qualify.
+        /// @param worstDistanceSq The squared distance an element must beat to be kept, which shrinks once k elements are found.
+        /// @param nearest A max-heap of the closest elements found so far, keyed by their squared distance to the target.
+        /// @param stats The stats policy that records the work done by the search.
+        template<typename Filter, typename Stats>
+        void FindKNearest(const Vec2& target, size_t k, Filter filter, Distance& worstDistanceSq, std::vector<std::pair<Distance, Element>>& nearest, Stats& stats) const
+        {
+            stats.OnNodeVisited();
+            if (isLeaf)
+            {
+                stats.OnLeafScanned();
+                stats.OnElementsTested(elements.size());
+                auto isCloser = [](const std::pair<Distance, Element>& a, const std::pair<Distance, Element>& b)
+                {
+                    return a.first < b.first;
+                };
+                
+                for (const auto& element : elements)
+                {
+                    Distance distanceSq = GetDistanceSq(target, element.position);
+                    if (distanceSq < worstDistanceSq && Passes(filter, element, stats))
+                    {
+                        if (nearest.size() == k)
+                        {
+                            std::pop_heap(nearest.begin(), nearest.end(), isCloser);
+                            nearest.back() = {distanceSq, element};
+                        }
+                        else
+                        {
+                            nearest.emplace_back(distanceSq, element);
+                        }
+                        
+                        std::push_heap(nearest.begin(), nearest.end(), isCloser);
+                        if (nearest.size() == k)
+                        {
+                            worstDistanceSq = nearest.front().first;
+                        }
+                    }
+                }
+                return;
+            }
+            
+            // Bias the search toward the quadrant that contains the target.
+            for (int index : bounds.GetSearchOrder(target))
+            {
+                const auto& child = (*children)[index];
+                if (child.bounds.GetDistanceSq(target) < worstDistanceSq)
+                {
+                    child.FindKNearest(target, k, filter, worstDistanceSq, nearest, stats);
+                }
+                else
+                {
+                    stats.OnSubtreePruned();
+                }
+            }
+        }
+        
+        /// Recursive helper for finding all elements within a search area.
+        /// @tparam Filter A function that takes in an element and returns true if it qualifies for the search.
+        /// @param searchArea The area to search within.
+        /// @param filter The filter to pass for an element to qualify.
+        /// @param foundElements The collection of elements found by the search.
+        /// @param stats The stats policy that records the work done by the search.
+        template<typename Filter, typename Stats>
+        void FindAll(const Bounds& searchArea, Filter filter, std::vector<Element>& foundElements, Stats& stats) const
+        {
+            if (searchArea.Contains(bounds))
+            {
+                GetAllElements(filter, foundElements, stats);
+                return;
+            }
+            
+            stats.OnNodeVisited();
+            if (isLeaf)
+            {
+                FindAllInLeaf(elements, searchArea, filter, foundElements, stats);
+                return;
+            }
+            
+            for (const auto& child : *children)
+            {
+                if (child.bounds.Intersects(searchArea))
+                {
+                    child.FindAll(searchArea, filter, foundElements, stats);
+                }
+                else
+                {
+                    stats.OnSubtreePruned();
+                }
+            }
+        }
+        
+        /// Recursive helper for visiting all elements within a search area.
+        /// @tparam Visitor A function that takes in an element and returns false to stop the traversal.
+        /// @param searchArea The area to search within.
+        /// @param visitor The function to call with every element found.
+        /// @return False if the visitor stopped the traversal, true otherwise.
+        template<typename Visitor>
+        bool ForEachInArea(const Bounds& searchArea, Visitor& visitor) const
+        {
+            if (searchArea.Contains(bounds))
+            {
+                return ForEachElement(visitor);
+            }
+            
+            if (isLeaf)
+            {
+                for (const auto& element : elements)
+                {
+                    if (searchArea.Contains(element.position) && !visitor(element))
+                    {
+                        return false;
+                    }
+                }
+                return true;
+            }
+            
+            for (const auto& child : *children)
+            {
+                if (child.bounds.Intersects(searchArea) && !child.ForEachInArea(searchArea, visitor))
+                {
+                    return false;
+                }
+            }
+            
+            return true;
+        }
+        
+        /// Recursive helper for finding the first element hit by a ray.
+        /// @tparam Filter A function that takes in an element and returns true if it qualifies for the search.
+        /// @tparam Stats The stats policy that counts the work done.
+        /// @param ray The ray to cast.
+        /// @param filter The filter to pass for an element to qualify.
+        /// @param bestDistance The distance along the ray to the first hit found so far.
+        /// @param nearest The first element hit if found, or empty.
+        /// @param stats The stats policy that records the work done by the search.
+        template<typename Filter, typename Stats>
+        void RayCast(const Ray& ray, Filter filter, Real& bestDistance, std::optional<Element>& nearest, Stats& stats) const
+        {
+            stats.OnNodeVisited();
+            if (isLeaf)
+            {
+                stats.OnLeafScanned();
+                stats.OnElementsTested(elements.size());
+                for (const auto& element : elements)
+                {
+                    Real distance;
+                    if (ray.Hit(element.position, distance) && distance < bestDistance && Passes(filter, element, stats))
+                    {
+                        bestDistance = distance;
+                        nearest = element;
+                    }
+                }
+                return;
+            }
+            
+            // Flipping the Z-order indices by the signs of the direction visits the quadrant the ray starts in first and the one it ends in last.
+            int mirror = (ray.directionX < 0) + ((ray.directionY > 0) * 2);
+            for (int order = 0; order < 4; ++order)
+            {
+                const auto& child = (*children)[order ^ mirror];
+                Real enter;
+                if (ray.Clip(child.bounds, enter) && enter < bestDistance)
+                {
+                    child.RayCast(ray, filter, bestDistance, nearest, stats);
+                }
+                else
+                {
+                    stats.OnSubtreePruned();
+                }
+            }
+        }
+        
+        /// Recursive helper for finding all elements within a circle.
+        /// @tparam Filter A function that takes in an element and returns true if it qualifies for the search.
+        /// @param center The center of the circle.
+        /// @param radiusSq The squared radius of the circle.
+        /// @param filter The filter to pass for an element to qualify.
+        /// @param foundElements The collection of elements found by the search.
+        /// @param stats The stats policy that records the work done by the search.
+        template<typename Filter, typename Stats>
+        void FindInRadius(const Vec2& center, Distance radiusSq, Filter filter, std::vector<Element>& foundElements, Stats& stats) const
+        {
+            // Every position is inside the circle when the farthest corner is, so only nodes that straddle its edge test their elements.
+            if (bounds.GetFarthestDistanceSq(center) <= radiusSq)
+            {
+                GetAllElements(filter, foundElements, stats);
+                return;
+            }
+            
+            stats.OnNodeVisited();
+            if (isLeaf)
+            {
+                stats.OnLeafScanned();
+                stats.OnElementsTested(elements.size());
+                for (const auto& element : elements)
+                {
+                    if (GetDistanceSq(center, element.position) <= radiusSq && Passes(filter, element, stats))
+                    {
+                        foundElements.push_back(element);
+                    }
+                }
+                return;
+            }
+            
+            for (const auto& child : *children)
+            {
+                if (child.bounds.GetDistanceSq(center) <= radiusSq)
+                {
+                    child.FindInRadius(center, radiusSq, filter, foundElements, stats);
+                }
+                else
+                {
+                    stats.OnSubtreePruned();
+                }
+            }
+        }
+        
+        /// Recursive helper for visiting every pair of elements within a distance of each other exactly once.
+        /// @tparam Visitor A function that takes in the two elements of a pair.
+        /// @param other The node whose elements are paired with this node's elements, or null to pair this node's elements among themselves.
+        /// @param distanceSq The squared distance that the elements of a pair must be within.
+        /// @param visitor The function to call with every pair found.
+        /// @param stats The stats policy that records the work done by the search.
+        template<typename Visitor, typename Stats>
+        void ForEachPair(const Node* other, Distance distanceSq, Visitor& visitor, Stats& stats) const
+        {
+            stats.OnNodeVisited();
+            if (!isLeaf || (other && !other->isLeaf))
+            {
+                SplitPair(other, distanceSq, [&](const Node& node, const Node* otherNode) { node.ForEachPair(otherNode, distanceSq, visitor, stats); }, stats);
+                return;
+            }
+            
+            stats.OnLeafScanned();
+            if (!other)
+            {
+                stats.OnElementsTested(elements.size() * (elements.size() - 1) / 2);
+                for (size_t i = 0; i < elements.size(); ++i)
+                {
+                    for (size_t j = i + 1; j < elements.size(); ++j)
+                    {
+                        if (GetDistanceSq(elements[i].position, elements[j].position) <= distanceSq)
+                        {
+                            visitor(elements[i], elements[j]);
+                        }
+                    }
+                }
+                return;
+            }
+            
+            // Both leaves are contiguous, so the inner loop only reads positions until it finds a pair.
+            stats.OnElementsTested(elements.size() * other->elements.size());
+            for (const auto& element : elements)
+            {
+                for (const auto& otherElement : other->elements)
+                {
+                    if (GetDistanceSq(element.position, otherElement.position) <= distanceSq)
+                    {
+                        visitor(element, otherElement);
+                    }
+                }
+            }
+        }
+        
+        /// Splits a pair of nodes into the pairs below them that can still hold elements within a distance of each other.
+        /// Pairing a branch with itself yields each child with itself and every pair of distinct children once, so no pair of elements is reached twice.
+        /// @tparam Emit A function that takes in a node and the node to pair it with, or null to pair its elements among themselves.
+        /// @param other The node to pair with this node, or null to pair this node with itself.
+        /// @param distanceSq The squared distance that the elements of a pair must be within.
+        /// @param emit The function to call with every pair of nodes below this pair.
+        /// @param stats The stats policy that records the pairs of nodes pruned.
+        template<typename Emit, typename Stats>
+        void SplitPair(const Node* other, Distance distanceSq, Emit emit, Stats& stats) const
+        {
+            if (!other)
+            {
+                for (int i = 0; i < 4; ++i)
+                {
+                    const Node& child = (*children)[i];
+                    if (child.count > 1)
+                    {
+                        emit(child, nullptr);
+                    }
+                    
+                    for (int j = i + 1; j < 4; ++j)
+                    {
+                        const Node& otherChild = (*children)[j];
+                        if (child.count > 0 && otherChild.count > 0 && child.bounds.GetDistanceSq(otherChild.bounds) <= distanceSq)
+                        {
+                            emit(child, &otherChild);
+                        }
+                        else
+                        {
+                            stats.OnSubtreePruned();
+                        }
+                    }
+                }
+                return;
+            }
+            
+            // Descend into the larger node so that both sides of a pair shrink at the same pace.
+            bool splitThis = other->isLeaf || (!isLeaf && depth <= other->depth);
+            const Node& branch = splitThis ? *this : *other;
+            const Node& node = splitThis ? *other : *this;
+            for (const auto& child : *branch.children)
+            {
+                if (child.count > 0 && child.bounds.GetDistanceSq(node.bounds) <= distanceSq)
+                {
+                    emit(child, &node);
+                }
+                else
+                {
+                    stats.OnSubtreePruned();
+                }
+            }
+        }
+        
+        /// Recursive helper for visiting all elements within a circle.
+        /// @tparam Visitor A function that takes in an element and returns false to stop the traversal.
+        /// @param center The center of the circle.
+        /// @param radiusSq The squared radius of the circle.
+        /// @param visitor The function to call with every element found.
+        /// @return False if the visitor stopped the traversal, true otherwise.
+        template<typename Visitor>
+        bool ForEachInRadius(const Vec2& center, Distance radiusSq, Visitor& visitor) const
+        {
+            if (bounds.GetFarthestDistanceSq(center) <= radiusSq)
+            {
+                return ForEachElement(visitor);
+            }
+            
+            if (isLeaf)
+            {
+                for (const auto& element : elements)
+                {
+                    if (GetDistanceSq(center, element.position) <= radiusSq && !visitor(element))
+                    {
+                        return false;
+                    }
+                }
+                return true;
+            }
+            
+            for (const auto& child : *children)
+            {
+                if (child.bounds.GetDistanceSq(center) <= radiusSq && !child.ForEachInRadius(center, radiusSq, visitor))
+                {
+                    return false;
+                }
+            }
+            
+            return true;
+        }
+        
+        /// Recursive helper for counting the elements within a search area.
+        /// @tparam Filter A function that takes in an element and returns true if it qualifies for the search.
+        /// @param searchArea The area to search within.
+        /// @param filter The filter to pass for an element to qualify.
+        /// @return The number of elements found.
+        template<typename Filter>
+        size_t CountInArea(const Bounds& searchArea, Filter& filter) const
+        {
+            bool containsNode = searchArea.Contains(bounds);
+            if constexpr (std::is_same_v<Filter, NoFilter>)
+            {
+                // Without a filter every element of a contained subtree counts, so its cached count is enough.
+                if (containsNode)
+                {
+                    return count;
+                }
+            }
+            
+            if (isLeaf)
+            {
+                size_t found = 0;
+                for (const auto& element : elements)
+                {
+                    found += (containsNode || searchArea.Contains(element.position)) && filter(element);
+                }
+                return found;
+            }
+            
+            size_t found = 0;
+            for (const auto& child : *children)
+            {
+                if (child.bounds.Intersects(searchArea))
+                {
+                    found += child.CountInArea(searchArea, filter);
+                }
+            }
+            
+            return found;
+        }
+        
+        /// Recursively visits all elements in this node and its children.
+        /// @tparam Visitor A function that takes in an element and returns false to stop the traversal.
+        /// @param visitor The function to call with every element.
+        /// @return False if the visitor stopped the traversal, true otherwise.
+        template<typename Visitor>
+        bool ForEachElement(Visitor& visitor) const
+        {
+            if (isLeaf)
+            {
+                for (const auto& element : elements)
+                {
+                    if (!visitor(element))
+                    {
+                        return false;
+                    }
+                }
+                return true;
+            }
+            
+            for (const auto& child : *children)
+            {
+                if (!child.ForEachElement(visitor))
+                {
+                    return false;
+                }
+            }
+            
+            return true;
+        }
+        
+        /// Merges every subtree below this node that lost elements while merging was deferred and now fits within the merge threshold.
+        /// @param mergeThreshold The largest number of elements the children of a branch can hold together for them to be merged.
+        /// @param allocator The allocator that reclaims the storage of merged children.
+        /// @param stats The stats policy that records merges.
+        /// @param tracker The function to call every time a merge places an element.
+        template<typename Allocator, typename Stats, typename Tracker = NoTracker>
+        void Compact(size_t mergeThreshold, Allocator& allocator, Stats& stats, Tracker tracker = {})
+        {
+            if (isLeaf || !isDirty)
+            {
+                return;
+            }
+            
+            // Compacting the children first lets merges cascade upward within a single pass.
+            isDirty = false;
+            for (auto& child : *children)
+            {
+                child.Compact(mergeThreshold, allocator, stats, tracker);
+            }
+            
+            TryMerge(mergeThreshold, allocator, stats, tracker);
+        }
+        
+        /// Shifts the depth of this node and all its descendants, used when the tree gains or loses levels above them.
+        /// @param offset How many levels to add to the depth.
+        void OffsetDepth(int offset)
+        {
+            depth += offset;
+            if (!isLeaf)
+            {
+                for (auto& child : *children)
+                {
+                    child.OffsetDepth(offset);
+                }
+            }
+        }
+        
+        /// Turns this node into a branch covering a larger area, whose quadrant at the given index takes over the current contents of the node.
+        /// @param newBounds The area covered by the node afterwards, of which the current bounds are one quadrant.
+        /// @param index The quadrant that takes over the current contents of the node.
+        /// @param allocator The allocator that provides storage for the children.
+        template<typename Allocator>
+        void Expand(const Bounds& newBounds, int index, Allocator& allocator)
+        {
+            size_t childCount = count;
+            Node child = std::move(*this);
+            child.OffsetDepth(1);
+            
+            bounds = newBounds;
+            count = childCount;
+            CreateChildren(allocator);
+            (*children)[index] = std::move(child);
+        }
+        
+        /// Destroys all the descendants of this node and discards its elements, leaving it as an empty leaf.
+        /// @param allocator The allocator that reclaims the storage of the children.
+        template<typename Allocator>
+        void Clear(Allocator& allocator)
+        {
+            if (!isLeaf)
+            {
+                DestroyChildren(allocator);
+            }
+            
+            elements.clear();
+            count = 0;
+        }
+        
+        /// Removes the first element matching the given data and position from a leaf's elements by swapping the last element into its place.
+        /// @param elements The elements of the leaf.
+        /// @param data The data representing the element.
+        /// @param position The position where the element is.
+        /// @param removed Receives the removed element when provided.
+        /// @return True if the element was found and removed.
+        static bool RemoveElement(std::vector<Element>& elements, const T& data, const Vec2& position, std::optional<Element>* removed = nullptr)
+        {
+            auto it = std::find_if(elements.begin(), elements.end(), [&](const Element& element)
+            {
+                return element.data == data && element.position == position;
+            });
+            
+            if (it == elements.end())
+            {
+                return false;
+            }
+            
+            if (removed)
+            {
+                *removed = std::move(*it);
+            }
+            
+            *it = std::move(elements.back());
+            elements.pop_back();
+            return true;
+        }
+        
+        /// Scans the elements of a leaf for one closer to the target than the best found so far.
+        /// @tparam Filter A function that takes in an element and returns true if it qualifies for the search.
+        /// @param elements The elements of the leaf.
+        /// @param target The search position.
+        /// @param filter The filter to pass for an element to qualify.
+        /// @param bestDistanceSq The best squared distance found so far.
+        /// @param nearest The closest element if found, or empty.
+        /// @param stats The stats policy that records the work done by the search.
+        template<typename Filter, typename Stats>
+        static void FindNearestInLeaf(const std::vector<Element>& elements, const Vec2& target, Filter& filter, Distance& bestDistanceSq, std::optional<Element>& nearest, Stats& stats)
+        {
+            stats.OnLeafScanned();
+            stats.OnElementsTested(elements.size());
+            for (const auto& element : elements)
+            {
+                Distance distanceSq = GetDistanceSq(target, element.position);
+                if (distanceSq < bestDistanceSq && Passes(filter, element, stats))
+                {
+                    bestDistanceSq = distanceSq;
+                    nearest = element;
+                }
+            }
+        }
+        
+        /// Scans the elements of a leaf for the ones within a search area.
+        /// @tparam Filter A function that takes in an element and returns true if it qualifies for the search.
+        /// @param elements The elements of the leaf.
+        /// @param searchArea The area to search within.
+        /// @param filter The filter to pass for an element to qualify.
+        /// @param foundElements The collection of elements found by the search.
+        /// @param stats The stats policy that records the work done by the search.
+        template<typename Filter, typename Stats>
+        static void FindAllInLeaf(const std::vector<Element>& elements, const Bounds& searchArea, Filter& filter, std::vector<Element>& foundElements, Stats& stats)
+        {
+            stats.OnLeafScanned();
+            stats.OnElementsTested(elements.size());
+            if constexpr (std::is_same_v<Filter, NoFilter> && std::is_trivially_copyable_v<Element> && std::is_default_constructible_v<Element>)
+            {
+                // Write every element and only advance past the ones inside the area, which avoids a branch per element.
+                size_t size = foundElements.size();
+                foundElements.resize(size + elements.size());
+                for (const auto& element : elements)
+                {
+                    foundElements[size] = element;
+                    size += ContainsBranchless(searchArea, element.position);
+                }
+                foundElements.resize(size);
+            }
+            else
+            {
+                for (const auto& element : elements)
+                {
+                    if (searchArea.Contains(element.position) && Passes(filter, element, stats))
+                    {
+                        foundElements.push_back(element);
+                    }
+                }
+            }
+        }
+    
+    private:
+        /// How many levels of quadrant indices fit in a Z-order key.
+        static constexpr int MortonLevels = 32;
+        
+        /// Calculates where the quadrant index of a level is stored within a Z-order key.
+        /// @param level The level relative to the node the key was calculated from.
+        /// @return The number of bits to shift the index by.
+        static constexpr int GetMortonShift(int level)
+        {
+            return 62 - (level * 2);
+        }
+        
+        /// Determines the index to the children array based on where the position belongs to.
+        /// @param position The position to check.
+        /// @return The index to the corresponding child.
+        int GetChildIndex(const Vec2& position) const
+        {
+            // Use a Z-order curve to map the children into a one-dimensional sequence.
+            // 0: Left-Top
+            // 1: Right-Top
+            // 2: Left-Bottom
+            // 3: Right-Bottom
+            return bounds.GetQuadrantIndex(position);
+        }
+        
+        /// Splits entries sorted by their Z-order keys into the groups that belong to each child.
+        /// @tparam Entry A pair made of a Z-order key and a pointer or iterator to an element.
+        /// @param first The first entry that belongs to this node.
+        /// @param last The end of the entries that belong to this node.
+        /// @param keyDepth The depth of the node that the Z-order keys were calculated from.
+        /// @return The boundaries of the four groups in Z-order, starting with the first entry and ending with the last one.
+        template<typename Entry>
+        std::array<Entry*, 5> GroupByChild(Entry* first, Entry* last, int keyDepth) const
+        {
+            // Keys only hold a limited number of levels, past which the entries are grouped by quadrant directly.
+            int level = depth - keyDepth;
+            auto getIndex = [&](const Entry& entry)
+            {
+                return level < MortonLevels ? static_cast<int>((entry.first >> GetMortonShift(level)) & 3) : GetChildIndex(entry.second->position);
+            };
+            
+            if (level >= MortonLevels)
+            {
+                std::sort(first, last, [&](const Entry& a, const Entry& b) { return getIndex(a) < getIndex(b); });
+            }
+            
+            std::array<Entry*, 5> groups;
+            groups[0] = first;
+            for (int index = 0; index < 4; ++index)
+            {
+                groups[index + 1] = std::partition_point(groups[index], last, [&](const Entry& entry) { return getIndex(entry) <= index; });
+            }
+            return groups;
+        }
+        
+        /// Calls a filter on an element, recording the call unless the filter lets every element through.
+        /// @tparam Filter A function that takes in an element and returns true if it qualifies for the search.
+        /// @param filter The filter to call.
+        /// @param element The element to check.
+        /// @param stats The stats policy that records filter calls.
+        /// @return True if the element passes the filter.
+        template<typename Filter, typename Stats>
+        static bool Passes(Filter& filter, const Element& element, Stats& stats)
+        {
+            if constexpr (!std::is_same_v<Filter, NoFilter>)
+            {
+                stats.OnFilterCalled();
+            }
+            return filter(element);
+        }
+        
+        /// Recursively collect all elements in this node and its children.
+        /// @tparam Filter A function that takes in an element and returns true if it qualifies for the search.
+        /// @param filter The filter to pass for an element to qualify.
+        /// @param allElements The collection where elements are accumulated.
+        /// @param stats The stats policy that records the work done by the search.
+        template<typename Filter, typename Stats>
+        void GetAllElements(Filter filter, std::vector<Element>& allElements, Stats& stats) const
+        {
+            stats.OnNodeVisited();
+            if (isLeaf)
+            {
+                stats.OnLeafScanned();
+                if constexpr (std::is_same_v<Filter, NoFilter>)
+                {
+                    allElements.insert(allElements.end(), elements.begin(), elements.end());
+                }
+                else
+                {
+                    for (const auto& element : elements)
+                    {
+                        if (Passes(filter, element, stats))
+                        {
+                            allElements.push_back(element);
+                        }
+                    }
+                }
+                return;
+            }
+            
+            for (const auto& child : *children)
+            {
+                child.GetAllElements(filter, allElements, stats);
+            }
+        }
+        
+        /// Divides this node into a branch by passing its elements into its children.
+        /// @param capacity The maximum number of elements a node can hold.
+        /// @param maxDepth The maximum depth a node can be from the root.
+        /// @param allocator The allocator that provides storage for the children.
+        /// @param stats The stats policy that records subdivisions.
+        /// @param tracker The function to call every time an element is placed in a child.
+        template<typename Allocator, typename Stats, typename Tracker>
+        void Subdivide(size_t capacity, int maxDepth, Allocator& allocator, Stats& stats, Tracker tracker)
+        {
+            stats.OnSubdivision();
+            CreateChildren(allocator);
+            
+            for (auto& element : elements)
+            {
+                int index = GetChildIndex(element.position);
+                (*children)[index].Insert(std::move(element.data), element.position, capacity, maxDepth, allocator, stats, tracker);
+            }
+            
+            elements.clear();
+        }
+        
+        /// Turns this leaf into a branch with four empty children.
+        /// @param allocator The allocator that provides storage for the children.
+        template<typename Allocator>
+        void CreateChildren(Allocator& allocator)
+        {
+            // The four children share one contiguous block to keep siblings close in memory.
+            int childDepth = depth + 1;
+            children = new (allocator.Allocate()) Children{Node(bounds.GetQuadrant(0), childDepth), Node(bounds.GetQuadrant(1), childDepth), Node(bounds.GetQuadrant(2), childDepth), Node(bounds.GetQuadrant(3), childDepth)};
+            isLeaf = false;
+        }
+        
+        /// Merges the children after one of them lost an element, or marks this branch for the next compaction when merging is deferred.
+        /// @param mergePolicy Controls when children are merged back.
+        /// @param allocator The allocator that reclaims the storage of the children.
+        /// @param stats The stats policy that records merges.
+        /// @param tracker The function to call every time a merge places an element in this node.
+        template<typename Allocator, typename Stats, typename Tracker = NoTracker>
+        void MergeAfterRemoval(const MergePolicy& mergePolicy, Allocator& allocator, Stats& stats, Tracker tracker = {})
+        {
+            if (mergePolicy.deferred)
+            {
+                isDirty = true;
+            }
+            else
+            {
+                TryMerge(mergePolicy.threshold, allocator, stats, tracker);
+            }
+        }
+        
+        /// Attempts to merge the children back into this node if their elements fit within the merge threshold.
+        /// @param mergeThreshold The largest number of elements the children can hold together for them to be merged.
+        /// @param allocator The allocator that reclaims the storage of the children.
+        /// @param stats The stats policy that records merges.
+        /// @param tracker The function to call every time an element is placed in this node.
+        template<typename Allocator, typename Stats, typename Tracker = NoTracker>
+        void TryMerge(size_t mergeThreshold, Allocator& allocator, Stats& stats, Tracker tracker = {})
+        {
+            for (const auto& child : *children)
+            {
+                if (!child.isLeaf)
+                {
+                    return;
+                }
+            }
+            
+            size_t elementCount = 0;
+            for (const auto& child : *children)
+            {
+                elementCount += child.elements.size();
+            }
+            
+            if (elementCount <= mergeThreshold)
+            {
+                stats.OnMerge();
+                elements.reserve(elementCount);
+                for (auto& child : *children)
+                {
+                    for (auto& element : child.elements)
+                    {
                         elements.push_back(std::move(element));
+                        tracker(*this, elements.size() - 1);
+                    }
+                }
+                
+                DestroyChildren(allocator);
+            }
+        }
+        
+        /// Recursively destroys the children of this branch and returns their storage, turning it into a leaf.
+        /// @param allocator The allocator that reclaims the storage of the children.
+        template<typename Allocator>
+        void DestroyChildren(Allocator& allocator)
+        {
+            for (auto& child : *children)
+            {
+                if (!child.isLeaf)
+                {
+                    child.DestroyChildren(allocator);
+                }
+            }
+            
+            std::destroy_at(children);
+            allocator.Deallocate(children);
+            children = nullptr;
+            isLeaf = true;
+            isDirty = false;
+        }
+    };
+    
+    /// A lazy sequence of the elements of a tree in order of their distance to a target, which only searches as far as it is iterated.
+    /// Nodes and elements wait in a priority queue keyed by their squared distance, so each step expands just the nodes closer than the next element.
+    /// The sequence is invalidated by any modification of the tree and must outlive its iterators.
+    /// @tparam T The type of data representing elements in the tree.
+    /// @tparam Vec2 The type of 2D vector to use.
+    template<typename T, typename Vec2>
+    class NearestRange
+    {
+    public:
+        using Element = QuadtreeElement<T, Vec2>;
+        using Distance = QuadtreeDetail::Distance<Vec2>;
+        
+        /// An input iterator that advances the search of its sequence by one element at a time.
+        class Iterator
+        {
+        public:
+            using iterator_category = std::input_iterator_tag;
+            using value_type = Element;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const Element*;
+            using reference = const Element&;
+            
+            /// Constructor for the end of every sequence.
+            Iterator() = default;
+            
+            /// Constructor that reads from the given sequence.
+            /// @param range The sequence to read from, or null for the end.
+            explicit Iterator(NearestRange* range) : mRange(range)
+            {
+            }
+            
+            /// Gets the current element.
+            /// @return The closest element that wasn't visited yet.
+            reference operator*() const
+            {
+                return *mRange->mCurrent;
+            }
+            
+            /// Accesses the current element.
+            /// @return A pointer to the closest element that wasn't visited yet.
+            pointer operator->() const
+            {
+                return mRange->mCurrent;
+            }
+            
+            /// Gets the squared distance from the target to the current element.
+            /// @return The squared distance, which never decreases as the iterator advances.
+            Distance GetDistanceSq() const
+            {
+                return mRange->mCurrentDistanceSq;
+            }
+            
+            /// Searches for the next closest element, becoming the end of the sequence once every element was visited.
+            /// @return A reference to this iterator.
+            Iterator& operator++()
+            {
+                if (!mRange->Advance())
+                {
+                    mRange = nullptr;
+                }
+                return *this;
+            }
+            
+            /// Checks if two iterators are at the same point of a sequence.
+            /// @param other The iterator to compare with.
+            /// @return True if both iterators read from the same sequence or both are at the end.
+            bool operator==(const Iterator& other) const
+            {
+                return mRange == other.mRange;
+            }
+            
+            /// Checks if two iterators are at different points of a sequence.
+            /// @param other The iterator to compare with.
+            /// @return True if the iterators read from different sequences or only one of them is at the end.
+            bool operator!=(const Iterator& other) const
+            {
+                return mRange != other.mRange;
+            }
+            
+        private:
+            /// The sequence being read, which is null once its elements run out.
+            NearestRange* mRange = nullptr;
+        };
+        
+        /// Constructor that starts a search from the root of a tree and finds its closest element.
+        /// @param root The root of the tree to search.
+        /// @param target The position to measure distances from.
+        NearestRange(const Node<T, Vec2>& root, const Vec2& target) : mTarget(target)
+        {
+            if (root.count > 0)
+            {
+                mCandidates.reserve(InitialCapacity);
+                mCandidates.push_back({root.bounds.GetDistanceSq(target), &root, nullptr});
+            }
+            Advance();
+        }
+        
+        /// Copying is deleted since iterators point back to the sequence they read from.
+        NearestRange(const NearestRange&) = delete;
+        
+        /// Gets an iterator to the closest element that wasn't visited yet.
+        /// @return The iterator, which is the end of the sequence if every element was visited.
+        Iterator begin()
+        {
+            return Iterator(mCurrent ? this : nullptr);
+        }
+        
+        /// Gets the end of the sequence.
+        /// @return The iterator reached once every element was visited.
+        Iterator end()
+        {
+            return Iterator();
+        }
+        
+        /// Copy assignment is deleted since iterators point back to the sequence they read from.
+        NearestRange& operator=(const NearestRange&) = delete;
+        
+    private:
+        /// How many candidates the queue has room for before its first reallocation, which covers a few full leaves.
+        static constexpr size_t InitialCapacity = 64;
+        
+        /// A node or element waiting to be visited, keyed by its squared distance to the target.
+        struct Candidate
+        {
+            Distance distanceSq;
+            const Node<T, Vec2>* node;
+            const Element* element;
+        };
+        
+        /// Orders the queue so that the closest candidate is on top and elements are visited before nodes at the same distance.
+        /// @param a The first candidate.
+        /// @param b The second candidate.
+        /// @return True if the first candidate should be visited after the second one.
+        static bool IsFarther(const Candidate& a, const Candidate& b)
+        {
+            return a.distanceSq > b.distanceSq || (a.distanceSq == b.distanceSq && !a.element && b.element);
+        }
+        
+        /// Expands the closest nodes until an element is closer than every node left in the queue.
+        /// @return True if an element was found, false if every element was visited.
+        bool Advance()
+        {
+            mCurrent = nullptr;
+            while (!mCandidates.empty())
+            {
+                std::pop_heap(mCandidates.begin(), mCandidates.end(), IsFarther);
+                Candidate candidate = mCandidates.back();
+                mCandidates.pop_back();
+                
+                if (candidate.element)
+                {
+                    mCurrent = candidate.element;
+                    mCurrentDistanceSq = candidate.distanceSq;
+                    return true;
+                }
+                
+                const Node<T, Vec2>& node = *candidate.node;
+                if (node.isLeaf)
+                {
+                    for (const auto& element : node.elements)
+                    {
+                        Push({GetDistanceSq(mTarget, element.position), nullptr, &element});
+                    }
+                    continue;
+                }
+                
+                for (const auto& child : *node.children)
+                {
+                    if (child.count > 0)
+                    {
+                        Push({child.bounds.GetDistanceSq(mTarget), &child, nullptr});
+                    }
+                }
+            }
+            return false;
+        }
+        
+        /// Adds a candidate to the queue.
+        /// @param candidate The node or element to visit later.
+        void Push(const Candidate& candidate)
+        {
+            mCandidates.push_back(candidate);
+            std::push_heap(mCandidates.begin(), mCandidates.end(), IsFarther);
+        }
+        
+        /// The position that distances are measured from.
+        Vec2 mTarget;
+        
+        /// A min-heap of the nodes and elements waiting to be visited.
+        std::vector<Candidate> mCandidates;
+        
+        /// The closest element that wasn't visited yet, or null once every element was visited.
+        const Element* mCurrent = nullptr;
+        
+        /// The squared distance from the target to the current element.
+        Distance mCurrentDistanceSq = Distance(0);
+    };
+}
+
+class QuadtreeSnapshot;
+
+/// An immutable snapshot of a Quadtree that stores its nodes and elements in contiguous arrays for faster searches.
+/// @tparam T The type of data representing elements in the tree.
+/// @tparam Vec2 The type of 2D vector to use.
+template<typename T, typename Vec2>
+class FrozenQuadtree
+{
+public:
+    using Element = QuadtreeElement<T, Vec2>;
+    using Scalar = QuadtreeDetail::Scalar<Vec2>;
+    
+    /// Construct a snapshot from the root of a tree, which is usually done through Quadtree::Freeze.
+    /// @param root The root node of the tree to copy.
+    explicit FrozenQuadtree(const QuadtreeDetail::Node<T, Vec2>& root)
+    {
+        // Lay out the nodes breadth-first so that the four children of a branch are always next to each other.
+        std::vector<const SourceNode*> sourceNodes = {&root};
+        mNodeStorage.push_back({root.bounds, 0, 0, 0, 0});
+        for (size_t index = 0; index < sourceNodes.size(); ++index)
+        {
+            const SourceNode* source = sourceNodes[index];
+            if (source->isLeaf)
+            {
+                continue;
+            }
+            
+            mNodeStorage[index].firstChild = static_cast<uint32_t>(mNodeStorage.size());
+            for (const auto& child : *source->children)
+            {
+                sourceNodes.push_back(&child);
+                mNodeStorage.push_back({child.bounds, 0, 0, 0, 0});
+            }
+        }
+        
+        mElementStorage.reserve(root.CountElements());
+        mHeight = PackElements(0, root);
+        PointAtStorage();
+    }
+    
+    /// Copy constructor that points the copy at its own arrays, or shares the mapped file the other snapshot reads from.
+    /// @param other The snapshot to copy.
+    FrozenQuadtree(const FrozenQuadtree& other) : mNodeStorage(other.mNodeStorage), mElementStorage(other.mElementStorage), mPositionXStorage(other.mPositionXStorage), mPositionYStorage(other.mPositionYStorage), mMapping(other.mMapping)
+    {
+        CopyViews(other);
+    }
+    
+    /// Move constructor that takes over the arrays of the other snapshot, which keep their addresses when transferred.
+    FrozenQuadtree(FrozenQuadtree&& other) = default;
+    
+    /// Calculates the height of the tree from its deepest branch.
+    /// @return The height of the tree.
+    size_t GetHeight() const
+    {
+        return mHeight;
+    }
+    
+    /// Counts the total number of elements in the tree.
+    /// @return The total number of elements.
+    size_t CountElements() const
+    {
+        return mElementCount;
+    }
+    
+    /// Finds the closest element to the target position that passes a filter.
+    /// @tparam Filter A function that takes in an element and returns true if it qualifies for the search.
+    /// @param target The position to search around.
+    /// @param filter The filter to pass for an element to qualify.
+    /// @param maxRadius The maximum distance from the target to consider.
+    /// @return The closest element if found, or empty.
+    template<typename Filter>
+    std::optional<Element> FindNearest(const Vec2& target, Filter filter, Scalar maxRadius = std::numeric_limits<Scalar>::max()) const
+    {
+        const Element* nearest = nullptr;
+        Distance bestDistanceSq = QuadtreeDetail::GetRadiusSq<Vec2>(maxRadius);
+        FindNearest(0, target, filter, bestDistanceSq, nearest);
+        
+        if (nearest)
+        {
+            return *nearest;
+        }
+        
+        return std::nullopt;
+    }
+    
+    /// Finds the closest element to the target position.
+    /// @param target The position to search around.
+    /// @param maxRadius The maximum distance from the target to consider.
+    /// @return The closest element if found, or empty.
+    std::optional<Element> FindNearest(const Vec2& target, Scalar maxRadius = std::numeric_limits<Scalar>::max()) const
+    {
+        return FindNearest(target, QuadtreeDetail::NoFilter{}, maxRadius);
+    }
+    
+    /// Finds elements within the region that pass a filter.
+    /// @tparam Filter A function that takes in an element and returns true if it qualifies for the search.
+    /// @param min The minimum point describing the search area.
+    /// @param max The maximum point describing the search area.
+    /// @param filter The filter to pass for an element to qualify.
+    /// @return The collection of elements found within the region.
+    template<typename Filter>
+    std::vector<Element> FindAll(const Vec2& min, const Vec2& max, Filter filter) const
+    {
+        std::vector<Element> foundElements;
+        
+        QuadtreeDetail::Bounds searchArea(min, max);
+        if (mNodes[0].bounds.Intersects(searchArea))
+        {
+            FindAll(0, searchArea, filter, foundElements);
+        }
+        
+        return foundElements;
+    }
+    
+    /// Finds elements within the search area.
+    /// @param min The minimum point describing the search area.
+    /// @param max The maximum point describing the search area.
+    /// @return The collection of elements found within the region.
+    std::vector<Element> FindAll(const Vec2& min, const Vec2& max) const
+    {
+        return FindAll(min, max, QuadtreeDetail::NoFilter{});
+    }
+    
+    /// Copy assignment that points this snapshot at its own copy of the arrays, or shares the mapped file the other snapshot reads from.
+    /// @param other The snapshot to copy.
+    /// @return A reference to this snapshot.
+    FrozenQuadtree& operator=(const FrozenQuadtree& other)
+    {
+        if (this != &other)
+        {
+            mNodeStorage = other.mNodeStorage;
+            mElementStorage = other.mElementStorage;
+            mPositionXStorage = other.mPositionXStorage;
+            mPositionYStorage = other.mPositionYStorage;
+            mMapping = other.mMapping;
+            CopyViews(other);
+        }
+        return *this;
+    }
+    
+    /// Move assignment that takes over the arrays of the other snapshot, which keep their addresses when transferred.
+    FrozenQuadtree& operator=(FrozenQuadtree&& other) = default;
+    
+private:
+    friend class QuadtreeSnapshot;
+    
+    using SourceNode = QuadtreeDetail::Node<T, Vec2>;
+    using Bounds = QuadtreeDetail::Bounds<Vec2>;
+    using Distance = QuadtreeDetail::Distance<Vec2>;
+    
+    /// A node that refers to its children and elements by index instead of by pointer.
+    struct Node
+    {
+        /// Defines the area covered by this node.
+        Bounds bounds;
+        
+        /// Index of the first of the four consecutive children in Z-order, or zero if the node is a leaf.
+        uint32_t firstChild;
+        
+        /// Index of the first element stored within this node or any of its descendants.
+        uint32_t elementOffset;
+        
+        /// How many elements are stored within this node and all of its descendants.
+        uint32_t elementCount;
+        
+        /// Index of the first coordinate of a leaf within the padded coordinate arrays.
+        uint32_t positionOffset;
+        
+        /// Indicates if this node is an endpoint with no children.
+        bool IsLeaf() const
+        {
+            return firstChild == 0;
+        }
+    };
+    
+    /// Construct a snapshot that searches arrays it doesn't own, which is how QuadtreeSnapshot::LoadMapped serves a file without copying it.
+    /// @param mapping Keeps the memory holding the arrays alive for as long as the snapshot or its copies exist.
+    /// @param nodes The nodes laid out breadth-first.
+    /// @param nodeCount How many nodes there are.
+    /// @param elements The elements laid out depth-first.
+    /// @param elementCount How many elements there are.
+    /// @param positionsX The padded horizontal coordinates of every leaf.
+    /// @param positionsY The padded vertical coordinates of every leaf.
+    /// @param positionCount How many coordinates, including padding, each coordinate array has.
+    /// @param height The height of the tree from its deepest branch.
+    FrozenQuadtree(std::shared_ptr<const void> mapping, const Node* nodes, size_t nodeCount, const Element* elements, size_t elementCount, const Scalar* positionsX, const Scalar* positionsY, size_t positionCount, size_t height) : mMapping(std::move(mapping)), mNodes(nodes), mElements(elements), mPositionsX(positionsX), mPositionsY(positionsY), mNodeCount(nodeCount), mElementCount(elementCount), mPositionCount(positionCount), mHeight(height)
+    {
+    }
+    
+    /// Copies the elements of a node in depth-first order so every subtree owns a contiguous range of elements.
+    /// @param index The index of the node receiving the elements.
+    /// @param source The node to copy the elements from.
+    /// @return The height of the node.
+    size_t PackElements(uint32_t index, const SourceNode& source)
+    {
+        size_t height = 0;
+        mNodeStorage[index].elementOffset = static_cast<uint32_t>(mElementStorage.size());
+        
+        if (source.isLeaf)
+        {
+            mElementStorage.insert(mElementStorage.end(), source.elements.begin(), source.elements.end());
+            
+            // Store the coordinates of each leaf separately and pad them so the SIMD kernels can read whole blocks.
+            mNodeStorage[index].positionOffset = static_cast<uint32_t>(mPositionXStorage.size());
+            for (const auto& element : source.elements)
+            {
+                mPositionXStorage.push_back(element.position.x);
+                mPositionYStorage.push_back(element.position.y);
+            }
+            
+            // Integer padding stays at zero so the masked-off lanes can't overflow when their distances are squared.
+            Scalar padding = std::is_floating_point_v<Scalar> ? std::numeric_limits<Scalar>::max() : Scalar{};
+            size_t paddedSize = (mPositionXStorage.size() + QuadtreeDetail::SimdWidth - 1) / QuadtreeDetail::SimdWidth * QuadtreeDetail::SimdWidth;
+            mPositionXStorage.resize(paddedSize, padding);
+            mPositionYStorage.resize(paddedSize, padding);
+        }
+        else
+        {
+            uint32_t childIndex = mNodeStorage[index].firstChild;
+            for (const auto& child : *source.children)
+            {
+                height = std::max(PackElements(childIndex++, child), height);
+            }
+        }
+        
+        mNodeStorage[index].elementCount = static_cast<uint32_t>(mElementStorage.size()) - mNodeStorage[index].elementOffset;
+        return height + 1;
+    }
+    
+    /// Recursive helper for finding the nearest element.
+    /// @tparam Filter A function that takes in an element and returns true if it qualifies for the search.
+    /// @param index The index of the node to search.
+    /// @param target The search position.
+    /// @param filter The filter to pass for an element to qualify.
+    /// @param bestDistanceSq The best squared distance found so far.
+    /// @param nearest The closest element if found, or null.
+    template<typename Filter>
+    void FindNearest(uint32_t index, const Vec2& target, Filter& filter, Distance& bestDistanceSq, const Element*& nearest) const
+    {
+        const Node& node = mNodes[index];
+        if (node.IsLeaf())
+        {
+            // Calculate the distances of a whole block at once and only filter the positions that beat the best distance.
+            const Element* elements = mElements + node.elementOffset;
+            const Scalar* x = mPositionsX + node.positionOffset;
+            const Scalar* y = mPositionsY + node.positionOffset;
+            std::array<Distance, QuadtreeDetail::SimdWidth> distancesSq;
+            
+            for (uint32_t block = 0; block < node.elementCount; block += QuadtreeDetail::SimdWidth)
+            {
+                uint32_t mask = QuadtreeDetail::FindCloserPositions(x + block, y + block, target.x, target.y, bestDistanceSq, distancesSq.data());
+                mask &= QuadtreeDetail::GetLaneMask(node.elementCount - block);
+                while (mask != 0)
+                {
+                    int lane = QuadtreeDetail::CountTrailingZeros(mask);
+                    mask &= mask - 1;
+                    
+                    const Element& element = elements[block + lane];
+                    if (distancesSq[lane] < bestDistanceSq && filter(element))
+                    {
+                        bestDistanceSq = distancesSq[lane];
+                        nearest = &element;
                     }
                 }
-                
-                for (auto& child : children)
+            }
+            return;
+        }
+        
+        // Bias the search toward the quadrant that contains the target.
+        for (int childOffset : node.bounds.GetSearchOrder(target))
+        {
+            uint32_t childIndex = node.firstChild + childOffset;
+            if (mNodes[childIndex].bounds.GetDistanceSq(target) < bestDistanceSq)
+            {
+                FindNearest(childIndex, target, filter, bestDistanceSq, nearest);
+            }
+        }
+    }
+    
+    /// Recursive helper for finding all elements within a search area.
+    /// @tparam Filter A function that takes in an element and returns true if it qualifies for the search.
+    /// @param index The index of the node to search.
+    /// @param searchArea The area to search within.
+    /// @param filter The filter to pass for an element to qualify.
+    /// @param foundElements The collection of elements found by the search.
+    template<typename Filter>
+    void FindAll(uint32_t index, const Bounds& searchArea, Filter& filter, std::vector<Element>& foundElements) const
+    {
+        const Node& node = mNodes[index];
+        const Element* begin = mElements + node.elementOffset;
+        auto end = begin + node.elementCount;
+        
+        if (searchArea.Contains(node.bounds))
+        {
+            // The elements of the whole subtree are contiguous, so they can be copied at once.
+            if constexpr (std::is_same_v<Filter, QuadtreeDetail::NoFilter>)
+            {
+                foundElements.insert(foundElements.end(), begin, end);
+            }
+            else
+            {
+                std::copy_if(begin, end, std::back_inserter(foundElements), filter);
+            }
+            return;
+        }
+        
+        if (node.IsLeaf())
+        {
+            // Test a whole block of positions at once and only visit the elements inside the area.
+            const Scalar* x = mPositionsX + node.positionOffset;
+            const Scalar* y = mPositionsY + node.positionOffset;
+            if constexpr (std::is_same_v<Filter, QuadtreeDetail::NoFilter> && std::is_trivially_copyable_v<Element> && std::is_default_constructible_v<Element>)
+            {
+                // Compact the matches by writing every element and only advancing past the ones selected by the mask.
+                size_t size = foundElements.size();
+                foundElements.resize(size + node.elementCount);
+                for (uint32_t block = 0; block < node.elementCount; block += QuadtreeDetail::SimdWidth)
                 {
-                    child.reset();
+                    uint32_t mask = QuadtreeDetail::FindContainedPositions(x + block, y + block, searchArea.min.x, searchArea.min.y, searchArea.max.x, searchArea.max.y);
+                    uint32_t laneCount = std::min<uint32_t>(node.elementCount - block, QuadtreeDetail::SimdWidth);
+                    for (uint32_t lane = 0; lane < laneCount; ++lane)
+                    {
+                        foundElements[size] = begin[block + lane];
+                        size += (mask >> lane) & 1;
+                    }
+                }
+                foundElements.resize(size);
+                return;
+            }
+            
+            for (uint32_t block = 0; block < node.elementCount; block += QuadtreeDetail::SimdWidth)
+            {
+                uint32_t mask = QuadtreeDetail::FindContainedPositions(x + block, y + block, searchArea.min.x, searchArea.min.y, searchArea.max.x, searchArea.max.y);
+                mask &= QuadtreeDetail::GetLaneMask(node.elementCount - block);
+                while (mask != 0)
+                {
+                    int lane = QuadtreeDetail::CountTrailingZeros(mask);
+                    mask &= mask - 1;
+                    
+                    const Element& element = begin[block + lane];
+                    if (filter(element))
+                    {
+                        foundElements.push_back(element);
+                    }
                 }
-                
-                isLeaf = true;
             }
+            return;
         }
-    };
-}
+        
+        for (uint32_t childIndex = node.firstChild; childIndex < node.firstChild + 4; ++childIndex)
+        {
+            if (mNodes[childIndex].bounds.Intersects(searchArea))
+            {
+                FindAll(childIndex, searchArea, filter, foundElements);
+            }
+        }
+    }
+    
+    /// Points the views at the arrays owned by this snapshot.
+    void PointAtStorage()
+    {
+        mNodes = mNodeStorage.data();
+        mElements = mElementStorage.data();
+        mPositionsX = mPositionXStorage.data();
+        mPositionsY = mPositionYStorage.data();
+        mNodeCount = mNodeStorage.size();
+        mElementCount = mElementStorage.size();
+        mPositionCount = mPositionXStorage.size();
+    }
+    
+    /// Copies the views of another snapshot, pointing them at this snapshot's own arrays unless both read from the same mapped file.
+    /// @param other The snapshot whose views to copy.
+    void CopyViews(const FrozenQuadtree& other)
+    {
+        mHeight = other.mHeight;
+        if (mMapping)
+        {
+            mNodes = other.mNodes;
+            mElements = other.mElements;
+            mPositionsX = other.mPositionsX;
+            mPositionsY = other.mPositionsY;
+            mNodeCount = other.mNodeCount;
+            mElementCount = other.mElementCount;
+            mPositionCount = other.mPositionCount;
+        }
+        else
+        {
+            PointAtStorage();
+        }
+    }
+    
+    /// The nodes of the tree laid out breadth-first, with the root at index zero, when the snapshot owns them.
+    std::vector<Node> mNodeStorage;
+    
+    /// The elements of the tree laid out depth-first in Z-order, when the snapshot owns them.
+    std::vector<Element> mElementStorage;
+    
+    /// The horizontal coordinates of the elements in every leaf, padded to a multiple of the SIMD width, when the snapshot owns them.
+    std::vector<Scalar> mPositionXStorage;
+    
+    /// The vertical coordinates of the elements in every leaf, padded to a multiple of the SIMD width, when the snapshot owns them.
+    std::vector<Scalar> mPositionYStorage;
+    
+    /// Keeps the file that the views point into mapped, shared between copies of the snapshot.
+    std::shared_ptr<const void> mMapping;
+    
+    /// The nodes that searches run on, which live either in the storage above or in a mapped file.
+    const Node* mNodes = nullptr;
+    
+    /// The elements that searches return.
+    const Element* mElements = nullptr;
+    
+    /// The horizontal coordinates that searches test.
+    const Scalar* mPositionsX = nullptr;
+    
+    /// The vertical coordinates that searches test.
+    const Scalar* mPositionsY = nullptr;
+    
+    /// How many nodes the tree has.
+    size_t mNodeCount = 0;
+    
+    /// How many elements the tree has.
+    size_t mElementCount = 0;
+    
+    /// How many coordinates, including padding, each coordinate array has.
+    size_t mPositionCount = 0;
+    
+    /// The height of the tree from its deepest branch.
+    size_t mHeight = 0;
+};
 
 /// A data structure that partitions a two-dimensional space into quadrants and provides efficient spatial queries.
 /// @tparam T The type of data representing elements in the tree.
 /// @tparam Vec2 The type of 2D vector to use.
-template<typename T, typename Vec2>
+/// @tparam Allocator The policy used to allocate blocks of child nodes.
+/// @tparam Stats The policy that counts the work done by searches and modifications, where QuadtreeStats makes the searches unsafe to run from several threads at once outside of the batch searches.
+template<typename T, typename Vec2, template<typename> class Allocator = QuadtreePoolAllocator, typename Stats = QuadtreeNoStats>
 class Quadtree
 {
 public:
     using Element = QuadtreeElement<T, Vec2>;
+    using Frozen = FrozenQuadtree<T, Vec2>;
+    using Scalar = QuadtreeDetail::Scalar<Vec2>;
     
     /// Construct a Quadtree that covers the given bounds.
     /// @param min The minimum point describing the area covered by the tree.
     /// @param max The maximum point describing the area covered by the tree.
     /// @param nodeCapacity The maximum number of elements that a node within the tree can store before subdividing.
     /// @param maxDepth The maximum depth the tree can have from its root to the furthest leaf.
-    Quadtree(const Vec2& min, const Vec2& max, size_t nodeCapacity = 8, int maxDepth = 4) : mRoot({min, max}, 0), mNodeCapacity(nodeCapacity), mMaxDepth(maxDepth)
+    Quadtree(const Vec2& min, const Vec2& max, size_t nodeCapacity = 8, int maxDepth = 4) : mRoot({min, max}, 0), mNodeCapacity(nodeCapacity), mMaxDepth(maxDepth), mMergePolicy{nodeCapacity}
+    {
+    }
+    
+    /// Construct a Quadtree that covers the given bounds and fill it with a range of elements.
+    /// @tparam Iterator A forward iterator to elements of the tree's type, which are copied into the tree unless it's wrapped with std::make_move_iterator.
+    /// @param min The minimum point describing the area covered by the tree.
+    /// @param max The maximum point describing the area covered by the tree.
+    /// @param first The first element to insert.
+    /// @param last The end of the elements to insert.
+    /// @param nodeCapacity The maximum number of elements that a node within the tree can store before subdividing.
+    /// @param maxDepth The maximum depth the tree can have from its root to the furthest leaf.
+    template<typename Iterator, typename = typename std::iterator_traits<Iterator>::iterator_category>
+    Quadtree(const Vec2& min, const Vec2& max, Iterator first, Iterator last, size_t nodeCapacity = 8, int maxDepth = 4) : Quadtree(min, max, nodeCapacity, maxDepth)
     {
+        Build(first, last);
     }
     
     /// Copy constructor is deleted to avoid accidental copies.
@@ -455,6 +2958,12 @@ public:
     /// Move constructor is defaulted to allow efficient transfer of ownership.
     Quadtree(Quadtree&& other) = default;
     
+    /// Destructor that releases every node back to the allocator.
+    ~Quadtree()
+    {
+        mRoot.Clear(mAllocator);
+    }
+    
     /// Calculates the height of the tree from its deepest branch.
     /// @return The height of the tree.
     size_t GetHeight() const
@@ -466,35 +2975,425 @@ public:
     /// @return The total number of elements.
     size_t CountElements() const
     {
-        return mRoot.CountElements();
+        return mRoot.CountElements();
+    }
+    
+    /// Walks the tree once to report its shape and the memory it uses, which helps choose a node capacity and maximum depth.
+    /// @return The report of the tree's current structure.
+    QuadtreeStructureStats GetStats() const
+    {
+        QuadtreeStructureStats stats;
+        stats.nodeBytes = sizeof(Node);
+        mRoot.AddStructureStats(stats);
+        return stats;
+    }
+    
+    /// Gets the maximum number of elements that a node can store before subdividing.
+    /// @return The node capacity.
+    size_t GetNodeCapacity() const
+    {
+        return mNodeCapacity;
+    }
+    
+    /// Gets the maximum depth the tree can have from its root to the furthest leaf, which increases when the tree grows.
+    /// @return The maximum depth.
+    int GetMaxDepth() const
+    {
+        return mMaxDepth;
+    }
+    
+    /// Gets the minimum point of the area currently covered by the tree.
+    /// @return The minimum point, which moves when the tree grows or shrinks.
+    const Vec2& GetMin() const
+    {
+        return mRoot.bounds.min;
+    }
+    
+    /// Gets the maximum point of the area currently covered by the tree.
+    /// @return The maximum point, which moves when the tree grows or shrinks.
+    const Vec2& GetMax() const
+    {
+        return mRoot.bounds.max;
+    }
+    
+    /// Gets the work counted by the stats policy since the tree was created or the counters were last reset.
+    /// @return The counters, which are always zero when the tree uses QuadtreeNoStats.
+    QuadtreeCounters GetCounters() const
+    {
+        return mCounters.GetCounters();
+    }
+    
+    /// Gets the work counted by the stats policy during the most recent search, or the most recent batch of searches.
+    /// @return The counters, which are always zero when the tree uses QuadtreeNoStats.
+    QuadtreeCounters GetLastQueryCounters() const
+    {
+        return mLastQueryCounters.GetCounters();
+    }
+    
+    /// Sets every counter of the stats policy back to zero.
+    void ResetCounters()
+    {
+        mCounters = {};
+        mLastQueryCounters = {};
+    }
+    
+    /// Enables growing the tree to cover positions outside of its bounds instead of rejecting them.
+    /// Each growth step doubles the area toward the position, keeps the current root as one of the new quadrants and allows one more level of depth, so leaves keep their size.
+    /// @param autoGrow True to grow the tree when needed.
+    void SetAutoGrow(bool autoGrow)
+    {
+        mAutoGrow = autoGrow;
+    }
+    
+    /// Enables shrinking the tree back toward the bounds it was constructed with once removals leave the rest of its area empty.
+    /// @param autoShrink True to shrink the tree after elements are removed.
+    void SetAutoShrink(bool autoShrink)
+    {
+        mAutoShrink = autoShrink;
+        if (mAutoShrink)
+        {
+            Shrink();
+        }
+    }
+    
+    /// Sets how many elements the children of a branch can hold together before they are merged back into it, which defaults to the node capacity.
+    /// A threshold below the node capacity keeps elements that move back and forth across it from repeatedly subdividing and merging the same node.
+    /// @param mergeThreshold The largest number of elements the children can hold together for them to be merged.
+    void SetMergeThreshold(size_t mergeThreshold)
+    {
+        mMergePolicy.threshold = mergeThreshold;
+    }
+    
+    /// Enables deferring merges until Compact is called, so removals only mark the branches that lost elements.
+    /// @param lazyMerge True to defer merges, false to merge on every removal again, which compacts the tree right away.
+    void SetLazyMerge(bool lazyMerge)
+    {
+        mMergePolicy.deferred = lazyMerge;
+        if (!lazyMerge)
+        {
+            Compact();
+        }
+    }
+    
+    /// Merges every subtree that lost elements since the last compaction and now fits within the merge threshold, in a single pass.
+    void Compact()
+    {
+        mRoot.Compact(mMergePolicy.threshold, mAllocator, mCounters);
+        
+        if (mAutoShrink)
+        {
+            Shrink();
+        }
+    }
+    
+    /// Inserts a new element with the given data and position.
+    /// @param data The data representing the element.
+    /// @param position The position where the element is.
+    /// @return True if the element was successfully inserted, false if it's outside the tree and growing is disabled.
+    bool Insert(T data, const Vec2& position)
+    {
+        if (!mRoot.bounds.Contains(position) && !(mAutoGrow && Grow(position)))
+        {
+            return false;
+        }
+        
+        return mRoot.Insert(std::move(data), position, mNodeCapacity, mMaxDepth, mAllocator, mCounters);
+    }
+    
+    /// Replaces the contents of the tree with a range of elements, building every node at once instead of inserting one element at a time.
+    /// @tparam Iterator A forward iterator to elements of the tree's type, which are copied into the tree unless it's wrapped with std::make_move_iterator.
+    /// @param first The first element to insert.
+    /// @param last The end of the elements to insert.
+    /// @return The number of elements inserted, which excludes any that are outside the tree's bounds.
+    template<typename Iterator>
+    size_t Build(Iterator first, Iterator last)
+    {
+        Clear();
+        
+        // Grow before calculating any key, since the keys depend on the final bounds of the root.
+        if (mAutoGrow)
+        {
+            for (auto it = first; it != last; ++it)
+            {
+                Grow(it->position);
+            }
+        }
+        
+        // Sorting by Z-order key groups the elements of every node together, so each element is moved only once.
+        auto entries = SortBatch(first, last);
+        mRoot.Build(entries.data(), entries.data() + entries.size(), mRoot.depth, mNodeCapacity, mMaxDepth, mAllocator);
+        return entries.size();
+    }
+    
+    /// Inserts a range of elements, grouping them by quadrant on the way down so each leaf receives its group at once and each node subdivides at most once.
+    /// @tparam Iterator A forward iterator to elements of the tree's type, which are copied into the tree unless it's wrapped with std::make_move_iterator.
+    /// @param first The first element to insert.
+    /// @param last The end of the elements to insert.
+    /// @return The number of elements inserted, which excludes any that are outside the tree and can't be grown toward.
+    template<typename Iterator>
+    size_t InsertBatch(Iterator first, Iterator last)
+    {
+        // Grow before calculating any key, since the keys depend on the final bounds of the root.
+        if (mAutoGrow)
+        {
+            for (auto it = first; it != last; ++it)
+            {
+                Grow(it->position);
+            }
+        }
+        
+        auto entries = SortBatch(first, last);
+        if (!entries.empty())
+        {
+            mRoot.InsertBatch(entries.data(), entries.data() + entries.size(), mRoot.depth, mNodeCapacity, mMaxDepth, mAllocator, mCounters);
+        }
+        
+        return entries.size();
+    }
+    
+    /// Removes the elements matching the data and positions of a range, grouping them by quadrant on the way down so each branch merges at most once.
+    /// @tparam Iterator A forward iterator to elements of the tree's type.
+    /// @param first The first element to remove.
+    /// @param last The end of the elements to remove.
+    /// @return The number of elements removed.
+    template<typename Iterator>
+    size_t RemoveBatch(Iterator first, Iterator last)
+    {
+        auto entries = SortBatch(first, last);
+        
+        size_t removedCount = 0;
+        if (!entries.empty())
+        {
+            removedCount = mRoot.RemoveBatch(entries.data(), entries.data() + entries.size(), mRoot.depth, mMergePolicy, mAllocator, mCounters);
+        }
+        
+        if (removedCount > 0 && mAutoShrink)
+        {
+            Shrink();
+        }
+        
+        return removedCount;
+    }
+    
+    /// Removes an element matching the given data and position.
+    /// @param data The data representing the element.
+    /// @param position The position where the element is.
+    /// @return True if the element was successfully removed.
+    bool Remove(const T& data, const Vec2& position)
+    {
+        if (!mRoot.bounds.Contains(position))
+        {
+            return false;
+        }
+        
+        if (!mRoot.Remove(data, position, mMergePolicy, mAllocator, mCounters))
+        {
+            return false;
+        }
+        
+        if (mAutoShrink)
+        {
+            Shrink();
+        }
+        
+        return true;
+    }
+    
+    /// Visits the elements within the search area without copying them.
+    /// @tparam Visitor A function that takes in an element and returns false to stop the traversal.
+    /// @param min The minimum point describing the search area.
+    /// @param max The maximum point describing the search area.
+    /// @param visitor The function to call with every element found.
+    /// @return False if the visitor stopped the traversal early, true otherwise.
+    template<typename Visitor>
+    bool ForEachInArea(const Vec2& min, const Vec2& max, Visitor visitor) const
+    {
+        QuadtreeDetail::Bounds searchArea(min, max);
+        if (mRoot.bounds.Intersects(searchArea))
+        {
+            return mRoot.ForEachInArea(searchArea, visitor);
+        }
+        
+        return true;
+    }
+    
+    /// Finds elements within the region that pass a filter and writes them to an output iterator.
+    /// @tparam OutputIt An output iterator that accepts elements.
+    /// @tparam Filter A function that takes in an element and returns true if it qualifies for the search.
+    /// @param min The minimum point describing the search area.
+    /// @param max The maximum point describing the search area.
+    /// @param out The iterator to write the elements found to.
+    /// @param filter The filter to pass for an element to qualify.
+    /// @return The output iterator past the last element written.
+    template<typename OutputIt, typename Filter>
+    OutputIt FindAllInto(const Vec2& min, const Vec2& max, OutputIt out, Filter filter) const
+    {
+        ForEachInArea(min, max, [&](const Element& element)
+        {
+            if (filter(element))
+            {
+                *out++ = element;
+            }
+            return true;
+        });
+        
+        return out;
+    }
+    
+    /// Finds elements within the search area and writes them to an output iterator.
+    /// @tparam OutputIt An output iterator that accepts elements.
+    /// @param min The minimum point describing the search area.
+    /// @param max The maximum point describing the search area.
+    /// @param out The iterator to write the elements found to.
+    /// @return The output iterator past the last element written.
+    template<typename OutputIt>
+    OutputIt FindAllInto(const Vec2& min, const Vec2& max, OutputIt out) const
+    {
+        return FindAllInto(min, max, out, QuadtreeDetail::NoFilter{});
+    }
+    
+    /// Finds the closest element to each target position on all threads of a pool.
+    /// @tparam Filter A function that takes in an element and returns true if it qualifies for the search, which must be safe to call concurrently.
+    /// @param targets The positions to search around.
+    /// @param nearest The closest element to each target, in the same order as the targets.
+    /// @param threadPool The threads to split the searches across.
+    /// @param filter The filter to pass for an element to qualify.
+    /// @param maxRadius The maximum distance from the targets to consider.
+    template<typename Filter>
+    void FindNearestBatch(const std::vector<Vec2>& targets, std::vector<std::optional<Element>>& nearest, QuadtreeThreadPool& threadPool, Filter filter, Scalar maxRadius = std::numeric_limits<Scalar>::max()) const
+    {
+        nearest.resize(targets.size());
+        auto order = SortByMortonCode(targets, [](const Vec2& target) { return target; });
+        
+        // Every chunk counts into its own slot so the threads never share counters.
+        std::vector<Stats> chunkStats(Stats::Enabled ? (order.size() + BatchChunkSize - 1) / BatchChunkSize : 0);
+        threadPool.ParallelFor(order.size(), BatchChunkSize, [&](size_t begin, size_t end)
+        {
+            Stats stats;
+            for (size_t i = begin; i < end; ++i)
+            {
+                uint32_t index = order[i].second;
+                nearest[index] = FindNearest(targets[index], filter, maxRadius, stats);
+            }
+            
+            if constexpr (Stats::Enabled)
+            {
+                chunkStats[begin / BatchChunkSize] = stats;
+            }
+        });
+        
+        Stats batchStats;
+        for (const auto& stats : chunkStats)
+        {
+            batchStats += stats;
+        }
+        RecordQuery(batchStats);
+    }
+    
+    /// Finds the closest element to each target position on all threads of a pool.
+    /// @param targets The positions to search around.
+    /// @param nearest The closest element to each target, in the same order as the targets.
+    /// @param threadPool The threads to split the searches across.
+    /// @param maxRadius The maximum distance from the targets to consider.
+    void FindNearestBatch(const std::vector<Vec2>& targets, std::vector<std::optional<Element>>& nearest, QuadtreeThreadPool& threadPool, Scalar maxRadius = std::numeric_limits<Scalar>::max()) const
+    {
+        FindNearestBatch(targets, nearest, threadPool, QuadtreeDetail::NoFilter{}, maxRadius);
+    }
+    
+    /// Finds the elements within each search area on all threads of a pool.
+    /// @tparam Filter A function that takes in an element and returns true if it qualifies for the search, which must be safe to call concurrently.
+    /// @param areas The minimum and maximum points describing each search area.
+    /// @param foundElements The elements found within each area, in the same order as the areas, whose capacity is reused across searches.
+    /// @param threadPool The threads to split the searches across.
+    /// @param filter The filter to pass for an element to qualify.
+    template<typename Filter>
+    void FindAllBatch(const std::vector<std::pair<Vec2, Vec2>>& areas, std::vector<std::vector<Element>>& foundElements, QuadtreeThreadPool& threadPool, Filter filter) const
+    {
+        foundElements.resize(areas.size());
+        auto order = SortByMortonCode(areas, [](const std::pair<Vec2, Vec2>& area) { return QuadtreeDetail::Bounds<Vec2>(area.first, area.second).GetCenter(); });
+        
+        // Every chunk counts into its own slot so the threads never share counters.
+        std::vector<Stats> chunkStats(Stats::Enabled ? (order.size() + BatchChunkSize - 1) / BatchChunkSize : 0);
+        threadPool.ParallelFor(order.size(), BatchChunkSize, [&](size_t begin, size_t end)
+        {
+            Stats stats;
+            for (size_t i = begin; i < end; ++i)
+            {
+                uint32_t index = order[i].second;
+                foundElements[index].clear();
+                
+                QuadtreeDetail::Bounds<Vec2> searchArea(areas[index].first, areas[index].second);
+                if (mRoot.bounds.Intersects(searchArea))
+                {
+                    mRoot.FindAll(searchArea, filter, foundElements[index], stats);
+                }
+            }
+            
+            if constexpr (Stats::Enabled)
+            {
+                chunkStats[begin / BatchChunkSize] = stats;
+            }
+        });
+        
+        Stats batchStats;
+        for (const auto& stats : chunkStats)
+        {
+            batchStats += stats;
+        }
+        RecordQuery(batchStats);
+    }
+    
+    /// Finds the elements within each search area on all threads of a pool.
+    /// @param areas The minimum and maximum points describing each search area.
+    /// @param foundElements The elements found within each area, in the same order as the areas, whose capacity is reused across searches.
+    /// @param threadPool The threads to split the searches across.
+    void FindAllBatch(const std::vector<std::pair<Vec2, Vec2>>& areas, std::vector<std::vector<Element>>& foundElements, QuadtreeThreadPool& threadPool) const
+    {
+        FindAllBatch(areas, foundElements, threadPool, QuadtreeDetail::NoFilter{});
+    }
+    
+    /// Creates an immutable snapshot of the tree that is faster to search.
+    /// @return The snapshot of the tree's current contents.
+    Frozen Freeze() const
+    {
+        return Frozen(mRoot);
     }
     
-    /// Inserts a new element with the given data and position.
+    /// Moves an element matching the given data from one position to another without searching from the root twice.
     /// @param data The data representing the element.
-    /// @param position The position where the element is.
-    /// @return True if the element was successfully inserted.
-    bool Insert(T data, const Vec2& position)
+    /// @param oldPosition The position where the element is.
+    /// @param newPosition The position to move the element to.
+    /// @return True if the element was found and moved, false if it wasn't found or the new position is outside the tree.
+    bool Update(const T& data, const Vec2& oldPosition, const Vec2& newPosition)
     {
-        if (!mRoot.bounds.Contains(position))
+        if (!mRoot.bounds.Contains(oldPosition) || (!mRoot.bounds.Contains(newPosition) && !(mAutoGrow && Grow(newPosition))))
+        {
+            return false;
+        }
+        
+        if (!mRoot.Update(data, oldPosition, newPosition, mNodeCapacity, mMaxDepth, mMergePolicy, mAllocator, mCounters))
         {
             return false;
         }
         
-        return mRoot.Insert(data, position, mNodeCapacity, mMaxDepth);
+        if (mAutoShrink)
+        {
+            Shrink();
+        }
+        
+        return true;
     }
     
-    /// Removes an element matching the given data and position.
-    /// @param data The data representing the element.
-    /// @param position The position where the element is.
-    /// @return True if the element was successfully removed.
-    bool Remove(T data, const Vec2& position)
+    /// Removes every element from the tree and releases all of its nodes at once.
+    void Clear()
     {
-        if (!mRoot.bounds.Contains(position))
+        mRoot.Clear(mAllocator);
+        mAllocator.Reset();
+        
+        if (mAutoShrink)
         {
-            return false;
+            Shrink();
         }
-        
-        return mRoot.Remove(data, position, mNodeCapacity);
     }
     
     /// Finds the closest element to the target position that passes a filter.
@@ -504,11 +3403,11 @@ public:
     /// @param maxRadius The maximum distance from the target to consider.
     /// @return The closest element if found, or empty.
     template<typename Filter>
-    std::optional<Element> FindNearest(const Vec2& target, Filter filter, float maxRadius = std::numeric_limits<float>::max()) const
+    std::optional<Element> FindNearest(const Vec2& target, Filter filter, Scalar maxRadius = std::numeric_limits<Scalar>::max()) const
     {
-        std::optional<Element> nearest = std::nullopt;
-        float bestDistanceSq = maxRadius * maxRadius;
-        mRoot.FindNearest(target, filter, bestDistanceSq, nearest);
+        Stats stats;
+        auto nearest = FindNearest(target, filter, maxRadius, stats);
+        RecordQuery(stats);
         return nearest;
     }
     
@@ -516,11 +3415,61 @@ public:
     /// @param target The position to search around.
     /// @param maxRadius The maximum distance from the target to consider.
     /// @return The closest element if found, or empty.
-    std::optional<Element> FindNearest(const Vec2& target, float maxRadius = std::numeric_limits<float>::max()) const
+    std::optional<Element> FindNearest(const Vec2& target, Scalar maxRadius = std::numeric_limits<Scalar>::max()) const
     {
         return FindNearest(target, QuadtreeDetail::NoFilter{}, maxRadius);
     }
     
+    /// Finds the k closest elements to the target position that pass a filter.
+    /// @tparam Filter A function that takes in an element and returns true if it qualifies for the search.
+    /// @param target The position to search around.
+    /// @param k The maximum number of elements to find.
+    /// @param nearest The buffer that receives the closest elements sorted by increasing distance, whose capacity is reused across searches.
+    /// @param filter The filter to pass for an element to qualify.
+    /// @param maxRadius The maximum distance from the target to consider.
+    template<typename Filter>
+    void FindKNearest(const Vec2& target, size_t k, std::vector<Element>& nearest, Filter filter, Scalar maxRadius = std::numeric_limits<Scalar>::max()) const
+    {
+        nearest.clear();
+        if (k == 0)
+        {
+            return;
+        }
+        
+        using Candidate = std::pair<QuadtreeDetail::Distance<Vec2>, Element>;
+        
+        // The heap keeps each distance next to its element, and its storage is reused by every search on the thread.
+        // Taking it out for the duration of the search keeps a filter that searches again from sharing it.
+        static thread_local std::vector<Candidate> sHeapStorage;
+        std::vector<Candidate> heap = std::move(sHeapStorage);
+        heap.clear();
+        
+        Stats stats;
+        QuadtreeDetail::Distance<Vec2> worstDistanceSq = QuadtreeDetail::GetRadiusSq<Vec2>(maxRadius);
+        mRoot.FindKNearest(target, k, filter, worstDistanceSq, heap, stats);
+        RecordQuery(stats);
+        
+        std::sort_heap(heap.begin(), heap.end(), [](const Candidate& a, const Candidate& b) { return a.first < b.first; });
+        nearest.reserve(heap.size());
+        for (auto& candidate : heap)
+        {
+            nearest.push_back(std::move(candidate.second));
+        }
+        
+        heap.clear();
+        sHeapStorage = std::move(heap);
+    }
+    
+    /// Finds the k closest elements to the target position.
+    /// @param target The position to search around.
+    /// @param k The maximum number of elements to find.
+    /// @param nearest The buffer that receives the closest elements sorted by increasing distance, whose capacity is reused across searches.
+    /// @param maxRadius The maximum distance from the target to consider.
+    void FindKNearest(const Vec2& target, size_t k, std::vector<Element>& nearest, Scalar maxRadius = std::numeric_limits<Scalar>::max()) const
+    {
+        FindKNearest(target, k, nearest, QuadtreeDetail::NoFilter{}, maxRadius);
+    }
+    
     /// Finds elements within the region that pass a filter.
     /// @tparam Filter A function that takes in an element and returns true if it qualifies for the search.
     /// @param min The minimum point describing the search area.
@@ -532,12 +3481,14 @@ public:
     {
         std::vector<Element> foundElements;
         
+        Stats stats;
         QuadtreeDetail::Bounds searchArea(min, max);
         if (mRoot.bounds.Intersects(searchArea))
         {
-            mRoot.FindAll(searchArea, filter, foundElements);
+            mRoot.FindAll(searchArea, filter, foundElements, stats);
         }
         
+        RecordQuery(stats);
         return foundElements;
     }
     
@@ -550,15 +3501,504 @@ public:
         return FindAll(min, max, QuadtreeDetail::NoFilter{});
     }
     
+    /// Counts the elements within the region that pass a filter without copying them.
+    /// @tparam Filter A function that takes in an element and returns true if it qualifies for the search.
+    /// @param min The minimum point describing the search area.
+    /// @param max The maximum point describing the search area.
+    /// @param filter The filter to pass for an element to qualify.
+    /// @return The number of elements found within the region.
+    template<typename Filter>
+    size_t CountInArea(const Vec2& min, const Vec2& max, Filter filter) const
+    {
+        QuadtreeDetail::Bounds searchArea(min, max);
+        if (mRoot.bounds.Intersects(searchArea))
+        {
+            return mRoot.CountInArea(searchArea, filter);
+        }
+        
+        return 0;
+    }
+    
+    /// Counts the elements within the search area, using the cached count of every node that lies entirely inside it.
+    /// @param min The minimum point describing the search area.
+    /// @param max The maximum point describing the search area.
+    /// @return The number of elements found within the region.
+    size_t CountInArea(const Vec2& min, const Vec2& max) const
+    {
+        return CountInArea(min, max, QuadtreeDetail::NoFilter{});
+    }
+    
+    /// Visits the elements within a circle without copying them.
+    /// @tparam Visitor A function that takes in an element and returns false to stop the traversal.
+    /// @param center The center of the circle.
+    /// @param radius The radius of the circle.
+    /// @param visitor The function to call with every element found.
+    /// @return False if the visitor stopped the traversal early, true otherwise.
+    template<typename Visitor>
+    bool ForEachInRadius(const Vec2& center, Scalar radius, Visitor visitor) const
+    {
+        QuadtreeDetail::Distance<Vec2> radiusSq = QuadtreeDetail::GetRadiusSq<Vec2>(radius);
+        if (radius >= Scalar(0) && mRoot.bounds.GetDistanceSq(center) <= radiusSq)
+        {
+            return mRoot.ForEachInRadius(center, radiusSq, visitor);
+        }
+        
+        return true;
+    }
+    
+    /// Finds elements within a circle that pass a filter.
+    /// @tparam Filter A function that takes in an element and returns true if it qualifies for the search.
+    /// @param center The center of the circle.
+    /// @param radius The radius of the circle.
+    /// @param filter The filter to pass for an element to qualify.
+    /// @return The collection of elements found within the circle.
+    template<typename Filter>
+    std::vector<Element> FindInRadius(const Vec2& center, Scalar radius, Filter filter) const
+    {
+        std::vector<Element> foundElements;
+        
+        Stats stats;
+        QuadtreeDetail::Distance<Vec2> radiusSq = QuadtreeDetail::GetRadiusSq<Vec2>(radius);
+        if (radius >= Scalar(0) && mRoot.bounds.GetDistanceSq(center) <= radiusSq)
+        {
+            mRoot.FindInRadius(center, radiusSq, filter, foundElements, stats);
+        }
+        
+        RecordQuery(stats);
+        return foundElements;
+    }
+    
+    /// Finds elements within a circle.
+    /// @param center The center of the circle.
+    /// @param radius The radius of the circle.
+    /// @return The collection of elements found within the circle.
+    std::vector<Element> FindInRadius(const Vec2& center, Scalar radius) const
+    {
+        return FindInRadius(center, radius, QuadtreeDetail::NoFilter{});
+    }
+    
+    /// Lists the elements in order of their distance to a target, searching lazily so that stopping early skips the rest of the tree.
+    /// The sequence must not outlive the tree and is invalidated by any modification, like any iterator into the tree.
+    /// @param target The position to measure distances from.
+    /// @return The sequence of elements from closest to farthest, meant to be iterated once.
+    QuadtreeDetail::NearestRange<T, Vec2> NearestRange(const Vec2& target) const
+    {
+        return QuadtreeDetail::NearestRange<T, Vec2>(mRoot, target);
+    }
+    
+    /// Finds the first element along a ray that passes a filter.
+    /// Only the nodes that the ray passes through are visited, from front to back, and none are visited past the first hit.
+    /// @tparam Filter A function that takes in an element and returns true if it qualifies for the search.
+    /// @param origin The start of the ray.
+    /// @param direction The direction of the ray, which doesn't need to be normalized.
+    /// @param maxDistance How far the ray reaches from its origin.
+    /// @param hitRadius How far from the ray an element can be and still be hit.
+    /// @param filter The filter to pass for an element to qualify.
+    /// @return The element whose closest point along the ray is nearest to the origin if found, or empty.
+    template<typename Filter>
+    std::optional<Element> RayCast(const Vec2& origin, const Vec2& direction, Scalar maxDistance, Scalar hitRadius, Filter filter) const
+    {
+        using Real = QuadtreeDetail::Real<Vec2>;
+        
+        Stats stats;
+        std::optional<Element> nearest = std::nullopt;
+        QuadtreeDetail::Ray<Vec2> ray(origin, Real(direction.x), Real(direction.y), Real(maxDistance), Real(hitRadius));
+        Real enter;
+        if (ray.Clip(mRoot.bounds, enter))
+        {
+            Real bestDistance = std::numeric_limits<Real>::infinity();
+            mRoot.RayCast(ray, filter, bestDistance, nearest, stats);
+        }
+        
+        RecordQuery(stats);
+        return nearest;
+    }
+    
+    /// Finds the first element along a ray.
+    /// @param origin The start of the ray.
+    /// @param direction The direction of the ray, which doesn't need to be normalized.
+    /// @param maxDistance How far the ray reaches from its origin.
+    /// @param hitRadius How far from the ray an element can be and still be hit.
+    /// @return The element whose closest point along the ray is nearest to the origin if found, or empty.
+    std::optional<Element> RayCast(const Vec2& origin, const Vec2& direction, Scalar maxDistance = std::numeric_limits<Scalar>::max(), Scalar hitRadius = Scalar(0)) const
+    {
+        return RayCast(origin, direction, maxDistance, hitRadius, QuadtreeDetail::NoFilter{});
+    }
+    
+    /// Visits the elements hit by a segment in order of their distance from its start without copying them.
+    /// Nodes and elements are expanded best-first by the distance where the segment reaches them, so stopping early skips the rest of the segment.
+    /// @tparam Visitor A function that takes in an element and returns false to stop the traversal.
+    /// @param start The start of the segment.
+    /// @param end The end of the segment.
+    /// @param hitRadius How far from the segment an element can be and still be hit.
+    /// @param visitor The function to call with every element hit.
+    /// @return False if the visitor stopped the traversal early, true otherwise.
+    template<typename Visitor>
+    bool ForEachAlongSegment(const Vec2& start, const Vec2& end, Scalar hitRadius, Visitor visitor) const
+    {
+        using Real = QuadtreeDetail::Real<Vec2>;
+        
+        Real directionX = Real(end.x) - Real(start.x);
+        Real directionY = Real(end.y) - Real(start.y);
+        QuadtreeDetail::Ray<Vec2> ray(start, directionX, directionY, std::sqrt((directionX * directionX) + (directionY * directionY)), Real(hitRadius));
+        
+        // A node enters the queue at the distance where the segment reaches it, which is never past any element inside it that the segment hits.
+        struct Candidate
+        {
+            Real distance;
+            const Node* node;
+            const Element* element;
+        };
+        
+        auto isFarther = [](const Candidate& a, const Candidate& b) { return a.distance > b.distance; };
+        std::vector<Candidate> candidates;
+        
+        Real enter;
+        if (ray.Clip(mRoot.bounds, enter))
+        {
+            candidates.push_back({enter, &mRoot, nullptr});
+        }
+        
+        while (!candidates.empty())
+        {
+            std::pop_heap(candidates.begin(), candidates.end(), isFarther);
+            Candidate candidate = candidates.back();
+            candidates.pop_back();
+            
+            if (candidate.element)
+            {
+                if (!visitor(*candidate.element))
+                {
+                    return false;
+                }
+                continue;
+            }
+            
+            const Node& node = *candidate.node;
+            if (node.isLeaf)
+            {
+                for (const auto& element : node.elements)
+                {
+                    Real distance;
+                    if (ray.Hit(element.position, distance))
+                    {
+                        candidates.push_back({distance, nullptr, &element});
+                        std::push_heap(candidates.begin(), candidates.end(), isFarther);
+                    }
+                }
+                continue;
+            }
+            
+            for (const auto& child : *node.children)
+            {
+                if (ray.Clip(child.bounds, enter))
+                {
+                    candidates.push_back({enter, &child, nullptr});
+                    std::push_heap(candidates.begin(), candidates.end(), isFarther);
+                }
+            }
+        }
+        
+        return true;
+    }
+    
+    /// Visits every pair of elements within a distance of each other, reporting each unordered pair exactly once.
+    /// Pairs of nodes are pruned by the distance between their bounds, so only neighbouring leaves ever compare their elements.
+    /// @tparam Visitor A function that takes in the two elements of a pair.
+    /// @param distance The distance that the elements of a pair must be within.
+    /// @param visitor The function to call with every pair found.
+    template<typename Visitor>
+    void FindAllPairs(Scalar distance, Visitor visitor) const
+    {
+        Stats stats;
+        if (distance >= Scalar(0) && mRoot.count > 1)
+        {
+            mRoot.ForEachPair(nullptr, QuadtreeDetail::GetRadiusSq<Vec2>(distance), visitor, stats);
+        }
+        
+        RecordQuery(stats);
+    }
+    
+    /// Visits every pair of elements within a distance of each other on all threads of a pool, reporting each unordered pair exactly once.
+    /// The top levels of the tree are split into independent pairs of nodes, which the threads then traverse on their own.
+    /// @tparam Visitor A function that takes in the two elements of a pair, which must be safe to call concurrently.
+    /// @param distance The distance that the elements of a pair must be within.
+    /// @param visitor The function to call with every pair found.
+    /// @param threadPool The threads to split the pairs of nodes across.
+    template<typename Visitor>
+    void FindAllPairs(Scalar distance, Visitor visitor, QuadtreeThreadPool& threadPool) const
+    {
+        if (distance < Scalar(0) || mRoot.count < 2)
+        {
+            RecordQuery(Stats());
+            return;
+        }
+        
+        QuadtreeDetail::Distance<Vec2> distanceSq = QuadtreeDetail::GetRadiusSq<Vec2>(distance);
+        
+        // Split the pairs level by level until every thread can claim several of them, leaving pairs of leaves as they are.
+        Stats splitStats;
+        std::vector<std::pair<const Node*, const Node*>> tasks = {{&mRoot, nullptr}};
+        std::vector<std::pair<const Node*, const Node*>> nextTasks;
+        size_t taskCount = threadPool.GetThreadCount() * PairTasksPerThread;
+        bool isSplit = true;
+        while (tasks.size() < taskCount && isSplit)
+        {
+            isSplit = false;
+            nextTasks.clear();
+            for (const auto& [node, other] : tasks)
+            {
+                if (node->isLeaf && (!other || other->isLeaf))
+                {
+                    nextTasks.emplace_back(node, other);
+                    continue;
+                }
+                
+                splitStats.OnNodeVisited();
+                node->SplitPair(other, distanceSq, [&](const Node& child, const Node* otherChild) { nextTasks.emplace_back(&child, otherChild); }, splitStats);
+                isSplit = true;
+            }
+            tasks.swap(nextTasks);
+        }
+        
+        std::vector<Stats> taskStats(Stats::Enabled ? tasks.size() : 0);
+        threadPool.ParallelFor(tasks.size(), 1, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                Stats stats;
+                tasks[i].first->ForEachPair(tasks[i].second, distanceSq, visitor, stats);
+                
+                if constexpr (Stats::Enabled)
+                {
+                    taskStats[i] = stats;
+                }
+            }
+        });
+        
+        for (const auto& stats : taskStats)
+        {
+            splitStats += stats;
+        }
+        RecordQuery(splitStats);
+    }
+    
     /// Copy assignment is deleted to avoid accidental copies.
     Quadtree& operator=(const Quadtree&) = delete;
     
-    /// Move assignment is defaulted to allow efficient transfer of ownership.
-    Quadtree& operator=(Quadtree&&) = default;
+    /// Move assignment releases the current nodes and then transfers ownership from the other tree.
+    /// @param other The tree to move from.
+    /// @return A reference to this tree.
+    Quadtree& operator=(Quadtree&& other)
+    {
+        if (this != &other)
+        {
+            mRoot.Clear(mAllocator);
+            mRoot = std::move(other.mRoot);
+            mNodeCapacity = other.mNodeCapacity;
+            mMaxDepth = other.mMaxDepth;
+            mMergePolicy = other.mMergePolicy;
+            mGrowthHistory = std::move(other.mGrowthHistory);
+            mAutoGrow = other.mAutoGrow;
+            mAutoShrink = other.mAutoShrink;
+            mCounters = other.mCounters;
+            mLastQueryCounters = other.mLastQueryCounters;
+            mAllocator = std::move(other.mAllocator);
+        }
+        return *this;
+    }
     
 private:
     using Node = QuadtreeDetail::Node<T, Vec2>;
     
+    /// How many queries of a batch a thread claims at a time.
+    static constexpr size_t BatchChunkSize = 64;
+    
+    /// How many pairs of nodes the parallel pair search aims to give each thread, so that uneven pairs still balance out.
+    static constexpr size_t PairTasksPerThread = 16;
+    
+    /// Finds the closest element to the target position that passes a filter, counting the work into the given stats.
+    /// @tparam Filter A function that takes in an element and returns true if it qualifies for the search.
+    /// @param target The position to search around.
+    /// @param filter The filter to pass for an element to qualify.
+    /// @param maxRadius The maximum distance from the target to consider.
+    /// @param stats The stats policy that records the work done by the search.
+    /// @return The closest element if found, or empty.
+    template<typename Filter>
+    std::optional<Element> FindNearest(const Vec2& target, Filter filter, Scalar maxRadius, Stats& stats) const
+    {
+        std::optional<Element> nearest = std::nullopt;
+        QuadtreeDetail::Distance<Vec2> bestDistanceSq = QuadtreeDetail::GetRadiusSq<Vec2>(maxRadius);
+        mRoot.FindNearest(target, filter, bestDistanceSq, nearest, stats);
+        return nearest;
+    }
+    
+    /// Adds the work counted by a search to the totals and keeps it as the most recent search.
+    /// @param stats The stats policy that recorded the search.
+    void RecordQuery(const Stats& stats) const
+    {
+        if constexpr (Stats::Enabled)
+        {
+            mLastQueryCounters = stats;
+            mCounters += stats;
+        }
+    }
+    
+    /// Pairs the elements of a range inside the tree with their Z-order keys and sorts them, which groups the elements of every node together.
+    /// @tparam Iterator A forward iterator to elements of the tree's type.
+    /// @param first The first element of the range.
+    /// @param last The end of the range.
+    /// @return The sorted pairs of keys and iterators, which exclude the elements outside the tree's bounds.
+    template<typename Iterator>
+    std::vector<std::pair<uint64_t, Iterator>> SortBatch(Iterator first, Iterator last) const
+    {
+        std::vector<std::pair<uint64_t, Iterator>> entries;
+        entries.reserve(std::distance(first, last));
+        
+        for (auto it = first; it != last; ++it)
+        {
+            if (mRoot.bounds.Contains(it->position))
+            {
+                entries.emplace_back(mRoot.GetMortonCode(it->position, mMaxDepth), it);
+            }
+        }
+        
+        QuadtreeDetail::RadixSort(entries, std::min(mMaxDepth, 32) * 2);
+        return entries;
+    }
+    
+    /// Orders a batch of queries along the Z-order curve so that consecutive queries visit the same nodes.
+    /// @tparam Query The type of query in the batch.
+    /// @tparam GetPosition A function that takes in a query and returns the position used to order it.
+    /// @param queries The queries to order.
+    /// @param getPosition The function that locates each query.
+    /// @return Pairs made of a Z-order key and the index of a query, sorted by key.
+    template<typename Query, typename GetPosition>
+    std::vector<std::pair<uint64_t, uint32_t>> SortByMortonCode(const std::vector<Query>& queries, GetPosition getPosition) const
+    {
+        std::vector<std::pair<uint64_t, uint32_t>> order;
+        order.reserve(queries.size());
+        for (size_t i = 0; i < queries.size(); ++i)
+        {
+            order.emplace_back(mRoot.GetMortonCode(getPosition(queries[i]), mMaxDepth), static_cast<uint32_t>(i));
+        }
+        
+        QuadtreeDetail::RadixSort(order, std::min(mMaxDepth, 32) * 2);
+        return order;
+    }
+    
+    /// Doubles the area covered by the tree toward a position until the position is covered.
+    /// The current root becomes one of the quadrants of the new root, so its elements don't need to be inserted again.
+    /// @param position The position to cover.
+    /// @return True if the tree now covers the position, false if the position or the tree's bounds can't be grown toward.
+    bool Grow(const Vec2& position)
+    {
+        if (!std::isfinite(position.x) || !std::isfinite(position.y) || mRoot.bounds.GetWidth() <= Scalar(0) || mRoot.bounds.GetHeight() <= Scalar(0))
+        {
+            return false;
+        }
+        
+        while (!mRoot.bounds.Contains(position))
+        {
+            Vec2 min = mRoot.bounds.min;
+            Vec2 max = mRoot.bounds.max;
+            Scalar width = mRoot.bounds.GetWidth();
+            Scalar height = mRoot.bounds.GetHeight();
+            
+            Vec2 center = mRoot.bounds.GetCenter();
+            bool growLeft = position.x < center.x;
+            bool growDown = position.y < center.y;
+            QuadtreeDetail::Bounds<Vec2> bounds({growLeft ? min.x - width : min.x, growDown ? min.y - height : min.y}, {growLeft ? max.x : max.x + width, growDown ? max.y : max.y + height});
+            
+            mGrowthHistory.push_back(mRoot.bounds);
+            ++mMaxDepth;
+            
+            Vec2 newCenter = bounds.GetCenter();
+            if (mRoot.isLeaf)
+            {
+                // A leaf keeps its elements and simply covers more area.
+                mRoot.bounds = bounds;
+            }
+            else if (newCenter.x == (growLeft ? min.x : max.x) && newCenter.y == (growDown ? min.y : max.y))
+            {
+                // The old root sits on the opposite side of the direction the tree grows in.
+                int index = (growLeft ? 1 : 0) + (growDown ? 0 : 2);
+                mRoot.Expand(bounds, index, mAllocator);
+            }
+            else
+            {
+                // Rounding moved the new center off the edges of the old root, so its elements are inserted again to keep each one in the quadrant searches expect.
+                std::vector<Element> elements;
+                auto collect = [&elements](const Element& element)
+                {
+                    elements.push_back(element);
+                    return true;
+                };
+                mRoot.ForEachElement(collect);
+                mRoot.Clear(mAllocator);
+                mRoot.bounds = bounds;
+                
+                for (auto& element : elements)
+                {
+                    mRoot.Insert(std::move(element.data), element.position, mNodeCapacity, mMaxDepth, mAllocator, mCounters);
+                }
+            }
+        }
+        
+        return true;
+    }
+    
+    /// Undoes the most recent growth steps while every element still fits within the area the tree covered before each step.
+    void Shrink()
+    {
+        while (!mGrowthHistory.empty())
+        {
+            const auto& previousBounds = mGrowthHistory.back();
+            if (mRoot.isLeaf)
+            {
+                for (const auto& element : mRoot.elements)
+                {
+                    if (!previousBounds.Contains(element.position))
+                    {
+                        return;
+                    }
+                }
+                
+                mRoot.bounds = previousBounds;
+            }
+            else
+            {
+                // The previous root is the only child that may hold elements, unless its elements had to be inserted again when growing.
+                int index = -1;
+                for (int childIndex = 0; childIndex < 4; ++childIndex)
+                {
+                    const Node& child = (*mRoot.children)[childIndex];
+                    if (child.bounds.min == previousBounds.min && child.bounds.max == previousBounds.max)
+                    {
+                        index = childIndex;
+                    }
+                    else if (!child.isLeaf || !child.elements.empty())
+                    {
+                        return;
+                    }
+                }
+                
+                if (index < 0)
+                {
+                    return;
+                }
+                
+                Node root = std::move((*mRoot.children)[index]);
+                mRoot.Clear(mAllocator);
+                root.OffsetDepth(-1);
+                mRoot = std::move(root);
+            }
+            
+            mGrowthHistory.pop_back();
+            --mMaxDepth;
+        }
+    }
+    
     /// Represents the tree's root node.
     Node mRoot;
     
@@ -567,4 +4007,25 @@ private:
     
     /// How many additional levels the tree can have (the root is at depth 0).
     int mMaxDepth;
+    
+    /// Controls when branches are merged back after removals.
+    QuadtreeDetail::MergePolicy mMergePolicy;
+    
+    /// The area covered by the root before each growth step, with the most recent step last.
+    std::vector<QuadtreeDetail::Bounds<Vec2>> mGrowthHistory;
+    
+    /// Whether inserting outside the tree grows it instead of failing.
+    bool mAutoGrow = false;
+    
+    /// Whether removals shrink the tree back toward its initial bounds.
+    bool mAutoShrink = false;
+    
+    /// The work counted since the tree was created or the counters were last reset, which searches add to.
+    mutable Stats mCounters;
+    
+    /// The work counted by the most recent search.
+    mutable Stats mLastQueryCounters;
+    
+    /// Provides the storage for every block of child nodes in the tree.
+    Allocator<typename Node::Children> mAllocator;
 };
@@ -0,0 +1,378 @@
+/// Copyright (c) 2025 Jose Ilitzky
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "Quadtree.h"
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/// Saves trees as binary images of their frozen layout and maps those images back into memory, so they can be searched without being deserialized.
+/// An image can only be loaded by a build with the same element layout, byte order and SIMD width as the one that saved it.
+class QuadtreeSnapshot
+{
+public:
+    /// The version of the image layout, which changes whenever the layout does.
+    static constexpr uint32_t Version = 2;
+    
+    /// Saves the frozen layout of a tree to a file.
+    /// @tparam T The type of data representing elements in the tree, which must be trivially copyable.
+    /// @tparam Vec2 The type of 2D vector to use.
+    /// @tparam Allocator The policy used to allocate blocks of child nodes.
+    /// @tparam Stats The policy that counts the work done by the tree.
+    /// @param tree The tree to save.
+    /// @param path The path of the file to write.
+    /// @return True if the whole image was written.
+    template<typename T, typename Vec2, template<typename> class Allocator, typename Stats>
+    static bool Save(const Quadtree<T, Vec2, Allocator, Stats>& tree, const std::string& path)
+    {
+        return Save(tree.Freeze(), path, tree.GetNodeCapacity(), tree.GetMaxDepth());
+    }
+    
+    /// Saves a frozen tree to a file.
+    /// @tparam T The type of data representing elements in the tree, which must be trivially copyable.
+    /// @tparam Vec2 The type of 2D vector to use.
+    /// @param frozen The frozen tree to save.
+    /// @param path The path of the file to write.
+    /// @param nodeCapacity The node capacity of the tree the snapshot was taken from.
+    /// @param maxDepth The maximum depth of the tree the snapshot was taken from.
+    /// @return True if the whole image was written.
+    template<typename T, typename Vec2>
+    static bool Save(const FrozenQuadtree<T, Vec2>& frozen, const std::string& path, size_t nodeCapacity, int maxDepth)
+    {
+        using Frozen = FrozenQuadtree<T, Vec2>;
+        static_assert(std::is_trivially_copyable_v<typename Frozen::Element>, "Only elements that are trivially copyable can be saved");
+        
+        Header header = MakeHeader<T, Vec2>();
+        header.nodeCapacity = nodeCapacity;
+        header.maxDepth = maxDepth;
+        header.height = frozen.mHeight;
+        header.nodeCount = frozen.mNodeCount;
+        header.elementCount = frozen.mElementCount;
+        header.positionCount = frozen.mPositionCount;
+        
+        // Every array starts on a boundary that satisfies the alignment of any type stored in it once the file is mapped.
+        header.nodesOffset = Align(sizeof(Header));
+        header.elementsOffset = Align(header.nodesOffset + (header.nodeCount * sizeof(typename Frozen::Node)));
+        header.positionsXOffset = Align(header.elementsOffset + (header.elementCount * sizeof(typename Frozen::Element)));
+        header.positionsYOffset = Align(header.positionsXOffset + (header.positionCount * sizeof(typename Frozen::Scalar)));
+        
+        std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+        if (!stream.is_open())
+        {
+            return false;
+        }
+        
+        uint64_t offset = 0;
+        auto write = [&](uint64_t sectionOffset, const void* data, uint64_t size)
+        {
+            static constexpr std::array<char, SectionAlignment> padding = {};
+            stream.write(padding.data(), static_cast<std::streamsize>(sectionOffset - offset));
+            stream.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+            offset = sectionOffset + size;
+        };
+
+        write(0, &header, sizeof(Header));
+        write(header.nodesOffset, frozen.mNodes, header.nodeCount * sizeof(typename Frozen::Node));
+        write(header.elementsOffset, frozen.mElements, header.elementCount * sizeof(typename Frozen::Element));
+        write(header.positionsXOffset, frozen.mPositionsX, header.positionCount * sizeof(typename Frozen::Scalar));
+        write(header.positionsYOffset, frozen.mPositionsY, header.positionCount * sizeof(typename Frozen::Scalar));
+        return static_cast<bool>(stream.flush());
+    }
+    
+    /// Maps a file written by Save into memory and serves searches directly from its pages.
+    /// @tparam T The type of data representing elements in the tree.
+    /// @tparam Vec2 The type of 2D vector to use.
+    /// @param path The path of the file to map.
+    /// @return The frozen tree, which keeps the file mapped until it and all of its copies are destroyed, or empty if the file can't be mapped or wasn't saved by a compatible build.
+    template<typename T, typename Vec2>
+    static std::optional<FrozenQuadtree<T, Vec2>> LoadMapped(const std::string& path)
+    {
+        using Frozen = FrozenQuadtree<T, Vec2>;
+        static_assert(std::is_trivially_copyable_v<typename Frozen::Element>, "Only elements that are trivially copyable can be loaded");
+        
+        auto file = std::make_shared<MappedFile>(path);
+        if (!file->data || file->size < sizeof(Header))
+        {
+            return std::nullopt;
+        }
+        
+        Header header;
+        std::memcpy(&header, file->data, sizeof(Header));
+        
+        Header expected = MakeHeader<T, Vec2>();
+        if (header.magic != expected.magic || header.version != expected.version || header.byteOrder != expected.byteOrder || header.elementSize != expected.elementSize || header.nodeSize != expected.nodeSize || header.scalarSize != expected.scalarSize || header.scalarKind != expected.scalarKind)
+        {
+            return std::nullopt;
+        }
+        
+        // Coordinates padded for narrower blocks would let the SIMD kernels read past the end of the arrays.
+        if (header.simdWidth % QuadtreeDetail::SimdWidth != 0 || header.nodeCount == 0)
+        {
+            return std::nullopt;
+        }
+        
+        auto fits = [&](uint64_t offset, uint64_t count, uint64_t size)
+        {
+            return offset % SectionAlignment == 0 && offset <= file->size && count <= (file->size - offset) / size;
+        };
+
+        if (!fits(header.nodesOffset, header.nodeCount, sizeof(typename Frozen::Node)) || !fits(header.elementsOffset, header.elementCount, sizeof(typename Frozen::Element)) || !fits(header.positionsXOffset, header.positionCount, sizeof(typename Frozen::Scalar)) || !fits(header.positionsYOffset, header.positionCount, sizeof(typename Frozen::Scalar)))
+        {
+            return std::nullopt;
+        }
+        
+        const char* data = static_cast<const char*>(file->data);
+        auto nodes = reinterpret_cast<const typename Frozen::Node*>(data + header.nodesOffset);
+        auto elements = reinterpret_cast<const typename Frozen::Element*>(data + header.elementsOffset);
+        auto positionsX = reinterpret_cast<const typename Frozen::Scalar*>(data + header.positionsXOffset);
+        auto positionsY = reinterpret_cast<const typename Frozen::Scalar*>(data + header.positionsYOffset);
+        if (!AreNodesValid(header, nodes))
+        {
+            return std::nullopt;
+        }
+        
+        return Frozen(std::move(file), nodes, header.nodeCount, elements, header.elementCount, positionsX, positionsY, header.positionCount, header.height);
+    }
+    
+private:
+    /// The boundary that every array in the image starts on.
+    static constexpr uint64_t SectionAlignment = 64;
+    
+    /// Describes the layout of an image, stored at the start of the file.
+    struct Header
+    {
+        /// Identifies the file as a tree image.
+        std::array<char, 8> magic;
+        
+        /// The version of the image layout.
+        uint32_t version;
+        
+        /// A known value stored in the byte order of the machine that saved the image.
+        uint32_t byteOrder;
+        
+        /// The size of an element, used to detect images of a different element type.
+        uint32_t elementSize;
+        
+        /// The size of a node, used to detect images of a different vector type.
+        uint32_t nodeSize;
+        
+        /// The SIMD width that the coordinates of every leaf are padded to.
+        uint32_t simdWidth;
+        
+        /// The size of a coordinate, used to detect images of a different vector type.
+        uint32_t scalarSize;
+        
+        /// Whether the coordinates are signed integers (0), unsigned integers (1) or floating-point numbers (2).
+        uint32_t scalarKind;
+        
+        /// The maximum depth of the tree the image was taken from.
+        int32_t maxDepth;
+        
+        /// The node capacity of the tree the image was taken from.
+        uint64_t nodeCapacity;
+        
+        /// The height of the tree from its deepest branch.
+        uint64_t height;
+        
+        /// How many nodes the image has.
+        uint64_t nodeCount;
+        
+        /// How many elements the image has.
+        uint64_t elementCount;
+        
+        /// How many coordinates, including padding, each coordinate array has.
+        uint64_t positionCount;
+        
+        /// Where the nodes start within the file.
+        uint64_t nodesOffset;
+        
+        /// Where the elements start within the file.
+        uint64_t elementsOffset;
+        
+        /// Where the horizontal coordinates start within the file.
+        uint64_t positionsXOffset;
+        
+        /// Where the vertical coordinates start within the file.
+        uint64_t positionsYOffset;
+    };
+
+    /// Keeps a file mapped into memory as read-only pages for as long as it exists.
+    struct MappedFile
+    {
+        /// The first byte of the mapped file, or null if it couldn't be mapped.
+        const void* data = nullptr;
+        
+        /// The size of the mapped file in bytes.
+        uint64_t size = 0;
+
+#if defined(_WIN32)
+        /// The mapping object backing the view of the file.
+        HANDLE mapping = nullptr;
+        
+        /// Maps a whole file.
+        /// @param path The path of the file to map.
+        explicit MappedFile(const std::string& path)
+        {
+            HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file == INVALID_HANDLE_VALUE)
+            {
+                return;
+            }
+            
+            LARGE_INTEGER fileSize;
+            if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0)
+            {
+                mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                if (mapping)
+                {
+                    data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                    size = data ? static_cast<uint64_t>(fileSize.QuadPart) : 0;
+                }
+            }
+            
+            // The mapping keeps the file open on its own.
+            CloseHandle(file);
+        }
+        
+        /// Unmaps the file.
+        ~MappedFile()
+        {
+            if (data)
+            {
+                UnmapViewOfFile(data);
+            }
+            
+            if (mapping)
+            {
+                CloseHandle(mapping);
+            }
+        }
+#else
+        /// Maps a whole file.
+        /// @param path The path of the file to map.
+        explicit MappedFile(const std::string& path)
+        {
+            int file = open(path.c_str(), O_RDONLY);
+            if (file < 0)
+            {
+                return;
+            }
+            
+            struct stat status;
+            if (fstat(file, &status) == 0 && status.st_size > 0)
+            {
+                void* address = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+                if (address != MAP_FAILED)
+                {
+                    data = address;
+                    size = static_cast<uint64_t>(status.st_size);
+                }
+            }
+            
+            // The mapping keeps the file open on its own.
+            close(file);
+        }
+        
+        /// Unmaps the file.
+        ~MappedFile()
+        {
+            if (data)
+            {
+                munmap(const_cast<void*>(data), static_cast<size_t>(size));
+            }
+        }
+#endif
+
+        /// Copy constructor is deleted since the mapping can only be released once.
+        MappedFile(const MappedFile&) = delete;
+        
+        /// Copy assignment is deleted since the mapping can only be released once.
+        MappedFile& operator=(const MappedFile&) = delete;
+    };
+
+    /// Creates a header describing the layout expected for the given types on this build.
+    /// @tparam T The type of data representing elements in the tree.
+    /// @tparam Vec2 The type of 2D vector to use.
+    /// @return The header, with the sizes and offsets of the arrays left at zero.
+    template<typename T, typename Vec2>
+    static Header MakeHeader()
+    {
+        using Frozen = FrozenQuadtree<T, Vec2>;
+        
+        Header header = {};
+        header.magic = {'Q', 'U', 'A', 'D', 'T', 'R', 'E', 'E'};
+        header.version = Version;
+        header.byteOrder = 0x01020304;
+        header.elementSize = static_cast<uint32_t>(sizeof(typename Frozen::Element));
+        header.nodeSize = static_cast<uint32_t>(sizeof(typename Frozen::Node));
+        header.simdWidth = static_cast<uint32_t>(QuadtreeDetail::SimdWidth);
+        header.scalarSize = static_cast<uint32_t>(sizeof(typename Frozen::Scalar));
+        header.scalarKind = std::is_floating_point_v<typename Frozen::Scalar> ? 2 : (std::is_unsigned_v<typename Frozen::Scalar> ? 1 : 0);
+        return header;
+    }
+    
+    /// Checks that every node of an image only refers to children, elements and coordinates within the image, since searches follow them without any bounds checks.
+    /// @tparam Node The type of node stored in the image.
+    /// @param header The header of the image, whose counts already fit within the file.
+    /// @param nodes The nodes of the image.
+    /// @return True if every node stays within the arrays described by the header.
+    template<typename Node>
+    static bool AreNodesValid(const Header& header, const Node* nodes)
+    {
+        for (uint64_t index = 0; index < header.nodeCount; ++index)
+        {
+            const Node& node = nodes[index];
+            if (static_cast<uint64_t>(node.elementOffset) + node.elementCount > header.elementCount)
+            {
+                return false;
+            }
+            
+            if (node.IsLeaf())
+            {
+                // The SIMD kernels read the coordinates of a leaf in whole blocks, including the padding after its last element.
+                uint64_t paddedCount = (static_cast<uint64_t>(node.elementCount) + QuadtreeDetail::SimdWidth - 1) / QuadtreeDetail::SimdWidth * QuadtreeDetail::SimdWidth;
+                if (static_cast<uint64_t>(node.positionOffset) + paddedCount > header.positionCount)
+                {
+                    return false;
+                }
+            }
+            else if (node.firstChild <= index || static_cast<uint64_t>(node.firstChild) + 4 > header.nodeCount)
+            {
+                // Children are laid out breadth-first after their parent, which also rules out cycles.
+                return false;
+            }
+        }
+        
+        return true;
+    }
+    
+    /// Rounds an offset up to the next section boundary.
+    /// @param offset The offset to round.
+    /// @return The aligned offset.
+    static uint64_t Align(uint64_t offset)
+    {
+        return (offset + SectionAlignment - 1) / SectionAlignment * SectionAlignment;
+    }
+};
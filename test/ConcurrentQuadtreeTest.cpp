@@ -0,0 +1,150 @@
+/// Copyright (c) 2025 Jose Ilitzky
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <glm/vec2.hpp>
+#include <gtest/gtest.h>
+#include "ConcurrentQuadtree.h"
+
+class ConcurrentQuadtreeTest : public ::testing::Test
+{
+protected:
+    using Tree = ConcurrentQuadtree<int, glm::vec2>;
+    
+    Tree tree = {{0, 0}, {100, 100}, 1};
+};
+
+TEST_F(ConcurrentQuadtreeTest, Insert)
+{
+    ASSERT_TRUE(tree.Insert(1, {25, 25}));
+    ASSERT_TRUE(tree.Insert(2, {60, 60}));
+    ASSERT_TRUE(tree.Insert(3, {90, 90}));
+    ASSERT_FALSE(tree.Insert(4, {101, 101}));
+    
+    //  __________ ___________
+    // |          |     |   3 |
+    // |          |_____|_____|
+    // |          | 2   |     |
+    // |__________|_____|_____|
+    // |          |           |
+    // |    1     |           |
+    // |          |           |
+    // |__________|___________|
+    
+    ASSERT_TRUE(tree.CountElements() == 3);
+    ASSERT_TRUE(tree.GetHeight() == 3);
+}
+
+TEST_F(ConcurrentQuadtreeTest, Remove)
+{
+    tree.Insert(1, {25, 25});
+    tree.Insert(2, {60, 60});
+    tree.Insert(3, {90, 90});
+    
+    ASSERT_FALSE(tree.Remove(3, {25, 25}));
+    ASSERT_TRUE(tree.Remove(3, {90, 90}));
+    ASSERT_TRUE(tree.CountElements() == 2);
+    ASSERT_TRUE(tree.GetHeight() == 2);
+    
+    ASSERT_TRUE(tree.Remove(2, {60, 60}));
+    ASSERT_TRUE(tree.CountElements() == 1);
+    ASSERT_TRUE(tree.GetHeight() == 1);
+}
+
+TEST_F(ConcurrentQuadtreeTest, FindNearest)
+{
+    tree.Insert(1, {25, 25});
+    tree.Insert(2, {60, 60});
+    tree.Insert(3, {90, 90});
+    
+    ASSERT_TRUE(tree.FindNearest({70, 70}).value().data == 2);
+    ASSERT_TRUE(tree.FindNearest({0, 0}).value().data == 1);
+    ASSERT_FALSE(tree.FindNearest({0, 0}, 10.0f).has_value());
+    
+    auto isOdd = [](const auto& element) { return element.data % 2 == 1; };
+    ASSERT_TRUE(tree.FindNearest({70, 70}, isOdd).value().data == 3);
+}
+
+TEST_F(ConcurrentQuadtreeTest, FindAll)
+{
+    tree.Insert(1, {25, 25});
+    tree.Insert(2, {60, 60});
+    tree.Insert(3, {90, 90});
+    
+    ASSERT_TRUE(tree.FindAll({50, 50}, {100, 100}).size() == 2);
+    ASSERT_TRUE(tree.FindAll({0, 0}, {100, 100}).size() == 3);
+    ASSERT_TRUE(tree.FindAll({0, 50}, {50, 100}).empty());
+    
+    tree.Clear();
+    ASSERT_TRUE(tree.CountElements() == 0);
+    ASSERT_TRUE(tree.GetHeight() == 1);
+}
+
+TEST_F(ConcurrentQuadtreeTest, Stress)
+{
+    // Fixed elements that every search must keep finding while writers churn the rest of the tree around them.
+    constexpr int FixedCount = 100;
+    for (int i = 0; i < FixedCount; ++i)
+    {
+        tree.Insert(i, {static_cast<float>((i * 37) % 100), static_cast<float>((i * 61) % 100)});
+    }
+    
+    constexpr int WriterCount = 3;
+    constexpr int ReaderCount = 3;
+    constexpr int Iterations = 2000;
+    std::atomic<bool> failed = false;
+    std::vector<std::thread> threads;
+    
+    for (int writer = 0; writer < WriterCount; ++writer)
+    {
+        threads.emplace_back([&, writer]()
+        {
+            for (int i = 0; i < Iterations; ++i)
+            {
+                int data = FixedCount + (writer * Iterations) + i;
+                glm::vec2 position = {static_cast<float>((data * 13) % 100), static_cast<float>((data * 29) % 100)};
+                if (!tree.Insert(data, position) || !tree.Remove(data, position))
+                {
+                    failed = true;
+                }
+                
+                if (i % 2 == 0)
+                {
+                    tree.Insert(data, position);
+                }
+            }
+        });
+    }
+    
+    for (int reader = 0; reader < ReaderCount; ++reader)
+    {
+        threads.emplace_back([&]()
+        {
+            for (int i = 0; i < Iterations; ++i)
+            {
+                int fixed = i % FixedCount;
+                glm::vec2 position = {static_cast<float>((fixed * 37) % 100), static_cast<float>((fixed * 61) % 100)};
+                auto nearest = tree.FindNearest(position);
+                if (!nearest || nearest->position != position)
+                {
+                    failed = true;
+                }
+                
+                auto isFixed = [&](const auto& element) { return element.data < FixedCount; };
+                if (tree.FindAll({0, 0}, {100, 100}, isFixed).size() != FixedCount)
+                {
+                    failed = true;
+                }
+            }
+        });
+    }
+    
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    
+    ASSERT_FALSE(failed);
+    ASSERT_TRUE(tree.CountElements() == FixedCount + (WriterCount * Iterations / 2));
+}
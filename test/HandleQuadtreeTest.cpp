@@ -0,0 +1,220 @@
+/// Copyright (c) 2025 Jose Ilitzky
+
+#include <algorithm>
+#include <optional>
+#include <string>
+#include <vector>
+#include <glm/vec2.hpp>
+#include <gtest/gtest.h>
+#include "HandleQuadtree.h"
+
+class HandleQuadtreeTest : public ::testing::Test
+{
+protected:
+    using Tree = HandleQuadtree<std::string, glm::vec2>;
+    
+    Tree tree = {{0, 0}, {100, 100}, 1};
+};
+
+TEST_F(HandleQuadtreeTest, Insert)
+{
+    auto handle = tree.Insert("one", {25, 25});
+    ASSERT_TRUE(handle.has_value());
+    ASSERT_TRUE(tree.CountElements() == 1);
+    ASSERT_TRUE(tree.Get(*handle)->data == "one");
+    ASSERT_TRUE(tree.Get(*handle)->position == glm::vec2(25, 25));
+    
+    auto outside = tree.Insert("outside", {101, 101});
+    ASSERT_FALSE(outside.has_value());
+    ASSERT_TRUE(tree.CountElements() == 1);
+}
+
+TEST_F(HandleQuadtreeTest, Remove)
+{
+    auto one = tree.Insert("one", {25, 25});
+    auto two = tree.Insert("two", {87, 87});
+    auto three = tree.Insert("three", {56, 68});
+    ASSERT_TRUE(tree.GetHeight() == 3);
+    
+    ASSERT_TRUE(tree.Remove(*three));
+    ASSERT_TRUE(tree.CountElements() == 2);
+    ASSERT_TRUE(tree.GetHeight() == 2);
+    
+    // Handles to removed elements are no longer valid, even after their slot is reused.
+    ASSERT_FALSE(tree.Remove(*three));
+    ASSERT_FALSE(tree.Get(*three).has_value());
+    auto four = tree.Insert("four", {56, 68});
+    ASSERT_TRUE(four->index == three->index);
+    ASSERT_FALSE(tree.Get(*three).has_value());
+    ASSERT_TRUE(tree.Get(*four)->data == "four");
+    
+    ASSERT_TRUE(tree.Remove(*one));
+    ASSERT_TRUE(tree.Remove(*two));
+    ASSERT_TRUE(tree.Remove(*four));
+    ASSERT_TRUE(tree.CountElements() == 0);
+    ASSERT_TRUE(tree.GetHeight() == 1);
+}
+
+TEST_F(HandleQuadtreeTest, Update)
+{
+    auto one = tree.Insert("one", {25, 25});
+    auto two = tree.Insert("two", {87, 87});
+    
+    ASSERT_TRUE(tree.Update(*one, {80, 80}));
+    ASSERT_TRUE(tree.Get(*one)->position == glm::vec2(80, 80));
+    ASSERT_TRUE(*tree.FindNearest({75, 75}) == *one);
+    ASSERT_FALSE(tree.Update(*one, {101, 101}));
+    
+    ASSERT_TRUE(tree.Remove(*two));
+    ASSERT_FALSE(tree.Update(*two, {50, 50}));
+}
+
+TEST_F(HandleQuadtreeTest, Update_InPlace)
+{
+    auto one = tree.Insert("one", {25, 25});
+    auto two = tree.Insert("two", {87, 87});
+    auto three = tree.Insert("three", {56, 68});
+    ASSERT_TRUE(tree.GetHeight() == 3);
+    
+    // Moving within a leaf leaves the structure alone.
+    ASSERT_TRUE(tree.Update(*three, {60, 70}));
+    ASSERT_TRUE(tree.GetHeight() == 3);
+    ASSERT_TRUE(tree.Get(*three)->position == glm::vec2(60, 70));
+    ASSERT_TRUE(*tree.FindNearest({62, 72}) == *three);
+    
+    // A leaf's maximum edge belongs to its neighbour, so moving onto it leaves the leaf.
+    ASSERT_TRUE(tree.Update(*one, {50, 25}));
+    ASSERT_TRUE(tree.FindAll({50, 0}, {100, 50}).size() == 1);
+    ASSERT_TRUE(tree.Remove(*one));
+    ASSERT_TRUE(tree.Remove(*three));
+    ASSERT_TRUE(tree.Get(*two)->position == glm::vec2(87, 87));
+    ASSERT_TRUE(tree.GetHeight() == 1);
+}
+
+TEST_F(HandleQuadtreeTest, Update_AcrossLeaves)
+{
+    auto one = tree.Insert("one", {25, 25});
+    auto two = tree.Insert("two", {87, 87});
+    auto three = tree.Insert("three", {56, 68});
+    
+    // Moving next to another element subdivides its leaf, and the vacated branch merges back.
+    ASSERT_TRUE(tree.Update(*one, {20, 80}));
+    ASSERT_TRUE(tree.Update(*three, {22, 82}));
+    ASSERT_TRUE(tree.Get(*one)->position == glm::vec2(20, 80));
+    ASSERT_TRUE(tree.Get(*three)->position == glm::vec2(22, 82));
+    ASSERT_TRUE(*tree.FindNearest({23, 83}) == *three);
+    
+    ASSERT_TRUE(tree.Remove(*one));
+    ASSERT_TRUE(tree.Remove(*three));
+    ASSERT_TRUE(tree.Remove(*two));
+    ASSERT_TRUE(tree.CountElements() == 0);
+    ASSERT_TRUE(tree.GetHeight() == 1);
+}
+
+TEST_F(HandleQuadtreeTest, Handles_Many)
+{
+    Tree large = {{0, 0}, {100, 100}, 4, 6};
+    std::vector<std::optional<QuadtreeHandle>> handles;
+    std::vector<glm::vec2> positions;
+    for (int i = 0; i < 300; ++i)
+    {
+        positions.push_back({static_cast<float>((i * 37) % 100), static_cast<float>((i * 61) % 100)});
+        handles.push_back(large.Insert(std::to_string(i), positions.back()));
+    }
+    
+    // Interleave moves and removals so that leaves keep subdividing and merging under the handles.
+    for (int i = 0; i < 300; ++i)
+    {
+        if (i % 3 == 0)
+        {
+            ASSERT_TRUE(large.Remove(*handles[i]));
+            handles[i].reset();
+            continue;
+        }
+        
+        positions[i] = {static_cast<float>((i * 13) % 100), static_cast<float>((i * 29) % 100)};
+        ASSERT_TRUE(large.Update(*handles[i], positions[i]));
+    }
+    
+    ASSERT_TRUE(large.CountElements() == 200);
+    for (int i = 0; i < 300; ++i)
+    {
+        if (handles[i])
+        {
+            auto element = large.Get(*handles[i]);
+            ASSERT_TRUE(element->data == std::to_string(i));
+            ASSERT_TRUE(element->position == positions[i]);
+            
+            auto found = large.FindAll(positions[i], positions[i]);
+            ASSERT_TRUE(std::find(found.begin(), found.end(), *handles[i]) != found.end());
+        }
+    }
+    
+    for (int i = 0; i < 300; ++i)
+    {
+        if (handles[i])
+        {
+            ASSERT_TRUE(large.Remove(*handles[i]));
+        }
+    }
+    ASSERT_TRUE(large.CountElements() == 0);
+    ASSERT_TRUE(large.GetHeight() == 1);
+}
+
+TEST_F(HandleQuadtreeTest, Move)
+{
+    auto one = tree.Insert("one", {25, 25});
+    
+    Tree moved = std::move(tree);
+    ASSERT_TRUE(moved.Get(*one)->data == "one");
+    ASSERT_TRUE(moved.Update(*one, {30, 30}));
+    ASSERT_TRUE(moved.Remove(*one));
+    ASSERT_TRUE(moved.CountElements() == 0);
+}
+
+TEST_F(HandleQuadtreeTest, GetData)
+{
+    auto one = tree.Insert("one", {25, 25});
+    *tree.GetData(*one) = "uno";
+    ASSERT_TRUE(tree.Get(*one)->data == "uno");
+}
+
+TEST_F(HandleQuadtreeTest, FindNearest)
+{
+    tree.Insert("a", {25, 25});
+    auto b = tree.Insert("bb", {87, 87});
+    auto c = tree.Insert("ccc", {87, 68});
+    
+    ASSERT_TRUE(*tree.FindNearest({75, 75}) == *c);
+    
+    auto isEven = [](const auto& element) { return element.data.size() % 2 == 0; };
+    ASSERT_TRUE(*tree.FindNearest({75, 75}, isEven) == *b);
+}
+
+TEST_F(HandleQuadtreeTest, FindAll)
+{
+    tree.Insert("a", {25, 25});
+    auto b = tree.Insert("bb", {87, 87});
+    auto c = tree.Insert("ccc", {87, 68});
+    
+    auto handles = tree.FindAll({50, 50}, {100, 100});
+    ASSERT_TRUE(handles.size() == 2);
+    
+    auto isOdd = [](const auto& element) { return element.data.size() % 2 == 1; };
+    handles = tree.FindAll({50, 50}, {100, 100}, isOdd);
+    ASSERT_TRUE(handles.size() == 1);
+    ASSERT_TRUE(handles[0] == *c);
+    ASSERT_TRUE(handles[0] != *b);
+}
+
+TEST_F(HandleQuadtreeTest, Clear)
+{
+    auto one = tree.Insert("one", {25, 25});
+    tree.Insert("two", {87, 87});
+    tree.Clear();
+    
+    ASSERT_TRUE(tree.CountElements() == 0);
+    ASSERT_FALSE(tree.Get(*one).has_value());
+    ASSERT_TRUE(tree.Insert("three", {50, 50}).has_value());
+    ASSERT_TRUE(tree.CountElements() == 1);
+}
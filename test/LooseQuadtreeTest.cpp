@@ -0,0 +1,169 @@
+/// Copyright (c) 2025 Jose Ilitzky
+
+#include <vector>
+#include <glm/vec2.hpp>
+#include <gtest/gtest.h>
+#include "LooseQuadtree.h"
+
+class LooseQuadtreeTest : public ::testing::Test
+{
+protected:
+    using Tree = LooseQuadtree<int, glm::vec2>;
+    
+    Tree tree = {{0, 0}, {100, 100}, 1};
+    
+    bool ContainsData(const std::vector<Tree::Element>& elements, int data)
+    {
+        for (const auto& element : elements)
+        {
+            if (element.data == data)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+TEST_F(LooseQuadtreeTest, Insert)
+{
+    ASSERT_TRUE(tree.Insert(1, {{20, 20}, {30, 30}}));
+    ASSERT_TRUE(tree.Insert(2, {{45, 45}, {55, 55}}));
+    ASSERT_TRUE(tree.Insert(3, {{80, 80}, {90, 90}}));
+    
+    // The loose bounds of the root reach half its size past every edge.
+    ASSERT_TRUE(tree.Insert(4, {{-40, -40}, {-30, -30}}));
+    ASSERT_FALSE(tree.Insert(5, {{-60, -60}, {-30, -30}}));
+    
+    //  ______________________
+    // |          |        _  |
+    // |          |       |3| |
+    // |         _|_      |_| |
+    // |________|_2_|_________|
+    // |        |_|_|         |
+    // |   _      |           |
+    // |  |1|     |           |
+    // |__|_|_____|___________|
+    //  4
+    
+    // Element 2 straddles the center, but it still fits within the loose bounds of a child.
+    ASSERT_TRUE(tree.CountElements() == 4);
+    ASSERT_TRUE(tree.GetHeight() == 3);
+}
+
+TEST_F(LooseQuadtreeTest, Insert_Strict)
+{
+    Tree strict = {{0, 0}, {100, 100}, 1, 4, 1.0f};
+    ASSERT_TRUE(strict.GetLooseness() == 1.0f);
+    ASSERT_TRUE(strict.Insert(1, {{20, 20}, {30, 30}}));
+    ASSERT_TRUE(strict.Insert(2, {{45, 45}, {55, 55}}));
+    ASSERT_FALSE(strict.Insert(3, {{-10, -10}, {10, 10}}));
+    
+    // Without looseness, the element on the center stays in the root and only the other one descends.
+    ASSERT_TRUE(strict.CountElements() == 2);
+    ASSERT_TRUE(strict.GetHeight() == 2);
+    ASSERT_TRUE(strict.FindOverlapping({{50, 50}, {50, 50}}).size() == 1);
+}
+
+TEST_F(LooseQuadtreeTest, Remove)
+{
+    tree.Insert(1, {{20, 20}, {30, 30}});
+    tree.Insert(2, {{45, 45}, {55, 55}});
+    tree.Insert(3, {{80, 80}, {90, 90}});
+    
+    ASSERT_FALSE(tree.Remove(3, {{20, 20}, {30, 30}}));
+    ASSERT_FALSE(tree.Remove(3, {{80, 80}, {91, 91}}));
+    ASSERT_TRUE(tree.Remove(3, {{80, 80}, {90, 90}}));
+    ASSERT_TRUE(tree.CountElements() == 2);
+    
+    ASSERT_TRUE(tree.Remove(2, {{45, 45}, {55, 55}}));
+    ASSERT_TRUE(tree.CountElements() == 1);
+    ASSERT_TRUE(tree.GetHeight() == 1);
+    
+    ASSERT_TRUE(tree.Remove(1, {{20, 20}, {30, 30}}));
+    ASSERT_TRUE(tree.CountElements() == 0);
+}
+
+TEST_F(LooseQuadtreeTest, FindOverlapping)
+{
+    tree.Insert(1, {{20, 20}, {30, 30}});
+    tree.Insert(2, {{45, 45}, {55, 55}});
+    tree.Insert(3, {{80, 80}, {90, 90}});
+    tree.Insert(4, {{5, 60}, {40, 95}});
+    
+    //  ______________________
+    // |  ______  |        _  |
+    // | |      | |       |3| |
+    // | |  4  _|_|_      |_| |
+    // |_|____|_|_2_|_________|
+    // |        |_|_|         |
+    // |   _      |           |
+    // |  |1|     |           |
+    // |__|_|_____|___________|
+    
+    // Boxes are found when they overlap the area, even if their centers are outside of it.
+    auto elements = tree.FindOverlapping({{35, 35}, {50, 50}});
+    ASSERT_TRUE(elements.size() == 1);
+    ASSERT_TRUE(ContainsData(elements, 2));
+    
+    elements = tree.FindOverlapping({{38, 58}, {60, 70}});
+    ASSERT_TRUE(elements.size() == 1);
+    ASSERT_TRUE(ContainsData(elements, 4));
+    
+    // Boxes that only touch the area count as overlapping.
+    elements = tree.FindOverlapping({{30, 30}, {45, 45}});
+    ASSERT_TRUE(elements.size() == 2);
+    ASSERT_TRUE(ContainsData(elements, 1));
+    ASSERT_TRUE(ContainsData(elements, 2));
+    
+    ASSERT_TRUE(tree.FindOverlapping({{0, 0}, {100, 100}}).size() == 4);
+    ASSERT_TRUE(tree.FindOverlapping({{60, 5}, {95, 40}}).empty());
+    
+    auto isOdd = [](const auto& element) { return element.data % 2 == 1; };
+    elements = tree.FindOverlapping({{0, 0}, {100, 100}}, isOdd);
+    ASSERT_TRUE(elements.size() == 2);
+    ASSERT_TRUE(ContainsData(elements, 1));
+    ASSERT_TRUE(ContainsData(elements, 3));
+    
+    tree.Clear();
+    ASSERT_TRUE(tree.CountElements() == 0);
+    ASSERT_TRUE(tree.FindOverlapping({{0, 0}, {100, 100}}).empty());
+}
+
+TEST_F(LooseQuadtreeTest, FindOverlapping_Many)
+{
+    Tree large = {{0, 0}, {100, 100}, 4, 5};
+    std::vector<Tree::Element> elements;
+    for (int i = 0; i < 400; ++i)
+    {
+        float x = static_cast<float>((i * 37) % 100);
+        float y = static_cast<float>((i * 61) % 100);
+        float size = static_cast<float>(i % 7) + 0.5f;
+        Tree::Element element = {i, {{x, y}, {std::min(x + size, 100.0f), std::min(y + size, 100.0f)}}};
+        ASSERT_TRUE(large.Insert(element.data, element.bounds));
+        elements.push_back(element);
+    }
+    
+    // Every search must match a linear scan of all the boxes.
+    for (int i = 0; i < 100; ++i)
+    {
+        glm::vec2 min = {static_cast<float>((i * 13) % 90), static_cast<float>((i * 29) % 90)};
+        Tree::Bounds searchArea(min, {min.x + 9, min.y + 4});
+        
+        size_t expected = 0;
+        for (const auto& element : elements)
+        {
+            expected += element.bounds.Intersects(searchArea);
+        }
+        
+        ASSERT_TRUE(large.FindOverlapping(searchArea).size() == expected);
+    }
+    
+    for (const auto& element : elements)
+    {
+        ASSERT_TRUE(large.Remove(element.data, element.bounds));
+    }
+    
+    ASSERT_TRUE(large.CountElements() == 0);
+    ASSERT_TRUE(large.GetHeight() == 1);
+}
@@ -0,0 +1,145 @@
+/// Copyright (c) 2025 Jose Ilitzky
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <glm/vec2.hpp>
+#include <gtest/gtest.h>
+#include "QuadtreeSnapshot.h"
+
+class QuadtreeSnapshotTest : public ::testing::Test
+{
+protected:
+    using Tree = Quadtree<int, glm::vec2>;
+    using Frozen = FrozenQuadtree<int, glm::vec2>;
+    
+    Tree tree = {{0, 0}, {100, 100}, 1};
+    
+    std::string path = ::testing::TempDir() + "QuadtreeSnapshotTest.bin";
+    
+    void SetUp() override
+    {
+        tree.Insert(1, {25, 25});
+        tree.Insert(2, {87, 87});
+        tree.Insert(3, {87, 68});
+        tree.Insert(4, {56, 56});
+        tree.Insert(5, {56, 68});
+        tree.Insert(6, {68, 68});
+        
+        //  __________ ___________
+        // |          |     |  2  |
+        // |          |_____|_____|
+        // |          |_5|_6|  3  |
+        // |__________|_4|__|_____|
+        // |          |           |
+        // |    1     |           |
+        // |          |           |
+        // |__________|___________|
+    }
+    
+    void TearDown() override
+    {
+        std::remove(path.c_str());
+    }
+};
+
+TEST_F(QuadtreeSnapshotTest, RoundTrip)
+{
+    ASSERT_TRUE(QuadtreeSnapshot::Save(tree, path));
+    
+    std::optional<Frozen> mapped = QuadtreeSnapshot::LoadMapped<int, glm::vec2>(path);
+    ASSERT_TRUE(mapped.has_value());
+    ASSERT_TRUE(mapped->CountElements() == tree.CountElements());
+    ASSERT_TRUE(mapped->GetHeight() == tree.GetHeight());
+    
+    ASSERT_TRUE(mapped->FindNearest({75, 75}).value().data == 6);
+    ASSERT_TRUE(mapped->FindNearest({0, 0}).value().data == 1);
+    ASSERT_FALSE(mapped->FindNearest({75, 75}, 5.0f).has_value());
+    
+    auto isOdd = [](const auto& element) { return element.data % 2 == 1; };
+    ASSERT_TRUE(mapped->FindNearest({75, 75}, isOdd).value().data == 3);
+    
+    ASSERT_TRUE(mapped->FindAll({50, 50}, {100, 100}).size() == 5);
+    ASSERT_TRUE(mapped->FindAll({0, 0}, {100, 100}).size() == 6);
+    ASSERT_TRUE(mapped->FindAll({0, 50}, {50, 100}).empty());
+}
+
+TEST_F(QuadtreeSnapshotTest, CopyOutlivesOriginal)
+{
+    ASSERT_TRUE(QuadtreeSnapshot::Save(tree, path));
+    
+    std::optional<Frozen> copy;
+    {
+        std::optional<Frozen> mapped = QuadtreeSnapshot::LoadMapped<int, glm::vec2>(path);
+        ASSERT_TRUE(mapped.has_value());
+        copy = *mapped;
+    }
+    
+    // The copy shares the mapping, so the file stays mapped after the original is gone.
+    ASSERT_TRUE(copy->CountElements() == 6);
+    ASSERT_TRUE(copy->FindNearest({75, 75}).value().data == 6);
+}
+
+TEST_F(QuadtreeSnapshotTest, LoadMapped_Invalid)
+{
+    ASSERT_FALSE((QuadtreeSnapshot::LoadMapped<int, glm::vec2>(path).has_value()));
+    
+    {
+        std::ofstream stream(path, std::ios::binary);
+        stream << "QUADTREE but not really";
+    }
+    ASSERT_FALSE((QuadtreeSnapshot::LoadMapped<int, glm::vec2>(path).has_value()));
+    
+    // An image saved for a different element type is rejected.
+    ASSERT_TRUE(QuadtreeSnapshot::Save(tree, path));
+    ASSERT_FALSE((QuadtreeSnapshot::LoadMapped<double, glm::vec2>(path).has_value()));
+    
+    // A truncated image is rejected.
+    std::string truncatedPath = path + ".truncated";
+    {
+        std::ifstream input(path, std::ios::binary);
+        std::string image((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+        std::ofstream output(truncatedPath, std::ios::binary);
+        output.write(image.data(), static_cast<std::streamsize>(image.size() / 2));
+    }
+    ASSERT_FALSE((QuadtreeSnapshot::LoadMapped<int, glm::vec2>(truncatedPath).has_value()));
+    std::remove(truncatedPath.c_str());
+}
+
+TEST_F(QuadtreeSnapshotTest, LoadMapped_CorruptedNode)
+{
+    ASSERT_TRUE(QuadtreeSnapshot::Save(tree, path));
+    
+    std::string image;
+    {
+        std::ifstream input(path, std::ios::binary);
+        image.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+    }
+    
+    // The root node starts with its bounds, followed by the index of its first child and the range of its elements.
+    const float rootBounds[] = {0, 0, 100, 100};
+    size_t rootOffset = image.find(std::string(reinterpret_cast<const char*>(rootBounds), sizeof(rootBounds)));
+    ASSERT_TRUE(rootOffset != std::string::npos);
+    
+    auto loadCorrupted = [&](size_t fieldOffset, uint32_t value)
+    {
+        std::string corrupted = image;
+        corrupted.replace(rootOffset + sizeof(rootBounds) + fieldOffset, sizeof(value), reinterpret_cast<const char*>(&value), sizeof(value));
+        
+        std::ofstream output(path, std::ios::binary | std::ios::trunc);
+        output.write(corrupted.data(), static_cast<std::streamsize>(corrupted.size()));
+        output.close();
+        return QuadtreeSnapshot::LoadMapped<int, glm::vec2>(path);
+    };
+    
+    // Rewriting the index the root already has keeps the image valid.
+    ASSERT_TRUE(loadCorrupted(0, 1).has_value());
+    
+    // Children past the end of the node array are rejected.
+    ASSERT_FALSE(loadCorrupted(0, 1000).has_value());
+    
+    // Elements past the end of the element array are rejected.
+    ASSERT_FALSE(loadCorrupted(8, 1000).has_value());
+}
@@ -1,6 +1,12 @@
 /// Copyright (c) 2025 Jose Ilitzky
 
+#include <algorithm>
+#include <array>
+#include <iterator>
+#include <limits>
+#include <mutex>
 #include <optional>
+#include <string>
 #include <vector>
 #include <glm/vec2.hpp>
 #include <gtest/gtest.h>
@@ -8,9 +14,9 @@
 
 class QuadtreeTest : public ::testing::Test
 {
+protected:
     using Tree = Quadtree<int, glm::vec2>;
     
-protected:
     Tree tree = {{0, 0}, {100, 100}, 1};
     
     bool ContainsData(const std::vector<Tree::Element>& elements, int data)
@@ -207,6 +213,63 @@ TEST_F(QuadtreeTest, Remove_NotFound)
     ASSERT_FALSE(removed);
 }
 
+TEST_F(QuadtreeTest, Remove_MergeThreshold)
+{
+    tree.SetMergeThreshold(0);
+    tree.Insert(1, {25, 25});
+    tree.Insert(2, {87, 87});
+    tree.Insert(3, {56, 68});
+    tree.Insert(4, {68, 56});
+    
+    //  __________ ___________
+    // |          |     |  2  |
+    // |          |_____|_____|
+    // |          |_3|__|     |
+    // |__________|__|4_|_____|
+    // |          |           |
+    // |    1     |           |
+    // |          |           |
+    // |__________|___________|
+    
+    ASSERT_TRUE(tree.Remove(4, {68, 56}));
+    ASSERT_TRUE(tree.CountElements() == 3);
+    ASSERT_TRUE(tree.GetHeight() == 4);
+    
+    ASSERT_TRUE(tree.Remove(3, {56, 68}));
+    ASSERT_TRUE(tree.CountElements() == 2);
+    ASSERT_TRUE(tree.GetHeight() == 3);
+}
+
+TEST_F(QuadtreeTest, Remove_LazyMerge)
+{
+    tree.SetLazyMerge(true);
+    tree.Insert(1, {25, 25});
+    tree.Insert(2, {87, 87});
+    tree.Insert(3, {56, 68});
+    tree.Insert(4, {68, 56});
+    
+    ASSERT_TRUE(tree.Remove(4, {68, 56}));
+    ASSERT_TRUE(tree.Remove(3, {56, 68}));
+    ASSERT_TRUE(tree.CountElements() == 2);
+    ASSERT_TRUE(tree.GetHeight() == 4);
+    
+    tree.Compact();
+    
+    //  __________ ___________
+    // |          |        2  |
+    // |          |           |
+    // |          |           |
+    // |__________|___________|
+    // |          |           |
+    // |    1     |           |
+    // |          |           |
+    // |__________|___________|
+    
+    ASSERT_TRUE(tree.CountElements() == 2);
+    ASSERT_TRUE(tree.GetHeight() == 2);
+    ASSERT_TRUE(tree.FindNearest({80, 80}).value().data == 2);
+}
+
 TEST_F(QuadtreeTest, FindAll)
 {
     tree.Insert(1, {25, 25});
@@ -326,3 +389,1322 @@ TEST_F(QuadtreeTest, FindNearest_OutOfBounds)
     ASSERT_TRUE(nearest.has_value());
 }
 
+
+TEST_F(QuadtreeTest, Clear)
+{
+    tree.Insert(1, {25, 25});
+    tree.Insert(2, {87, 87});
+    tree.Insert(3, {56, 68});
+    tree.Insert(4, {68, 56});
+    ASSERT_TRUE(tree.GetHeight() == 4);
+    
+    tree.Clear();
+    ASSERT_TRUE(tree.CountElements() == 0);
+    ASSERT_TRUE(tree.GetHeight() == 1);
+    
+    tree.Insert(1, {25, 25});
+    tree.Insert(2, {87, 87});
+    ASSERT_TRUE(tree.CountElements() == 2);
+    ASSERT_TRUE(tree.GetHeight() == 2);
+    ASSERT_TRUE(tree.FindNearest({75, 75}).value().data == 2);
+}
+
+TEST_F(QuadtreeTest, Move)
+{
+    tree.Insert(1, {25, 25});
+    tree.Insert(2, {87, 87});
+    tree.Insert(3, {56, 68});
+    
+    auto other = std::move(tree);
+    ASSERT_TRUE(other.CountElements() == 3);
+    ASSERT_TRUE(other.GetHeight() == 3);
+    
+    other.Insert(4, {68, 56});
+    ASSERT_TRUE(other.CountElements() == 4);
+    ASSERT_TRUE(other.Remove(3, {56, 68}));
+    ASSERT_TRUE(other.GetHeight() == 3);
+}
+
+TEST(QuadtreeAllocatorTest, HeapAllocator)
+{
+    Quadtree<int, glm::vec2, QuadtreeHeapAllocator> tree = {{0, 0}, {100, 100}, 1};
+    tree.Insert(1, {25, 25});
+    tree.Insert(2, {87, 87});
+    tree.Insert(3, {56, 68});
+    tree.Insert(4, {68, 56});
+    ASSERT_TRUE(tree.GetHeight() == 4);
+    
+    ASSERT_TRUE(tree.Remove(4, {68, 56}));
+    ASSERT_TRUE(tree.Remove(3, {56, 68}));
+    ASSERT_TRUE(tree.CountElements() == 2);
+    ASSERT_TRUE(tree.GetHeight() == 2);
+}
+
+TEST_F(QuadtreeTest, Freeze)
+{
+    tree.Insert(1, {25, 25});
+    tree.Insert(2, {87, 87});
+    tree.Insert(3, {87, 68});
+    tree.Insert(4, {56, 56});
+    tree.Insert(5, {56, 68});
+    tree.Insert(6, {68, 68});
+    
+    auto frozen = tree.Freeze();
+    ASSERT_TRUE(frozen.CountElements() == tree.CountElements());
+    ASSERT_TRUE(frozen.GetHeight() == tree.GetHeight());
+    
+    // Changes to the tree don't affect the snapshot.
+    tree.Remove(6, {68, 68});
+    ASSERT_TRUE(frozen.CountElements() == 6);
+}
+
+TEST_F(QuadtreeTest, Freeze_FindNearest)
+{
+    tree.Insert(1, {25, 25});
+    tree.Insert(2, {87, 87});
+    tree.Insert(3, {87, 68});
+    tree.Insert(4, {56, 56});
+    tree.Insert(5, {56, 68});
+    tree.Insert(6, {68, 68});
+    
+    //  __________ ___________
+    // |          |     |  2  |
+    // |          |_____|x____|
+    // |          |_5|_6|  3  |
+    // |__________|_4|__|_____|
+    // |          |           |
+    // |    1     |           |
+    // |          |           |
+    // |__________|___________|
+    
+    auto frozen = tree.Freeze();
+    ASSERT_TRUE(frozen.FindNearest({75, 75}).value().data == 6);
+    
+    auto isOdd = [](const auto& element) { return element.data % 2 == 1; };
+    ASSERT_TRUE(frozen.FindNearest({75, 75}, isOdd).value().data == 3);
+    ASSERT_FALSE(frozen.FindNearest({75, 75}, 5.0f).has_value());
+}
+
+TEST_F(QuadtreeTest, Freeze_FindAll)
+{
+    tree.Insert(1, {25, 25});
+    tree.Insert(2, {87, 87});
+    tree.Insert(3, {87, 68});
+    tree.Insert(4, {56, 56});
+    tree.Insert(5, {56, 68});
+    tree.Insert(6, {68, 68});
+    
+    //  __________ ___________
+    // |        ..|.....|. 2  |
+    // |        . |_____|.____|
+    // |        . |_5|_6|. 3  |
+    // |________._|_4|__|.____|
+    // |        ..|.......    |
+    // |    1     |           |
+    // |          |           |
+    // |__________|___________|
+    
+    auto frozen = tree.Freeze();
+    auto elements = frozen.FindAll({40, 38}, {75, 88});
+    ASSERT_TRUE(elements.size() == 3);
+    ASSERT_TRUE(ContainsData(elements, 4));
+    ASSERT_TRUE(ContainsData(elements, 5));
+    ASSERT_TRUE(ContainsData(elements, 6));
+    
+    auto isEven = [](const auto& element) { return element.data % 2 == 0; };
+    elements = frozen.FindAll({40, 38}, {75, 88}, isEven);
+    ASSERT_TRUE(elements.size() == 2);
+    ASSERT_TRUE(ContainsData(elements, 4));
+    ASSERT_TRUE(ContainsData(elements, 6));
+    
+    ASSERT_TRUE(frozen.FindAll({0, 0}, {100, 100}).size() == 6);
+}
+
+TEST_F(QuadtreeTest, Freeze_Empty)
+{
+    auto frozen = tree.Freeze();
+    ASSERT_TRUE(frozen.CountElements() == 0);
+    ASSERT_TRUE(frozen.GetHeight() == 1);
+    ASSERT_FALSE(frozen.FindNearest({50, 50}).has_value());
+    ASSERT_TRUE(frozen.FindAll({0, 0}, {100, 100}).empty());
+}
+
+TEST_F(QuadtreeTest, Build)
+{
+    std::vector<Tree::Element> elements = {{1, {25, 25}}, {2, {87, 87}}, {3, {56, 68}}, {4, {68, 56}}, {5, {101, 101}}};
+    size_t inserted = tree.Build(elements.begin(), elements.end());
+    
+    //  __________ ___________
+    // |          |     |  2  |
+    // |          |_____|_____|
+    // |          |_3|__|     |
+    // |__________|__|4_|_____|
+    // |          |           |
+    // |    1     |           |
+    // |          |           |
+    // |__________|___________|
+    
+    ASSERT_TRUE(inserted == 4);
+    ASSERT_TRUE(tree.CountElements() == 4);
+    ASSERT_TRUE(tree.GetHeight() == 4);
+    ASSERT_TRUE(tree.FindNearest({75, 75}).value().data == 2);
+    
+    ASSERT_TRUE(tree.Remove(4, {68, 56}));
+    ASSERT_TRUE(tree.GetHeight() == 3);
+}
+
+TEST_F(QuadtreeTest, Build_MatchesInsert)
+{
+    std::vector<Tree::Element> elements;
+    for (int i = 0; i < 200; ++i)
+    {
+        elements.push_back({i, {static_cast<float>((i * 37) % 100), static_cast<float>((i * 61) % 100)}});
+    }
+    
+    Tree inserted = {{0, 0}, {100, 100}, 4, 6};
+    for (const auto& element : elements)
+    {
+        inserted.Insert(element.data, element.position);
+    }
+    
+    Tree built = {{0, 0}, {100, 100}, elements.begin(), elements.end(), 4, 6};
+    ASSERT_TRUE(built.CountElements() == inserted.CountElements());
+    ASSERT_TRUE(built.GetHeight() == inserted.GetHeight());
+    ASSERT_TRUE(built.FindAll({20, 30}, {70, 90}).size() == inserted.FindAll({20, 30}, {70, 90}).size());
+    
+    for (const auto& element : elements)
+    {
+        ASSERT_TRUE(built.Remove(element.data, element.position));
+    }
+    ASSERT_TRUE(built.CountElements() == 0);
+    ASSERT_TRUE(built.GetHeight() == 1);
+}
+
+TEST_F(QuadtreeTest, Build_CopiesUnlessMoved)
+{
+    using StringTree = Quadtree<std::string, glm::vec2>;
+    std::vector<StringTree::Element> elements = {{"first", {25, 25}}, {"second", {75, 75}}};
+    
+    StringTree copied = {{0, 0}, {100, 100}, elements.begin(), elements.end()};
+    ASSERT_TRUE(copied.CountElements() == 2);
+    ASSERT_TRUE(elements[0].data == "first");
+    ASSERT_TRUE(elements[1].data == "second");
+    
+    StringTree moved = {{0, 0}, {100, 100}, std::make_move_iterator(elements.begin()), std::make_move_iterator(elements.end())};
+    ASSERT_TRUE(moved.CountElements() == 2);
+    ASSERT_TRUE(moved.FindNearest({80, 80}).value().data == "second");
+}
+
+TEST_F(QuadtreeTest, InsertBatch)
+{
+    tree.Insert(1, {25, 25});
+    
+    std::vector<Tree::Element> elements = {{2, {87, 87}}, {3, {56, 68}}, {4, {68, 56}}, {5, {101, 101}}};
+    size_t inserted = tree.InsertBatch(elements.begin(), elements.end());
+    
+    //  __________ ___________
+    // |          |     |  2  |
+    // |          |_____|_____|
+    // |          |_3|__|     |
+    // |__________|__|4_|_____|
+    // |          |           |
+    // |    1     |           |
+    // |          |           |
+    // |__________|___________|
+    
+    ASSERT_TRUE(inserted == 3);
+    ASSERT_TRUE(tree.CountElements() == 4);
+    ASSERT_TRUE(tree.GetHeight() == 4);
+    ASSERT_TRUE(tree.FindNearest({75, 75}).value().data == 2);
+    ASSERT_TRUE(tree.FindNearest({0, 0}).value().data == 1);
+    
+    ASSERT_TRUE(tree.Remove(4, {68, 56}));
+    ASSERT_TRUE(tree.GetHeight() == 3);
+}
+
+TEST_F(QuadtreeTest, InsertBatch_MatchesInsert)
+{
+    std::vector<Tree::Element> elements;
+    for (int i = 0; i < 200; ++i)
+    {
+        elements.push_back({i, {static_cast<float>((i * 37) % 100), static_cast<float>((i * 61) % 100)}});
+    }
+    
+    Tree inserted = {{0, 0}, {100, 100}, 4, 6};
+    Tree batched = {{0, 0}, {100, 100}, 4, 6};
+    for (size_t i = 0; i < elements.size(); i += 50)
+    {
+        // Every batch lands on a tree that already has elements, including leaves that are about to overflow.
+        for (size_t j = i; j < i + 50; ++j)
+        {
+            inserted.Insert(elements[j].data, elements[j].position);
+        }
+        
+        ASSERT_TRUE(batched.InsertBatch(elements.begin() + i, elements.begin() + i + 50) == 50);
+        ASSERT_TRUE(batched.CountElements() == inserted.CountElements());
+        ASSERT_TRUE(batched.GetHeight() == inserted.GetHeight());
+        ASSERT_TRUE(batched.CountInArea({20, 30}, {70, 90}) == inserted.FindAll({20, 30}, {70, 90}).size());
+    }
+    
+    for (int i = 0; i < 100; ++i)
+    {
+        glm::vec2 target = {static_cast<float>((i * 13) % 101), static_cast<float>((i * 29) % 103)};
+        ASSERT_TRUE(batched.FindNearest(target).value().data == inserted.FindNearest(target).value().data);
+    }
+}
+
+TEST_F(QuadtreeTest, InsertBatch_CopiesUnlessMoved)
+{
+    using StringTree = Quadtree<std::string, glm::vec2>;
+    const std::vector<StringTree::Element> elements = {{"first", {25, 25}}, {"second", {75, 75}}};
+    
+    StringTree copied = {{0, 0}, {100, 100}};
+    ASSERT_TRUE(copied.InsertBatch(elements.begin(), elements.end()) == 2);
+    ASSERT_TRUE(elements[0].data == "first");
+    ASSERT_TRUE(elements[1].data == "second");
+    ASSERT_TRUE(copied.FindNearest({80, 80}).value().data == "second");
+    
+    std::vector<StringTree::Element> source = elements;
+    StringTree moved = {{0, 0}, {100, 100}};
+    ASSERT_TRUE(moved.InsertBatch(std::make_move_iterator(source.begin()), std::make_move_iterator(source.end())) == 2);
+    ASSERT_TRUE(moved.FindNearest({20, 20}).value().data == "first");
+    ASSERT_TRUE(moved.FindNearest({80, 80}).value().data == "second");
+}
+
+TEST_F(QuadtreeTest, RemoveBatch)
+{
+    Quadtree<int, glm::vec2, QuadtreePoolAllocator, QuadtreeStats> counted = {{0, 0}, {100, 100}, 4, 6};
+    std::vector<Tree::Element> elements;
+    for (int i = 0; i < 200; ++i)
+    {
+        elements.push_back({i, {static_cast<float>((i * 37) % 100), static_cast<float>((i * 61) % 100)}});
+        counted.Insert(elements.back().data, elements.back().position);
+    }
+    
+    // Elements that aren't in the tree are skipped.
+    std::vector<Tree::Element> batch(elements.begin(), elements.begin() + 100);
+    batch.push_back({1000, {50, 50}});
+    batch.push_back({1001, {150, 150}});
+    ASSERT_TRUE(counted.RemoveBatch(batch.begin(), batch.end()) == 100);
+    ASSERT_TRUE(counted.CountElements() == 100);
+    ASSERT_TRUE(counted.CountInArea({0, 0}, {100, 100}) == 100);
+    
+    for (int i = 0; i < 100; ++i)
+    {
+        ASSERT_FALSE(counted.Remove(elements[i].data, elements[i].position));
+        ASSERT_TRUE(counted.FindAll(elements[i + 100].position, elements[i + 100].position).size() == 1);
+    }
+    
+    // Emptying the tree in one batch merges its branches back into a single leaf.
+    counted.ResetCounters();
+    ASSERT_TRUE(counted.RemoveBatch(elements.begin() + 100, elements.end()) == 100);
+    ASSERT_TRUE(counted.CountElements() == 0);
+    ASSERT_TRUE(counted.GetHeight() == 1);
+    ASSERT_TRUE(counted.GetCounters().merges > 0);
+}
+
+TEST_F(QuadtreeTest, FindKNearest)
+{
+    tree.Insert(1, {25, 25});
+    tree.Insert(2, {87, 87});
+    tree.Insert(3, {87, 68});
+    tree.Insert(4, {56, 56});
+    tree.Insert(5, {56, 68});
+    tree.Insert(6, {68, 68});
+    
+    //  __________ ___________
+    // |          |     |  2  |
+    // |          |_____|x____|
+    // |          |_5|_6|  3  |
+    // |__________|_4|__|_____|
+    // |          |           |
+    // |    1     |           |
+    // |          |           |
+    // |__________|___________|
+    
+    std::vector<Tree::Element> nearest;
+    tree.FindKNearest({75, 75}, 3, nearest);
+    ASSERT_TRUE(nearest.size() == 3);
+    ASSERT_TRUE(nearest[0].data == 6);
+    ASSERT_TRUE(nearest[1].data == 3);
+    ASSERT_TRUE(nearest[2].data == 2);
+    
+    tree.FindKNearest({75, 75}, 10, nearest);
+    ASSERT_TRUE(nearest.size() == 6);
+    ASSERT_TRUE(nearest[5].data == 1);
+}
+
+TEST_F(QuadtreeTest, FindKNearest_Condition)
+{
+    tree.Insert(1, {25, 25});
+    tree.Insert(2, {87, 87});
+    tree.Insert(3, {87, 68});
+    tree.Insert(4, {56, 56});
+    tree.Insert(5, {56, 68});
+    tree.Insert(6, {68, 68});
+    
+    auto isOdd = [](const auto& element) { return element.data % 2 == 1; };
+    std::vector<Tree::Element> nearest;
+    tree.FindKNearest({75, 75}, 2, nearest, isOdd);
+    ASSERT_TRUE(nearest.size() == 2);
+    ASSERT_TRUE(nearest[0].data == 3);
+    ASSERT_TRUE(nearest[1].data == 5);
+}
+
+TEST_F(QuadtreeTest, FindKNearest_Radius)
+{
+    tree.Insert(1, {25, 25});
+    tree.Insert(2, {87, 87});
+    tree.Insert(3, {87, 68});
+    tree.Insert(4, {56, 56});
+    tree.Insert(5, {56, 68});
+    tree.Insert(6, {68, 68});
+    
+    std::vector<Tree::Element> nearest;
+    tree.FindKNearest({75, 75}, 5, nearest, 15.0f);
+    ASSERT_TRUE(nearest.size() == 2);
+    ASSERT_TRUE(nearest[0].data == 6);
+    ASSERT_TRUE(nearest[1].data == 3);
+    
+    tree.FindKNearest({75, 75}, 0, nearest);
+    ASSERT_TRUE(nearest.empty());
+}
+
+TEST_F(QuadtreeTest, FindKNearest_NestedSearch)
+{
+    tree.Insert(1, {25, 25});
+    tree.Insert(2, {87, 87});
+    tree.Insert(3, {87, 68});
+    tree.Insert(4, {56, 56});
+    
+    // A filter that runs its own search while the outer one is still collecting elements.
+    std::vector<Tree::Element> inner;
+    auto hasNeighbor = [&](const auto& element)
+    {
+        tree.FindKNearest(element.position, 2, inner);
+        return inner.size() == 2;
+    };
+    
+    std::vector<Tree::Element> nearest;
+    tree.FindKNearest({75, 75}, 3, nearest, hasNeighbor);
+    ASSERT_TRUE(nearest.size() == 3);
+    ASSERT_TRUE(nearest[0].data == 3);
+    ASSERT_TRUE(nearest[1].data == 2);
+    ASSERT_TRUE(nearest[2].data == 4);
+}
+
+TEST_F(QuadtreeTest, NearestRange)
+{
+    tree.Insert(1, {25, 25});
+    tree.Insert(2, {87, 87});
+    tree.Insert(3, {87, 68});
+    tree.Insert(4, {56, 56});
+    tree.Insert(5, {56, 68});
+    tree.Insert(6, {68, 68});
+    
+    std::vector<int> order;
+    for (const auto& element : tree.NearestRange({75, 75}))
+    {
+        order.push_back(element.data);
+    }
+    ASSERT_TRUE(order == std::vector<int>({6, 3, 2, 5, 4, 1}));
+    
+    // The caller decides when to stop, with a condition the tree doesn't need to know about.
+    auto nearest = tree.NearestRange({75, 75});
+    auto it = std::find_if(nearest.begin(), nearest.end(), [](const auto& element) { return element.data % 2 == 0 && element.position.x < 80; });
+    ASSERT_TRUE(it != nearest.end());
+    ASSERT_TRUE(it->data == 6);
+    ASSERT_TRUE(it.GetDistanceSq() == 98);
+    
+    ++it;
+    ASSERT_TRUE(it->data == 3);
+    ASSERT_TRUE(it.GetDistanceSq() == 193);
+    
+    Tree emptyTree = {{0, 0}, {100, 100}};
+    auto empty = emptyTree.NearestRange({50, 50});
+    ASSERT_TRUE(empty.begin() == empty.end());
+}
+
+TEST_F(QuadtreeTest, NearestRange_Many)
+{
+    Tree largeTree = {{0, 0}, {100, 100}, 4, 6};
+    std::vector<glm::vec2> positions;
+    for (int i = 0; i < 1000; ++i)
+    {
+        positions.push_back({static_cast<float>((i * 37) % 100), static_cast<float>((i * 61) % 97)});
+        largeTree.Insert(i, positions.back());
+    }
+    
+    // Every sequence must visit every element exactly once, never moving closer to the target.
+    for (int i = 0; i < 20; ++i)
+    {
+        glm::vec2 target = {static_cast<float>((i * 13) % 101), static_cast<float>((i * 29) % 103)};
+        std::vector<bool> visited(positions.size(), false);
+        float lastDistanceSq = 0;
+        size_t count = 0;
+        
+        auto nearest = largeTree.NearestRange(target);
+        for (auto it = nearest.begin(); it != nearest.end(); ++it)
+        {
+            ASSERT_FALSE(visited[it->data]);
+            ASSERT_TRUE(it.GetDistanceSq() >= lastDistanceSq);
+            visited[it->data] = true;
+            lastDistanceSq = it.GetDistanceSq();
+            ++count;
+        }
+        ASSERT_TRUE(count == positions.size());
+        
+        // The first element is always the same one that FindNearest returns.
+        float nearestDistanceSq = largeTree.NearestRange(target).begin().GetDistanceSq();
+        glm::vec2 position = largeTree.FindNearest(target).value().position;
+        ASSERT_TRUE(nearestDistanceSq == (position.x - target.x) * (position.x - target.x) + (position.y - target.y) * (position.y - target.y));
+    }
+}
+
+TEST_F(QuadtreeTest, ForEachInArea)
+{
+    tree.Insert(1, {25, 25});
+    tree.Insert(2, {87, 87});
+    tree.Insert(3, {87, 68});
+    tree.Insert(4, {56, 56});
+    tree.Insert(5, {56, 68});
+    tree.Insert(6, {68, 68});
+    
+    //  __________ ___________
+    // |        ..|.....|. 2  |
+    // |        . |_____|.____|
+    // |        . |_5|_6|. 3  |
+    // |________._|_4|__|.____|
+    // |        ..|.......    |
+    // |    1     |           |
+    // |          |           |
+    // |__________|___________|
+    
+    int sum = 0;
+    bool completed = tree.ForEachInArea({40, 38}, {75, 88}, [&sum](const auto& element)
+    {
+        sum += element.data;
+        return true;
+    });
+    ASSERT_TRUE(completed);
+    ASSERT_TRUE(sum == 15);
+    
+    int visited = 0;
+    completed = tree.ForEachInArea({40, 38}, {75, 88}, [&visited](const auto&)
+    {
+        ++visited;
+        return false;
+    });
+    ASSERT_FALSE(completed);
+    ASSERT_TRUE(visited == 1);
+}
+
+TEST_F(QuadtreeTest, CountInArea)
+{
+    tree.Insert(1, {25, 25});
+    tree.Insert(2, {87, 87});
+    tree.Insert(3, {87, 68});
+    tree.Insert(4, {56, 56});
+    tree.Insert(5, {56, 68});
+    tree.Insert(6, {68, 68});
+    
+    ASSERT_TRUE(tree.CountInArea({40, 38}, {75, 88}) == 3);
+    ASSERT_TRUE(tree.CountInArea({50, 50}, {100, 100}) == 5);
+    ASSERT_TRUE(tree.CountInArea({0, 0}, {100, 100}) == 6);
+    ASSERT_TRUE(tree.CountInArea({200, 200}, {300, 300}) == 0);
+    
+    auto isEven = [](const auto& element) { return element.data % 2 == 0; };
+    ASSERT_TRUE(tree.CountInArea({40, 38}, {75, 88}, isEven) == 2);
+    ASSERT_TRUE(tree.CountInArea({0, 0}, {100, 100}, isEven) == 3);
+}
+
+TEST_F(QuadtreeTest, CountInArea_Many)
+{
+    Tree largeTree = {{0, 0}, {100, 100}, 4, 6};
+    largeTree.SetLazyMerge(true);
+    for (int i = 0; i < 1000; ++i)
+    {
+        largeTree.Insert(i, {static_cast<float>((i * 37) % 100), static_cast<float>((i * 61) % 97)});
+    }
+    
+    for (int i = 0; i < 1000; i += 3)
+    {
+        glm::vec2 position = {static_cast<float>((i * 37) % 100), static_cast<float>((i * 61) % 97)};
+        largeTree.Remove(i, position);
+        if (i % 2 == 0)
+        {
+            largeTree.Insert(i, position);
+            largeTree.Update(i, position, {static_cast<float>((i * 11) % 100), position.y});
+        }
+    }
+    largeTree.Compact();
+    
+    ASSERT_TRUE(largeTree.CountElements() == largeTree.FindAll({0, 0}, {100, 100}).size());
+    for (int i = 0; i < 50; ++i)
+    {
+        glm::vec2 min = {static_cast<float>((i * 13) % 60), static_cast<float>((i * 29) % 60)};
+        glm::vec2 max = {min.x + static_cast<float>(i % 40), min.y + static_cast<float>((i * 7) % 40)};
+        ASSERT_TRUE(largeTree.CountInArea(min, max) == largeTree.FindAll(min, max).size());
+    }
+}
+
+TEST_F(QuadtreeTest, FindAllInto)
+{
+    tree.Insert(1, {25, 25});
+    tree.Insert(2, {87, 87});
+    tree.Insert(3, {87, 68});
+    tree.Insert(4, {56, 56});
+    tree.Insert(5, {56, 68});
+    tree.Insert(6, {68, 68});
+    
+    std::vector<Tree::Element> elements;
+    tree.FindAllInto({40, 38}, {75, 88}, std::back_inserter(elements));
+    ASSERT_TRUE(elements.size() == 3);
+    ASSERT_TRUE(ContainsData(elements, 4));
+    ASSERT_TRUE(ContainsData(elements, 5));
+    ASSERT_TRUE(ContainsData(elements, 6));
+    
+    auto isEven = [](const auto& element) { return element.data % 2 == 0; };
+    std::array<Tree::Element, 6> buffer;
+    auto end = tree.FindAllInto({40, 38}, {75, 88}, buffer.begin(), isEven);
+    ASSERT_TRUE(end - buffer.begin() == 2);
+}
+
+TEST_F(QuadtreeTest, FindInRadius)
+{
+    tree.Insert(1, {25, 25});
+    tree.Insert(2, {87, 87});
+    tree.Insert(3, {87, 68});
+    tree.Insert(4, {56, 56});
+    tree.Insert(5, {56, 68});
+    tree.Insert(6, {68, 68});
+    
+    //  __________ ___________
+    // |          |   ..  2   |
+    // |          |.__.___.___|
+    // |          |_5|_6|.  3 |
+    // |__________|_4|__|.____|
+    // |          |.     .    |
+    // |    1     |  ...      |
+    // |          |           |
+    // |__________|___________|
+    
+    auto elements = tree.FindInRadius({62, 62}, 10);
+    ASSERT_TRUE(elements.size() == 3);
+    ASSERT_TRUE(ContainsData(elements, 4));
+    ASSERT_TRUE(ContainsData(elements, 5));
+    ASSERT_TRUE(ContainsData(elements, 6));
+    
+    auto isOdd = [](const auto& element) { return element.data % 2 == 1; };
+    elements = tree.FindInRadius({62, 62}, 10, isOdd);
+    ASSERT_TRUE(elements.size() == 1);
+    ASSERT_TRUE(ContainsData(elements, 5));
+    
+    elements = tree.FindInRadius({87, 87}, 0);
+    ASSERT_TRUE(elements.size() == 1);
+    ASSERT_TRUE(ContainsData(elements, 2));
+    
+    ASSERT_TRUE(tree.FindInRadius({62, 62}, 1000).size() == 6);
+    ASSERT_TRUE(tree.FindInRadius({200, 200}, 10).empty());
+    ASSERT_TRUE(tree.FindInRadius({62, 62}, -10).empty());
+}
+
+TEST_F(QuadtreeTest, FindInRadius_Many)
+{
+    Tree largeTree = {{0, 0}, {100, 100}, 4, 6};
+    std::vector<Tree::Element> allElements;
+    for (int i = 0; i < 1000; ++i)
+    {
+        glm::vec2 position = {static_cast<float>((i * 37) % 100), static_cast<float>((i * 61) % 97)};
+        largeTree.Insert(i, position);
+        allElements.push_back({i, position});
+    }
+    
+    for (int i = 0; i < 50; ++i)
+    {
+        glm::vec2 center = {static_cast<float>((i * 13) % 101), static_cast<float>((i * 29) % 103)};
+        float radius = static_cast<float>(i % 40);
+        
+        auto elements = largeTree.FindInRadius(center, radius);
+        size_t expected = 0;
+        for (const auto& element : allElements)
+        {
+            float distanceX = element.position.x - center.x;
+            float distanceY = element.position.y - center.y;
+            if ((distanceX * distanceX) + (distanceY * distanceY) <= radius * radius)
+            {
+                ++expected;
+                ASSERT_TRUE(ContainsData(elements, element.data));
+            }
+        }
+        ASSERT_TRUE(elements.size() == expected);
+    }
+}
+
+TEST_F(QuadtreeTest, ForEachInRadius)
+{
+    tree.Insert(1, {25, 25});
+    tree.Insert(2, {87, 87});
+    tree.Insert(3, {87, 68});
+    tree.Insert(4, {56, 56});
+    tree.Insert(5, {56, 68});
+    tree.Insert(6, {68, 68});
+    
+    int sum = 0;
+    bool completed = tree.ForEachInRadius({62, 62}, 10, [&sum](const auto& element)
+    {
+        sum += element.data;
+        return true;
+    });
+    ASSERT_TRUE(completed);
+    ASSERT_TRUE(sum == 15);
+    
+    int visited = 0;
+    completed = tree.ForEachInRadius({62, 62}, 10, [&visited](const auto&)
+    {
+        return ++visited < 2;
+    });
+    ASSERT_FALSE(completed);
+    ASSERT_TRUE(visited == 2);
+}
+
+TEST_F(QuadtreeTest, FindAllPairs)
+{
+    tree.Insert(1, {25, 25});
+    tree.Insert(2, {87, 87});
+    tree.Insert(3, {87, 68});
+    tree.Insert(4, {56, 56});
+    tree.Insert(5, {56, 68});
+    tree.Insert(6, {68, 68});
+    
+    //  __________ ___________
+    // |          |     |  2  |
+    // |          |_____|_____|
+    // |          |_5|_6|  3  |
+    // |__________|_4|__|_____|
+    // |          |           |
+    // |    1     |           |
+    // |          |           |
+    // |__________|___________|
+    
+    // Every unordered pair is reported once, encoded with its smaller data first.
+    std::vector<int> pairs;
+    auto addPair = [&pairs](const auto& a, const auto& b) { pairs.push_back(std::min(a.data, b.data) * 10 + std::max(a.data, b.data)); };
+    
+    tree.FindAllPairs(12, addPair);
+    std::sort(pairs.begin(), pairs.end());
+    ASSERT_TRUE(pairs == std::vector<int>({45, 56}));
+    
+    pairs.clear();
+    tree.FindAllPairs(19, addPair);
+    std::sort(pairs.begin(), pairs.end());
+    ASSERT_TRUE(pairs == std::vector<int>({23, 36, 45, 46, 56}));
+    
+    pairs.clear();
+    tree.FindAllPairs(-1, addPair);
+    tree.FindAllPairs(0, addPair);
+    ASSERT_TRUE(pairs.empty());
+}
+
+TEST_F(QuadtreeTest, FindAllPairs_Many)
+{
+    Tree largeTree = {{0, 0}, {100, 100}, 4, 6};
+    std::vector<Tree::Element> allElements;
+    for (int i = 0; i < 1000; ++i)
+    {
+        glm::vec2 position = {static_cast<float>((i * 37) % 100), static_cast<float>((i * 61) % 97)};
+        largeTree.Insert(i, position);
+        allElements.push_back({i, position});
+    }
+    
+    QuadtreeThreadPool threadPool(4);
+    for (float distance : {0.0f, 1.5f, 4.0f, 15.0f})
+    {
+        std::vector<std::pair<int, int>> expected;
+        for (size_t i = 0; i < allElements.size(); ++i)
+        {
+            for (size_t j = i + 1; j < allElements.size(); ++j)
+            {
+                float distanceX = allElements[i].position.x - allElements[j].position.x;
+                float distanceY = allElements[i].position.y - allElements[j].position.y;
+                if ((distanceX * distanceX) + (distanceY * distanceY) <= distance * distance)
+                {
+                    expected.emplace_back(allElements[i].data, allElements[j].data);
+                }
+            }
+        }
+        
+        std::vector<std::pair<int, int>> pairs;
+        largeTree.FindAllPairs(distance, [&pairs](const auto& a, const auto& b) { pairs.emplace_back(std::min(a.data, b.data), std::max(a.data, b.data)); });
+        std::sort(pairs.begin(), pairs.end());
+        ASSERT_TRUE(pairs == expected);
+        
+        // The parallel search reports the same pairs from several threads at once.
+        std::mutex mutex;
+        std::vector<std::pair<int, int>> parallelPairs;
+        largeTree.FindAllPairs(distance, [&](const auto& a, const auto& b)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            parallelPairs.emplace_back(std::min(a.data, b.data), std::max(a.data, b.data));
+        }, threadPool);
+        std::sort(parallelPairs.begin(), parallelPairs.end());
+        ASSERT_TRUE(parallelPairs == expected);
+    }
+}
+
+TEST_F(QuadtreeTest, RayCast)
+{
+    tree.Insert(1, {25, 25});
+    tree.Insert(2, {87, 87});
+    tree.Insert(3, {87, 68});
+    tree.Insert(4, {56, 56});
+    tree.Insert(5, {56, 68});
+    tree.Insert(6, {68, 68});
+    
+    //  __________ ___________
+    // |          |     |  2  |
+    // |          |_____|_____|
+    // |--------->|_5|_6|  3  |
+    // |__________|_4|__|_____|
+    // |          |           |
+    // |    1     |           |
+    // |          |           |
+    // |__________|___________|
+    
+    ASSERT_TRUE(tree.RayCast({0, 68}, {1, 0}).value().data == 5);
+    ASSERT_TRUE(tree.RayCast({100, 68}, {-1, 0}).value().data == 3);
+    ASSERT_TRUE(tree.RayCast({0, 68}, {1, 0}, 56).value().data == 5);
+    ASSERT_FALSE(tree.RayCast({0, 68}, {1, 0}, 55).has_value());
+    ASSERT_FALSE(tree.RayCast({0, 68}, {-1, 0}).has_value());
+    
+    auto isEven = [](const auto& element) { return element.data % 2 == 0; };
+    ASSERT_TRUE(tree.RayCast({0, 68}, {1, 0}, 100, 0, isEven).value().data == 6);
+    
+    // The direction doesn't need to be normalized and elements within the hit radius of the ray are hit.
+    ASSERT_TRUE(tree.RayCast({0, 0}, {3, 3}, 200, 1).value().data == 1);
+    ASSERT_TRUE(tree.RayCast({0, 0}, {3, 3}, 200, 1, isEven).value().data == 4);
+    ASSERT_TRUE(tree.RayCast({0, 70}, {1, 0}, 100, 3).value().data == 5);
+    ASSERT_FALSE(tree.RayCast({0, 72}, {1, 0}, 100, 3).has_value());
+}
+
+TEST_F(QuadtreeTest, RayCast_Many)
+{
+    Tree large = {{0, 0}, {100, 100}, 4, 5};
+    std::vector<Tree::Element> elements;
+    for (int i = 0; i < 500; ++i)
+    {
+        glm::vec2 position = {static_cast<float>((i * 37) % 100), static_cast<float>((i * 61) % 100)};
+        large.Insert(i, position);
+        elements.push_back({i, position});
+    }
+    
+    // Every cast must find the element that a linear scan finds closest along the ray.
+    for (int i = 0; i < 200; ++i)
+    {
+        glm::vec2 origin = {static_cast<float>((i * 13) % 101), static_cast<float>((i * 29) % 103)};
+        glm::vec2 direction = {static_cast<float>((i * 7) % 11) - 5, static_cast<float>((i * 3) % 13) - 6};
+        QuadtreeDetail::Ray<glm::vec2> ray(origin, direction.x, direction.y, 80, 1.5f);
+        
+        std::optional<float> expected;
+        for (const auto& element : elements)
+        {
+            float distance;
+            if (ray.Hit(element.position, distance) && (!expected || distance < *expected))
+            {
+                expected = distance;
+            }
+        }
+        
+        auto hit = large.RayCast(origin, direction, 80, 1.5f);
+        ASSERT_TRUE(hit.has_value() == expected.has_value());
+        if (hit)
+        {
+            float distance;
+            ASSERT_TRUE(ray.Hit(hit->position, distance));
+            ASSERT_TRUE(distance == *expected);
+        }
+    }
+}
+
+TEST_F(QuadtreeTest, ForEachAlongSegment)
+{
+    tree.Insert(1, {25, 25});
+    tree.Insert(2, {87, 87});
+    tree.Insert(3, {87, 68});
+    tree.Insert(4, {56, 56});
+    tree.Insert(5, {56, 68});
+    tree.Insert(6, {68, 68});
+    
+    //  __________ ___________
+    // |          |     | 2 / |
+    // |          |_____|_/___|
+    // |          |_5|_6/  3  |
+    // |__________|_4|/_|_____|
+    // |          | /         |
+    // |    1   / |           |
+    // |      /   |           |
+    // |____/_____|___________|
+    
+    std::vector<int> hits;
+    bool completed = tree.ForEachAlongSegment({100, 100}, {10, 10}, 1, [&hits](const auto& element)
+    {
+        hits.push_back(element.data);
+        return true;
+    });
+    ASSERT_TRUE(completed);
+    ASSERT_TRUE(hits == std::vector<int>({2, 6, 4, 1}));
+    
+    hits.clear();
+    completed = tree.ForEachAlongSegment({10, 10}, {60, 60}, 1, [&hits](const auto& element)
+    {
+        hits.push_back(element.data);
+        return true;
+    });
+    ASSERT_TRUE(completed);
+    ASSERT_TRUE(hits == std::vector<int>({1, 4}));
+    
+    hits.clear();
+    completed = tree.ForEachAlongSegment({100, 100}, {10, 10}, 1, [&hits](const auto& element)
+    {
+        hits.push_back(element.data);
+        return hits.size() < 2;
+    });
+    ASSERT_FALSE(completed);
+    ASSERT_TRUE(hits == std::vector<int>({2, 6}));
+}
+
+TEST_F(QuadtreeTest, AutoGrow)
+{
+    tree.Insert(1, {25, 25});
+    tree.Insert(2, {75, 75});
+    ASSERT_FALSE(tree.Insert(3, {150, 150}));
+    
+    tree.SetAutoGrow(true);
+    ASSERT_TRUE(tree.Insert(3, {150, 150}));
+    ASSERT_TRUE(tree.GetMin() == glm::vec2(0, 0));
+    ASSERT_TRUE(tree.GetMax() == glm::vec2(200, 200));
+    
+    ASSERT_TRUE(tree.Insert(4, {-50, 120}));
+    ASSERT_TRUE(tree.GetMin() == glm::vec2(-200, 0));
+    ASSERT_TRUE(tree.GetMax() == glm::vec2(200, 400));
+    
+    //  ______________________
+    // |          |           |
+    // |          |           |
+    // |          |           |
+    // |__________|___________|
+    // |          |     |  3  |
+    // |  4       |_____|_____|
+    // |          |_|2|     |
+    // |__________|1|_|_____|
+    
+    ASSERT_TRUE(tree.CountElements() == 4);
+    ASSERT_TRUE(tree.FindAll({-200, 0}, {200, 400}).size() == 4);
+    ASSERT_TRUE(tree.FindNearest({20, 20}).value().data == 1);
+    ASSERT_TRUE(tree.FindNearest({140, 160}).value().data == 3);
+    ASSERT_TRUE(tree.FindNearest({-60, 130}).value().data == 4);
+    
+    ASSERT_TRUE(tree.Update(4, {-50, 120}, {300, 0}));
+    ASSERT_TRUE(tree.GetMax() == glm::vec2(600, 400));
+    ASSERT_TRUE(tree.FindNearest({290, 10}).value().data == 4);
+    
+    std::vector<Tree::Element> elements = {{1, {-1000, 50}}, {2, {1000, 50}}};
+    ASSERT_TRUE(tree.Build(elements.begin(), elements.end()) == 2);
+    ASSERT_TRUE(tree.CountElements() == 2);
+}
+
+TEST_F(QuadtreeTest, AutoShrink)
+{
+    tree.SetAutoGrow(true);
+    tree.SetAutoShrink(true);
+    tree.Insert(1, {25, 25});
+    tree.Insert(2, {75, 75});
+    tree.Insert(3, {150, 150});
+    tree.Insert(4, {-50, 120});
+    ASSERT_TRUE(tree.GetMax() == glm::vec2(200, 400));
+    
+    ASSERT_TRUE(tree.Remove(4, {-50, 120}));
+    ASSERT_TRUE(tree.GetMin() == glm::vec2(0, 0));
+    ASSERT_TRUE(tree.GetMax() == glm::vec2(200, 200));
+    
+    ASSERT_TRUE(tree.Remove(3, {150, 150}));
+    ASSERT_TRUE(tree.GetMin() == glm::vec2(0, 0));
+    ASSERT_TRUE(tree.GetMax() == glm::vec2(100, 100));
+    ASSERT_TRUE(tree.CountElements() == 2);
+    ASSERT_TRUE(tree.FindNearest({70, 70}).value().data == 2);
+    
+    tree.Insert(3, {500, 500});
+    tree.Clear();
+    ASSERT_TRUE(tree.GetMax() == glm::vec2(100, 100));
+}
+
+TEST_F(QuadtreeTest, FindNearestBatch)
+{
+    for (int i = 0; i < 500; ++i)
+    {
+        tree.Insert(i, {static_cast<float>((i * 37) % 100), static_cast<float>((i * 61) % 100)});
+    }
+    
+    std::vector<glm::vec2> targets;
+    for (int i = 0; i < 1000; ++i)
+    {
+        targets.push_back({static_cast<float>((i * 13) % 101), static_cast<float>((i * 29) % 103)});
+    }
+    
+    QuadtreeThreadPool threadPool(4);
+    std::vector<std::optional<Tree::Element>> nearest;
+    tree.FindNearestBatch(targets, nearest, threadPool);
+    ASSERT_TRUE(nearest.size() == targets.size());
+    
+    for (size_t i = 0; i < targets.size(); ++i)
+    {
+        ASSERT_TRUE(nearest[i].value().data == tree.FindNearest(targets[i]).value().data);
+    }
+    
+    auto isOdd = [](const auto& element) { return element.data % 2 == 1; };
+    tree.FindNearestBatch(targets, nearest, threadPool, isOdd);
+    for (size_t i = 0; i < targets.size(); ++i)
+    {
+        ASSERT_TRUE(nearest[i].value().data == tree.FindNearest(targets[i], isOdd).value().data);
+    }
+}
+
+TEST_F(QuadtreeTest, FindAllBatch)
+{
+    for (int i = 0; i < 500; ++i)
+    {
+        tree.Insert(i, {static_cast<float>((i * 37) % 100), static_cast<float>((i * 61) % 100)});
+    }
+    
+    std::vector<std::pair<glm::vec2, glm::vec2>> areas;
+    for (int i = 0; i < 300; ++i)
+    {
+        glm::vec2 min = {static_cast<float>((i * 13) % 90), static_cast<float>((i * 29) % 90)};
+        areas.push_back({min, {min.x + 10, min.y + 15}});
+    }
+    
+    QuadtreeThreadPool threadPool(3);
+    std::vector<std::vector<Tree::Element>> foundElements;
+    tree.FindAllBatch(areas, foundElements, threadPool);
+    ASSERT_TRUE(foundElements.size() == areas.size());
+    
+    for (size_t i = 0; i < areas.size(); ++i)
+    {
+        ASSERT_TRUE(foundElements[i].size() == tree.FindAll(areas[i].first, areas[i].second).size());
+    }
+}
+
+TEST_F(QuadtreeTest, Freeze_FindNearest_Many)
+{
+    Tree large = {{0, 0}, {100, 100}, 13, 3};
+    for (int i = 0; i < 500; ++i)
+    {
+        large.Insert(i, {static_cast<float>((i * 37) % 100), static_cast<float>((i * 61) % 100)});
+    }
+    
+    auto frozen = large.Freeze();
+    auto isOdd = [](const auto& element) { return element.data % 2 == 1; };
+    for (int i = 0; i < 200; ++i)
+    {
+        glm::vec2 target = {static_cast<float>((i * 13) % 101), static_cast<float>((i * 29) % 103)};
+        ASSERT_TRUE(frozen.FindNearest(target).value().data == large.FindNearest(target).value().data);
+        ASSERT_TRUE(frozen.FindNearest(target, isOdd).value().data == large.FindNearest(target, isOdd).value().data);
+    }
+}
+
+TEST_F(QuadtreeTest, Freeze_FindAll_Many)
+{
+    Tree large = {{0, 0}, {100, 100}, 13, 3};
+    for (int i = 0; i < 500; ++i)
+    {
+        large.Insert(i, {static_cast<float>((i * 37) % 100), static_cast<float>((i * 61) % 100)});
+    }
+    
+    auto frozen = large.Freeze();
+    auto isOdd = [](const auto& element) { return element.data % 2 == 1; };
+    for (int i = 0; i < 200; ++i)
+    {
+        glm::vec2 min = {static_cast<float>((i * 13) % 90), static_cast<float>((i * 29) % 90)};
+        glm::vec2 max = {min.x + 7, min.y + 11};
+        ASSERT_TRUE(frozen.FindAll(min, max).size() == large.FindAll(min, max).size());
+        ASSERT_TRUE(frozen.FindAll(min, max, isOdd).size() == large.FindAll(min, max, isOdd).size());
+    }
+    
+    // The padding of the coordinate arrays must never be reported, even when the area reaches the largest coordinates.
+    float limit = std::numeric_limits<float>::max();
+    ASSERT_TRUE(frozen.FindAll({50, 50}, {limit, limit}).size() == large.FindAll({50, 50}, {limit, limit}).size());
+}
+
+TEST_F(QuadtreeTest, Update)
+{
+    tree.Insert(1, {25, 25});
+    tree.Insert(2, {87, 87});
+    tree.Insert(3, {56, 68});
+    tree.Insert(4, {68, 56});
+    
+    //  __________ ___________
+    // |          |     |  2  |
+    // |          |_____|_____|
+    // |          |_3|__|     |
+    // |__________|__|4_|_____|
+    // |          |           |
+    // |    1     |           |
+    // |          |           |
+    // |__________|___________|
+    
+    bool updated = tree.Update(1, {25, 25}, {10, 40});
+    ASSERT_TRUE(updated);
+    ASSERT_TRUE(tree.GetHeight() == 4);
+    ASSERT_TRUE(tree.FindNearest({0, 50}).value().data == 1);
+    
+    updated = tree.Update(4, {68, 56}, {25, 75});
+    ASSERT_TRUE(updated);
+    
+    //  __________ ___________
+    // |          |        2  |
+    // |    4     |           |
+    // |          | 3         |
+    // |__________|___________|
+    // |          |           |
+    // | 1        |           |
+    // |          |           |
+    // |__________|___________|
+    
+    ASSERT_TRUE(tree.CountElements() == 4);
+    ASSERT_TRUE(tree.GetHeight() == 3);
+    ASSERT_TRUE(tree.FindNearest({20, 80}).value().data == 4);
+    ASSERT_TRUE(tree.Remove(4, {25, 75}));
+    ASSERT_TRUE(tree.Remove(1, {10, 40}));
+}
+
+TEST_F(QuadtreeTest, Update_SameLeaf)
+{
+    tree.Insert(1, {25, 25});
+    tree.Insert(2, {87, 87});
+    tree.Insert(3, {56, 68});
+    tree.Insert(4, {68, 56});
+    tree.SetMergeThreshold(10);
+    
+    // Moving an element within its leaf removes nothing from any branch, so none of them are merged.
+    ASSERT_TRUE(tree.Update(3, {56, 68}, {57, 69}));
+    ASSERT_TRUE(tree.GetHeight() == 4);
+    ASSERT_TRUE(tree.FindNearest({50, 75}).value().data == 3);
+}
+
+TEST_F(QuadtreeTest, Update_NotFound)
+{
+    tree.Insert(1, {25, 25});
+    ASSERT_FALSE(tree.Update(2, {25, 25}, {30, 30}));
+    ASSERT_FALSE(tree.Update(1, {26, 26}, {30, 30}));
+    ASSERT_FALSE(tree.Update(1, {25, 25}, {101, 101}));
+    ASSERT_TRUE(tree.FindNearest({0, 0}).value().position == glm::vec2(25, 25));
+}
+
+TEST_F(QuadtreeTest, Counters)
+{
+    Quadtree<int, glm::vec2, QuadtreePoolAllocator, QuadtreeStats> countedTree = {{0, 0}, {100, 100}, 1};
+    countedTree.Insert(1, {25, 25});
+    countedTree.Insert(2, {60, 60});
+    countedTree.Insert(3, {90, 90});
+    
+    //  __________ ___________
+    // |          |     |   3 |
+    // |          |_____|_____|
+    // |          | 2   |     |
+    // |__________|_____|_____|
+    // |          |           |
+    // |    1     |           |
+    // |          |           |
+    // |__________|___________|
+    
+    ASSERT_TRUE(countedTree.GetCounters().subdivisions == 2);
+    
+    // The search goes straight to the leaf holding 3 and prunes every other child along the way.
+    ASSERT_TRUE(countedTree.FindNearest({90, 90}).value().data == 3);
+    QuadtreeCounters counters = countedTree.GetLastQueryCounters();
+    ASSERT_TRUE(counters.nodesVisited == 3);
+    ASSERT_TRUE(counters.leavesScanned == 1);
+    ASSERT_TRUE(counters.elementsTested == 1);
+    ASSERT_TRUE(counters.filterCalls == 0);
+    ASSERT_TRUE(counters.subtreesPruned == 6);
+    
+    auto isEven = [](const auto& element) { return element.data % 2 == 0; };
+    ASSERT_TRUE(countedTree.FindNearest({90, 90}, isEven).value().data == 2);
+    counters = countedTree.GetLastQueryCounters();
+    ASSERT_TRUE(counters.nodesVisited == 8);
+    ASSERT_TRUE(counters.leavesScanned == 6);
+    ASSERT_TRUE(counters.elementsTested == 2);
+    ASSERT_TRUE(counters.filterCalls == 2);
+    ASSERT_TRUE(counters.subtreesPruned == 1);
+    
+    // An area covering the whole tree collects every leaf without testing any element.
+    ASSERT_TRUE(countedTree.FindAll({0, 0}, {100, 100}).size() == 3);
+    counters = countedTree.GetLastQueryCounters();
+    ASSERT_TRUE(counters.nodesVisited == 9);
+    ASSERT_TRUE(counters.elementsTested == 0);
+    ASSERT_TRUE(countedTree.GetCounters().nodesVisited == 20);
+    
+    countedTree.Remove(3, {90, 90});
+    ASSERT_TRUE(countedTree.GetCounters().merges == 1);
+    
+    countedTree.ResetCounters();
+    ASSERT_TRUE(countedTree.GetCounters().nodesVisited == 0);
+    ASSERT_TRUE(countedTree.GetLastQueryCounters().nodesVisited == 0);
+    
+    // Trees without a stats policy never count anything.
+    tree.Insert(1, {25, 25});
+    tree.FindNearest({0, 0});
+    ASSERT_TRUE(tree.GetCounters().nodesVisited == 0);
+}
+
+TEST_F(QuadtreeTest, Counters_Batch)
+{
+    Quadtree<int, glm::vec2, QuadtreePoolAllocator, QuadtreeStats> countedTree = {{0, 0}, {100, 100}, 4};
+    for (int i = 0; i < 200; ++i)
+    {
+        countedTree.Insert(i, {static_cast<float>((i * 37) % 100), static_cast<float>((i * 61) % 100)});
+    }
+    
+    std::vector<glm::vec2> targets;
+    std::vector<std::pair<glm::vec2, glm::vec2>> areas;
+    for (int i = 0; i < 200; ++i)
+    {
+        glm::vec2 min = {static_cast<float>((i * 13) % 90), static_cast<float>((i * 29) % 90)};
+        targets.push_back(min);
+        areas.push_back({min, {min.x + 10, min.y + 15}});
+    }
+    
+    // Both batches count the same work as running their queries one at a time.
+    QuadtreeCounters expected;
+    for (const auto& target : targets)
+    {
+        countedTree.FindNearest(target);
+        expected += countedTree.GetLastQueryCounters();
+    }
+    
+    QuadtreeThreadPool threadPool(3);
+    std::vector<std::optional<Quadtree<int, glm::vec2>::Element>> nearest;
+    countedTree.FindNearestBatch(targets, nearest, threadPool);
+    ASSERT_TRUE(countedTree.GetLastQueryCounters().nodesVisited == expected.nodesVisited);
+    ASSERT_TRUE(countedTree.GetLastQueryCounters().elementsTested == expected.elementsTested);
+    
+    expected = {};
+    for (const auto& area : areas)
+    {
+        countedTree.FindAll(area.first, area.second);
+        expected += countedTree.GetLastQueryCounters();
+    }
+    
+    std::vector<std::vector<Quadtree<int, glm::vec2>::Element>> foundElements;
+    countedTree.FindAllBatch(areas, foundElements, threadPool);
+    ASSERT_TRUE(expected.nodesVisited > 0);
+    ASSERT_TRUE(countedTree.GetLastQueryCounters().nodesVisited == expected.nodesVisited);
+    ASSERT_TRUE(countedTree.GetLastQueryCounters().leavesScanned == expected.leavesScanned);
+    ASSERT_TRUE(countedTree.GetLastQueryCounters().elementsTested == expected.elementsTested);
+}
+
+TEST_F(QuadtreeTest, GetStats)
+{
+    tree.Insert(1, {25, 25});
+    tree.Insert(2, {60, 60});
+    tree.Insert(3, {90, 90});
+    
+    //  __________ ___________
+    // |          |     |   3 |
+    // |          |_____|_____|
+    // |          | 2   |     |
+    // |__________|_____|_____|
+    // |          |           |
+    // |    1     |           |
+    // |          |           |
+    // |__________|___________|
+    
+    QuadtreeStructureStats stats = tree.GetStats();
+    ASSERT_TRUE(stats.nodeCount == 9);
+    ASSERT_TRUE(stats.leafCount == 7);
+    ASSERT_TRUE(stats.emptyLeafCount == 4);
+    ASSERT_TRUE(stats.maxLeafElements == 1);
+    ASSERT_TRUE(stats.leavesPerDepth == std::vector<size_t>({0, 3, 4}));
+    ASSERT_TRUE(stats.elementsPerDepth == std::vector<size_t>({0, 1, 2}));
+    ASSERT_TRUE(stats.elementBytes == 3 * sizeof(Tree::Element));
+    ASSERT_TRUE(stats.slackBytes == 0);
+    
+    // Removing an element leaves its slot reserved in the leaf.
+    tree.Remove(1, {25, 25});
+    stats = tree.GetStats();
+    ASSERT_TRUE(stats.slackBytes == sizeof(Tree::Element));
+    ASSERT_TRUE(stats.GetTotalBytes() == stats.nodeBytes + (3 * sizeof(Tree::Element)));
+    
+    // Leaves at the maximum depth keep growing past the node capacity.
+    for (int i = 4; i <= 6; ++i)
+    {
+        tree.Insert(i, {1, 1});
+    }
+    
+    stats = tree.GetStats();
+    ASSERT_TRUE(stats.maxLeafElements == 3);
+    ASSERT_TRUE(stats.leavesPerDepth.size() == 5);
+    ASSERT_TRUE(stats.elementsPerDepth[4] == 3);
+}
+
+TEST_F(QuadtreeTest, DoubleCoordinates)
+{
+    // Positions a millimetre apart at a geo-scale offset collapse to the same value as floats.
+    Quadtree<int, glm::dvec2> precise = {{1.0e7, 1.0e7}, {1.0e7 + 1.0, 1.0e7 + 1.0}, 1};
+    precise.Insert(1, {1.0e7 + 0.001, 1.0e7 + 0.001});
+    precise.Insert(2, {1.0e7 + 0.002, 1.0e7 + 0.002});
+    precise.Insert(3, {1.0e7 + 0.003, 1.0e7 + 0.003});
+    
+    ASSERT_TRUE(precise.FindNearest({1.0e7 + 0.0021, 1.0e7 + 0.0021}).value().data == 2);
+    ASSERT_TRUE(precise.FindNearest({1.0e7 + 0.0029, 1.0e7 + 0.0029}).value().data == 3);
+    ASSERT_TRUE(precise.FindAll({1.0e7 + 0.0015, 1.0e7 + 0.0015}, {1.0e7 + 0.0025, 1.0e7 + 0.0025}).size() == 1);
+    ASSERT_TRUE(precise.FindInRadius({1.0e7, 1.0e7}, 0.0025).size() == 1);
+    
+    auto frozen = precise.Freeze();
+    ASSERT_TRUE(frozen.FindNearest({1.0e7 + 0.0021, 1.0e7 + 0.0021}).value().data == 2);
+    ASSERT_TRUE(frozen.FindAll({1.0e7 + 0.0015, 1.0e7 + 0.0015}, {1.0e7 + 0.0025, 1.0e7 + 0.0025}).size() == 1);
+}
+
+TEST_F(QuadtreeTest, IntegerCoordinates)
+{
+    Quadtree<int, glm::ivec2> grid = {{0, 0}, {101, 101}, 1};
+    grid.Insert(1, {25, 25});
+    grid.Insert(2, {87, 87});
+    grid.Insert(3, {87, 68});
+    grid.Insert(4, {56, 56});
+    grid.Insert(5, {56, 68});
+    grid.Insert(6, {68, 68});
+    
+    //  __________ ___________
+    // |          |     |  2  |
+    // |          |_____|x____|
+    // |          |_5|_6|  3  |
+    // |__________|_4|__|_____|
+    // |          |           |
+    // |    1     |           |
+    // |          |           |
+    // |__________|___________|
+    
+    // Centers are rounded down, so the quadrants of an odd extent still tile it exactly.
+    ASSERT_TRUE(QuadtreeDetail::Bounds<glm::ivec2>({0, 0}, {101, 101}).GetCenter() == glm::ivec2(50, 50));
+    ASSERT_TRUE(QuadtreeDetail::Bounds<glm::ivec2>({-7, -7}, {0, 0}).GetCenter() == glm::ivec2(-4, -4));
+    
+    auto isOdd = [](const auto& element) { return element.data % 2 == 1; };
+    ASSERT_TRUE(grid.FindNearest({75, 75}).value().data == 6);
+    ASSERT_TRUE(grid.FindNearest({75, 75}, isOdd).value().data == 3);
+    ASSERT_FALSE(grid.FindNearest({75, 75}, 5).has_value());
+    ASSERT_TRUE(grid.FindAll({56, 56}, {68, 68}).size() == 3);
+    ASSERT_TRUE(grid.FindInRadius({56, 62}, 6).size() == 2);
+    
+    auto frozen = grid.Freeze();
+    ASSERT_TRUE(frozen.FindNearest({75, 75}).value().data == 6);
+    ASSERT_TRUE(frozen.FindNearest({75, 75}, isOdd).value().data == 3);
+    ASSERT_TRUE(frozen.FindAll({56, 56}, {68, 68}).size() == 3);
+    
+    // Squared distances are measured in 64 bits, so positions across the whole grid don't overflow.
+    Quadtree<int, glm::ivec2> wide = {{-(1 << 29), -(1 << 29)}, {1 << 29, 1 << 29}, 1};
+    wide.Insert(1, {-(1 << 29), -(1 << 29)});
+    wide.Insert(2, {(1 << 29) - 1, (1 << 29) - 1});
+    ASSERT_TRUE(wide.FindNearest({1 << 28, 1 << 28}).value().data == 2);
+    ASSERT_TRUE(wide.FindNearest({-(1 << 28), -(1 << 28)}).value().data == 1);
+}